@@ -7,16 +7,24 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "axial.hpp"
+#include "util/mesh.hpp"
 
 namespace cvisual {
 
 class cylinder : public axial
 {
  private:
-	static void init_model();
+	/** The level-of-detail models shared by all cylinders. */
+	static lod_mesh_table lod_cache;
 	bool degenerate();
 	
  public:
+	/** Change the approximate number of triangles used at a level of detail
+		(0 to 5) by all cylinders.
+	*/
+	static void set_lod_triangles( int level, size_t triangles);
+	static size_t get_lod_triangles( int level);
+
 	cylinder();
 	cylinder( const cylinder&);
 	virtual ~cylinder();
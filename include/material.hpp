@@ -19,6 +19,10 @@ class material {
 	
 	void set_translucent( bool );
 	bool get_translucent();
+
+	/** The name given by materials.py, e.g. "diffuse". */
+	void set_name( const std::string& n ) { name = n; }
+	std::string get_name() const { return name; }
 	
 	shader_program* get_shader_program() { return shader.get(); }
 
@@ -28,11 +32,13 @@ class material {
 	std::vector< boost::shared_ptr< texture > > textures;
 	boost::scoped_ptr< shader_program > shader;
 	bool translucent;
+	std::string name;
 };
 
 class apply_material {
  public:
-	apply_material( const view& v, material* m, tmatrix& material_matrix );
+	/** two_sided asks the shader to light the back faces of triangles. */
+	apply_material( const view& v, material* m, tmatrix& material_matrix, bool two_sided = false );
 	~apply_material();
 
  private:
@@ -11,6 +11,20 @@
 
 namespace cvisual { namespace python {
 
+/** What a consumer has seen of an arrayprim_array, as returned by its
+	get_version().  Points are counted here by history index, which stays with
+	a point as points before it are dropped by retaining: first is the history
+	index of the first point, and end is one past the last.
+*/
+struct array_version {
+	unsigned long number;
+	size_t first, end;
+
+	array_version() : number(0), first(0), end(0) {}
+	bool operator==( const array_version& r ) const { return number == r.number; }
+	bool operator!=( const array_version& r ) const { return number != r.number; }
+};
+
 // An Nx3 array of CTYPES, specialized for use in array primitives.  This class
 // should not go anywhere except inside an array primitive, not even as a return
 // value for primitive.pos or whatever.
@@ -19,18 +33,121 @@ class arrayprim_array : public array, private boost::noncopyable {
 protected:
 	size_t length;     // number of points in the array primitive
 	size_t allocated;  // == shape(*this)[0]
+	// The points are rows [head, head+length) of the storage.  Retaining the
+	// last points moves head forward instead of moving them, and the rows
+	// after the window absorb later appends.
+	size_t head;
+	// The numpy type of the elements, and the factor applied to values as they
+	// are stored.  Both are set by set_storage().
+	int storage;
+	size_t itemsize;
+	double scale;
+
+	// Every change gets a new version number.  The ranges of points edited by
+	// the most recent changes are kept in a short log, by history index.  Each
+	// entry covers the edits after the version of the entry before it, up to
+	// its own.  Appends aren't logged, since consumers find the points after
+	// the end they saw for themselves.
+	struct change {
+		unsigned long version;
+		size_t begin, end;
+	};
+	static const int log_size = 8;
+	change log[log_size];
+	int log_next;              // where the next entry goes
+	int log_used;
+	unsigned long version;
+	unsigned long log_floor;   // changes at or before this version are not in the log
+	size_t dropped;            // points dropped from the front; the history index of point 0
+	size_t watched;            // the history end when get_version() was last called
+	bool exposed;              // a view of the storage has been handed to Python
+	// While exposed, a copy of the storage as of the last check for writes
+	// through the views, kept up to date with the changes we make ourselves.
+	std::vector<char> seen;
+	unsigned long seen_frame;  // the render cycle of that check
+	bool adopted;              // the storage belongs to the caller of adopt()
 
 public:
 	arrayprim_array();
-	arrayprim_array( const arrayprim_array& r )  //< Actually copies, to avoid aliasing between array primitives
-		: array(object(r)) {}
+	arrayprim_array( const arrayprim_array& r );  //< Actually copies, to avoid aliasing between array primitives
 
 	void set_length( size_t new_len );
 
-	CTYPE* data(int index=0) { return (CTYPE*)cvisual::python::data(*this) + index*3; }
+	// Consumers that cache data derived from the array remember get_version(),
+	// then ask changed_since() which points to process again.  While Python
+	// holds a view of the storage, it may be written through at any time, so
+	// the first call in each render cycle compares the storage with a copy
+	// of it to find what was written.
+	array_version get_version();
+	/** Record that points [begin, end) were written. */
+	void modified( size_t begin, size_t end);
+	/** Unless nothing has changed after version since, set [begin, end) to a
+		range of points, within the current length, that holds every point
+		changed or appended since then, and return true.  Dropping points
+		changes the index of every point after them, so that counts as
+		changing them all.
+	*/
+	bool changed_since( const array_version& since, size_t& begin, size_t& end) const;
+	/** As changed_since(), but [begin, end) is a range of history indices, and
+		points dropped since then change nothing but first().
+	*/
+	bool written_since( const array_version& since, size_t& begin, size_t& end) const;
+	/** The history index of the first point. */
+	size_t first() const { return dropped; }
+	/** Record what Python has written through views of the storage since this
+		was last done.  get_version() does it once per render cycle; call it
+		before reading points for Python at other times.
+	*/
+	void check_views();
+	// Called when a view of the storage is returned to Python.
+	void expose();
+
+	/** Use a numpy array as the storage without copying it.  It must be an
+		Nx3, C-contiguous, aligned and writeable array of the storage type, with
+		N > 0, and becomes a window of N points.  Changes made to it by its
+		owner are not seen until they are reported with modified().  Growing
+		past N points copies the points into new storage of our own.
+	*/
+	void adopt( const array& a );
+	bool is_adopted() const { return adopted; }
+
+	/** Store the elements as another numpy type, converting the points there
+		are.  Values are stored multiplied by scale, so that colors from 0 to 1
+		can be kept as bytes.  Until the storage is set back to CTYPE, the
+		points must be reached through raw(), get() and set() rather than data().
+	*/
+	void set_storage( int npy_type, double scale = 1.0 );
+	int get_storage() const { return storage; }
+	double get_scale() const { return scale; }
+	bool native() const { return storage == type_npy_traits<CTYPE>::npy_type && scale == 1.0; }
+
+	/** The stored elements of a point. */
+	const void* raw( size_t index = 0 ) const;
+	/** A point as CTYPE values, whatever the storage. */
+	void get( size_t index, CTYPE out[3] ) const;
+	vector get( size_t index ) const;
+	/** Write a point, whatever the storage.  This does not record a change. */
+	void set( size_t index, const CTYPE in[3] );
+	/** Write element comp (0, 1 or 2) of points [first, first+n) from src,
+		taking every stride'th double, or src[0] for every point when stride is
+		0.  The values are scaled and converted to the storage type.  This
+		does not record a change.
+	*/
+	void set_elements( size_t first, size_t n, int comp, const double* src, size_t stride );
+	/** A view of the points, or when they are stored scaled, a copy of them
+		with the scale taken out.
+	*/
+	boost::python::object get_view();
+
+	// Points [begin, end), for indexing the array.
+	cvisual::python::slice rows( size_t begin, size_t end ) const { return cvisual::python::slice( head+begin, head+end); }
+	cvisual::python::slice all() const { return rows( 0, length); }
+
+	// The storage must be CTYPE; see set_storage().
+	CTYPE* data(int index=0) { return (CTYPE*)cvisual::python::data(*this) + (head+index)*3; }
 	CTYPE* end() { return data(length); }
 
-	const CTYPE* data(int index=0) const { return (const CTYPE*)cvisual::python::data(*this) + index*3; }
+	const CTYPE* data(int index=0) const { return (const CTYPE*)cvisual::python::data(*this) + (head+index)*3; }
 	const CTYPE* end() const { return data(length); }
 };
 
@@ -39,10 +156,28 @@ protected:
 	size_t count;
 	virtual void set_length(size_t);
 
-	slice all() { return slice(0,count); }
-
 	arrayprim_array<double> pos;
 
+	// The bounding box and sum of the points, brought up to date with pos by
+	// update_bounds().  Appended points are added in; other changes, and
+	// dropping points, mean going over every point again.
+	mutable vector bounds_min, bounds_max, pos_sum;
+	mutable array_version bounds_version;
+	void update_bounds() const;
+
+	// For appending many points at once: make room for n more, keeping at most
+	// retain points in all, as append() does.  The first skip of the new points
+	// don't fit; the rest go from the returned index to the end.
+	size_t append_rows( size_t n, int retain, size_t& skip );
+	// The number of points in an Nx3 array, or 1 for a single 3 element point.
+	static size_t point_rows( const double_array& a, const char* name );
+	// Copy n rows of src, from row skip on, into dest from point first on.  A
+	// single point is copied into every row.
+	static void copy_rows( arrayprim_array<double>& dest, size_t first,
+		const double_array& src, size_t skip, size_t n );
+	// The points, within the current length, that mark_dirty( begin, end) means.
+	void dirty_rows( int begin, int end, size_t& first, size_t& last ) const;
+
 public:
 	arrayprim();
 
@@ -60,6 +195,15 @@ public:
 
 	void append( const vector& _pos, int retain );
 	void append( const vector& _pos ) { append( _pos, -1 ); }
+	/** Append every point of an Nx3 array with one call. */
+	void append_array( const double_array& pos, int retain );
+
+	/** Draw from an Nx3 numpy array owned by the caller, without copying it.
+		See arrayprim_array::adopt(). */
+	void adopt_pos( const array& pos );
+	/** Report that the caller has written into points [begin, end) of
+		adopted arrays; an end less than zero means the last point. */
+	virtual void mark_dirty( int begin = 0, int end = -1);
 };
 
 class arrayprim_color : public arrayprim {
@@ -84,9 +228,17 @@ public:
 	void set_green_d( const double green );
 
 	using arrayprim::append;
+	using arrayprim::append_array;
 	void append_rgb( const vector& _pos, double red=-1, double green=-1, double blue=-1, int retain=-1 );
 	void append( const vector& _pos, const rgb& _color, int retain ); // Append a single position with new color.
 	void append( const vector& _pos, const rgb& _color ) { append( _pos, _color, -1 ); }
+	/** Append the points of an Nx3 array, colored by the rows of an Nx3
+		array or all by a single color. */
+	void append_array( const double_array& pos, const double_array& color, int retain );
+
+	/** As adopt_pos(), for a color array with a row for each point. */
+	void adopt_color( const array& color );
+	virtual void mark_dirty( int begin = 0, int end = -1);
 };
 
 } } // namespace cvisual::python
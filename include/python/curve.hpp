@@ -8,6 +8,8 @@
 
 #include "renderable.hpp"
 #include "util/displaylist.hpp"
+#include "util/gl_buffer.hpp"
+#include "util/polyline_lod.hpp"
 #include "python/num_util.hpp"
 #include "python/arrayprim.hpp"
 
@@ -54,8 +56,51 @@ class curve : public arrayprim_color
 	void set_radius( const double& r);
 
  private:
+	// Float copies of the centerline (tube) and colors (tube_colors), written
+	// only where points have been appended or edited since the last frame,
+	// and kept as the window of points slides forward.
+	// Thin curves are drawn from them directly, and thick ones are extruded
+	// from them by a vertex shader.
+	gl_buffer tube;
+	gl_buffer tube_colors;
+	size_t tube_count;     // points written
+	size_t tube_capacity;  // slots allocated, including the padding at each end
+	size_t tube_first;     // the history index of the point in slot 1
+	array_version tube_pos_version;
+	array_version tube_color_version;
+	int tube_color_mode;   // 0, or 1 and 2 for desaturated and grayscale anaglyph colors
+	vector tube_origin;    // the tube holds positions less this, its first point when written
+
+	// The simplification hierarchy over pos and, when it leaves points out,
+	// the indices of the points drawn.  These are chosen again only when pos
+	// or the camera has changed.
+	polyline_lod lod;
+	array_version lod_pos_version;
+	vector lod_camera, lod_forward;
+	double lod_pixels;     // the view's width in pixels over tan_hfov_x
+	bool lod_active;
+	std::vector<unsigned int> lod_indices;
+	void update_lod( const view&);
+	// Thick curves drawn from lod_indices need the neighbors of each point as
+	// simplified, so the points drawn are copied into these, as in the tube.
+	gl_buffer lod_tube;
+	gl_buffer lod_tube_colors;
+	bool lod_tube_stale;
+
+	// Write the float vertexes of point k, with the colors for color_mode.
+	void tube_vertexes( size_t k, int color_mode, float*& v_i, float*& c_i);
+	void write_tube( const view&, size_t begin, size_t end, bool closed, int color_mode);
+	void write_lod_tube( const view&, int color_mode);
+	// Bring the buffers up to date, returning false if buffer objects are unavailable.
+	bool update_tube( const view&);
+	// These return false if they can't be used, in which case gl_render_client()
+	// draws from client memory instead.
+	bool gl_render_tube( const view&);
+	bool gl_render_line( const view&);
+	void gl_render_client( const view&);
+
 	bool adjust_colors( const view& scene, float* tcolor, size_t pcount);
-	void thickline( const view&, double* spos, float* tcolor, size_t pcount, double scaled_radius);
+	void thickline( const view&, const double* spos, float* tcolor, size_t pcount, double line_radius);
 };
 
 } } // !namespace cvisual::python
@@ -0,0 +1,121 @@
+#ifndef VPYTHON_PYTHON_CURVES_HPP
+#define VPYTHON_PYTHON_CURVES_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "renderable.hpp"
+#include "util/gl_buffer.hpp"
+#include "python/num_util.hpp"
+#include "python/arrayprim.hpp"
+
+#include <vector>
+
+namespace cvisual { namespace python {
+
+using boost::python::list;
+
+/** Many polylines in one object.  The points of every line are stored one
+	after another in pos, and offsets gives the index of the first point of
+	each line.  Each line has its own color, radius, and visibility.  All of
+	the thin lines are drawn with one call, and all of the thick ones with
+	another, from buffers that are refilled only when something changes.
+	After a pick, pick_index is the index of the line under the mouse.
+*/
+class curves : public arrayprim
+{
+ protected:
+	// Line i runs from point starts[i] up to the start of line i+1, or to the
+	// end of pos for the last line.
+	std::vector<size_t> starts;
+	std::vector<float> line_colors;   // red, green, blue for each line
+	std::vector<double> line_radii;
+	std::vector<bool> line_visible;
+	double radius;
+	bool antialias;
+	int pick_index;
+
+	// Two vertexes per point, as described for use_tube_shader: the point and
+	// its signed radius, then its previous and next points within the line.
+	// Only the vertexes of points that have changed, or whose lines have, are
+	// written again.
+	gl_buffer vertexes;
+	gl_buffer colors;
+	// Two indices per segment of each visible thin line, and six per segment
+	// of each visible thick line.
+	std::vector<unsigned int> thin_indices;
+	std::vector<unsigned int> thick_indices;
+	// The points of lines whose starts, colors, or radii have changed.
+	size_t dirty_begin, dirty_end;
+	bool visible_changed;  // the indices must be made again
+	array_version buffer_pos_version;
+	size_t buffer_count;
+	size_t buffer_capacity;  // points that fit in the buffers
+	int buffer_color_mode;
+	vector buffer_origin;  // the buffer holds positions less this, the first point
+
+	virtual void outer_render( const view&);
+	virtual void gl_render( const view&);
+	virtual void gl_pick_render( const view&);
+	virtual vector get_center() const;
+	virtual void grow_extent( extent&);
+	virtual void pick_names( const unsigned int* name_top, const unsigned int* name_end);
+
+	// The range of points in a line, clipped to those that exist.
+	void line_range( size_t line, size_t& begin, size_t& end) const;
+	// The line holding a point at or after the start of the first line.
+	size_t line_of( size_t point) const;
+	void check_line( int line) const;
+	void start_line( size_t first, const rgb& color, double radius);
+	void line_changed( size_t line);
+	void all_lines_changed();
+	// After an append with retain has dropped the first points of pos, move
+	// the lines back with them, dropping those left with no points.
+	void drop_points( size_t dropped);
+	// Write the vertexes of points [first, last).
+	void write_points( const view&, size_t first, size_t last, int color_mode);
+	void update_buffers( const view&, int color_mode);
+	void fill_indices();
+
+ public:
+	curves();
+
+	size_t get_line_count() const { return starts.size(); }
+
+	/** Append a line made of the points in pos, returning its index. */
+	int add_line( const double_array& pos, const rgb& color, double radius);
+	int add_line_default( const double_array& pos);
+	int add_line_color( const double_array& pos, const rgb& color);
+
+	/** Append to the last line, which is started with the object's color
+		and radius if there are no lines.  Lines whose points are all dropped
+		by retain are removed. */
+	void append( const vector& pos, int retain);
+	void append_array( const double_array& pos, int retain);
+
+	list get_offsets() const;
+	/** Replace the starting points of the lines with an array of integers,
+		nonnegative, nondecreasing, and no more than the number of points.
+		Lines that are new take the object's color and radius. */
+	void set_offsets( const array& offsets);
+
+	rgb get_line_color( int line) const;
+	void set_line_color( int line, const rgb& color);
+	double get_line_radius( int line) const;
+	void set_line_radius( int line, double radius);
+	bool get_line_visible( int line) const;
+	void set_line_visible( int line, bool visible);
+
+	/** The color and radius of lines added without one. */
+	rgb get_color() const { return color; }
+	void set_color( const rgb& c) { color = c; }
+	double get_radius() const { return radius; }
+	void set_radius( double r) { radius = r; }
+	bool get_antialias() const { return antialias; }
+	void set_antialias( bool aa) { antialias = aa; }
+	int get_pick_index() const { return pick_index; }
+};
+
+} } // !namespace cvisual::python
+
+#endif // !VPYTHON_PYTHON_CURVES_HPP
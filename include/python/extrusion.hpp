@@ -8,9 +8,17 @@
 
 #include "renderable.hpp"
 #include "util/displaylist.hpp"
+#include "util/gl_buffer.hpp"
+#include "util/polyline_lod.hpp"
+#include "util/thread.hpp"
 #include "python/num_util.hpp"
 #include "python/arrayprim.hpp"
 
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <map>
+
 namespace cvisual { namespace python {
 
 using boost::python::list;
@@ -47,9 +55,6 @@ class extrusion : public arrayprim_color
 
 	bool antialias;
 
-	// Returns true if the object is single-colored.
-	bool monochrome(double* tcolor, size_t pcount);
-
 	virtual void outer_render( const view&);
 	virtual void gl_render( const view&);
 	virtual vector get_center() const;
@@ -125,7 +130,33 @@ class extrusion : public arrayprim_color
 	void set_antialias( bool);
 
  private:
-	bool adjust_colors( const view& scene, double* tcolor, size_t pcount);
+	// The triangles drawn by gl_render, 9 floats per corner: position relative
+	// to mesh_origin, normal, and color.  Remade by update_mesh only when pos,
+	// color or scale has changed, or an attribute that shapes the mesh.
+	std::vector<float> mesh;
+	vector mesh_origin;
+	gl_buffer mesh_buffer;
+	bool mesh_made; // cleared by the attribute setters
+	bool mesh_stale; // mesh_buffer is older than mesh
+	unsigned long mesh_frame; // the renderable::frame() mesh was last checked in
+	array_version mesh_pos_version, mesh_color_version, mesh_scale_version;
+	int mesh_anaglyph; // 0, or 1 for grayscale or 2 for desaturated colors
+	vector mesh_up; // up may be changed in place
+	int mesh_path_level, mesh_section_level;
+	void update_mesh( const view& scene);
+
+	// Level of detail.  Distant extrusions are drawn from the points path_lod
+	// keeps at lod_path_level, and from the cross section profile->sections[lod_section_level],
+	// each the coarsest that stays within half a pixel of the original.
+	polyline_lod path_lod;
+	array_version lod_pos_version;
+	array_version lod_scale_version;
+	double lod_max_scale; // the largest scale factor along the path
+	int lod_path_level, lod_section_level;
+	void update_lod( const view& scene);
+	void scale_modified() { scale.modified( 0, count ? count : 1); }
+
+	void adjust_colors( const view& scene, double* tcolor, size_t pcount);
 	void extrude(const view& scene,
 			std::vector<vector>& faces_pos,
 			std::vector<vector>& faces_normals,
@@ -137,25 +168,77 @@ class extrusion : public arrayprim_color
 			std::vector<vector>& faces_normals,
 			std::vector<vector>& faces_colors, bool make_faces);
 
-	vector smoothing(const vector& a, const vector& b);
+	// The joints at either end of one segment of the path, as extrude works them
+	// out, from which extrude_sides makes the sides of the segment.
+	struct segment
+	{
+		vector prev, current; // the path points
+		vector prevxrot, prevy, xrot, y; // axes in the planes of the joints
+		double prevc11, prevc12, prevc21, prevc22, c11, c12, c21, c22;
+		vector prevxaxis, prevyaxis, xaxis, yaxis, nextxaxis, nextyaxis;
+		double prevscalex, prevscaley, scalex, scaley;
+		vector prev_color, current_color;
+	};
+	// The contours of a cross section, as in profile_data below, possibly keeping
+	// fewer points.  error is the largest distance of an original point from the
+	// contours kept.
+	struct cross_section
+	{
+		std::vector<npy_float64> contours;
+		std::vector<npy_int32> pcontours;
+		std::vector<double> normals2D;
+		double error;
+	};
+
+	// The cross section given to set_contours, and what is worked out from it.
+	// Extrusions given the same shape share one, so that it is processed and
+	// stored once; they are found through profiles, keyed by a CRC of the shape.
+	struct profile_data
+	{
+		// contours are flattened N*2 arrays of points describing the 2D surface, one after another.
+		// pcontours[0] is (number of contours, closed), where closed=1 if closed contour, 0 if not
+		// pcontours[2*i+2] is (length of ith contour, starting location of ith contour in contours).
+		// strips are flattened N*2 arrays of points describing strips that span the "solid" part of the 2D surface.
+		// pstrips[0] is (number of strips, closed)
+		// pstrips[2*i] is (length of ith strip, starting location of ith strip in strips).
+		std::vector<npy_float64> contours, strips;
+		std::vector<npy_int32> pcontours, pstrips;
+		double smooth; // the smoothing applied to normals2D
+		boost::uint32_t crc; // of all of the above
+
+		std::vector<double> normals2D; // [(nx0,ny0), (nx1,ny1)], [(nx1,ny1), (nx2,ny2)], etc. normals for 2D shape
+		bool closed; // 1 if closed shape contour, 0 if not
+		double xmax, ymax; // biggest distances from curve to edges of shape (to calculate max extent)
+		// sections[0] is the whole cross section, and each one after keeps about
+		// half the points of the one before.
+		std::vector<cross_section> sections;
+
+		bool same_shape( const profile_data& other) const;
+	};
+	boost::shared_ptr<const profile_data> profile;
+	// Use the shared profile with the same shape as p, or else process p and share it.
+	void set_profile( const boost::shared_ptr<profile_data>& p);
+	void process_profile( profile_data& p) const;
+	void build_sections( profile_data& p) const;
+
+	typedef std::multimap<boost::uint32_t, boost::weak_ptr<const profile_data> > profile_cache;
+	static profile_cache profiles;
+	static size_t profiles_sweep_size; // when to next drop the entries of profiles no longer used
+	static mutex profiles_lock;
+
+	// The number of corners of the triangles that make the sides of a segment.
+	size_t side_corners(const cross_section&, bool make_faces) const;
+	// Make the sides of segments [begin, end), side_corners() corners each.
+	void extrude_sides(const cross_section&, const segment* segments, bool make_faces,
+			vector* faces_pos, vector* faces_normals, vector* faces_colors,
+			size_t begin, size_t end) const;
+
+	vector smoothing(const vector& a, const vector& b) const;
 
 	vector calculate_normal(const vector prev, const vector current, const vector next);
 
-	// contours are flattened N*2 arrays of points describing the 2D surface, one after another.
-	// pcontours[0] is (number of contours, closed), where closed=1 if closed contour, 0 if not
-	// pcontours[2*i+2] is (length of ith contour, starting location of ith contour in contours).
-	// strips are flattened N*2 arrays of points describing strips that span the "solid" part of the 2D surface.
-	// pstrips[0] is (number of strips, closed)
-	// pstrips[2*i] is (length of ith strip, starting location of ith strip in strips).
-	std::vector<npy_float64> contours, strips;
-	std::vector<npy_int32> pcontours, pstrips;
-	std::vector<double> normals2D; // [(nx0,ny0), (nx1,ny1)], [(nx1,ny1), (nx2,ny2)], etc. normals for 2D shape
-	bool shape_closed; // 1 if closed shape contour, 0 if not
-
 	vector center; // center of extrusion (seems like it is not used)
 	double maxextent; // max scaled distance from curve
-	double shape_xmax, shape_ymax; // biggest distances from curve to edges of shape (to calculate max extent)
-	size_t maxcontour; // number of vertices in largest contour
 };
 
 } } // !namespace cvisual::python
@@ -9,6 +9,7 @@
 #include "python/arrayprim.hpp"
 
 #include <boost/python/object.hpp>
+#include <vector>
 
 namespace cvisual { namespace python {
 
@@ -16,10 +17,47 @@ class faces : public arrayprim_color
 {
  protected:
 	arrayprim_array<double> normal; // An array of normal vectors for the faces.
+	// Triangles as triples of vertex numbers.  If empty, each three
+	// vertexes in order make a triangle.
+	std::vector<unsigned int> index;
+	size_t index_max; // The largest vertex number in index.
+	bool twosided;
+
+	// What make_normals() and smooth_normals() last did, so that they can
+	// remake the normals of just the triangles changed since: the versions
+	// of pos and normal when they were done, and for smooth_normals() without
+	// an index, the crease angle and the first corner at the position of
+	// each corner.
+	bool flat_made, smooth_made;
+	array_version flat_pos_version, flat_normal_version;
+	array_version smooth_pos_version, smooth_normal_version;
+	double smooth_crease;
+	std::vector<unsigned int> weld;
+
+	// Set [begin, end) to the points whose normals need remaking, in whole
+	// triangles, or return false if there are none.
+	bool normals_stale( bool made, const array_version& pos_since, const array_version& normal_since,
+		size_t& begin, size_t& end);
+	void smooth_soup( double crease_angle);
+
+	// Translucent triangles may be drawn back to front, by the centroids of
+	// the triangles, which are remade where pos changes.  The order drawn
+	// last frame, as an index array, is used again until the view turns by
+	// more than a little or the triangles change.
+	bool depth_sort;
+	std::vector<float> centroids; // 3 per triangle
+	bool centroids_made;
+	array_version centroid_version;
+	std::vector<unsigned int> sorted;
+	vector sorted_forward;
+	void update_centroids();
+	void sort_triangles( const view&);
 
 	virtual void set_length(size_t);
+	bool indexed() const { return !index.empty(); }
 
 	bool degenerate() const;
+	virtual void outer_render( const view&);
 	virtual void gl_render( const view&);
 	virtual void gl_pick_render( const view&);
 	virtual vector get_center() const;
@@ -34,6 +72,11 @@ class faces : public arrayprim_color
 	void append( const vector&, const vector&, const rgb& );
 	void append( const vector&, const vector& );
 	void append( const vector& );
+	/** Append the vertexes of Nx3 arrays with one call.  The normals and
+		colors may each be a single 3 element vector for every vertex. */
+	void append_array( const double_array& pos, const double_array& normal, const double_array& color );
+	void append_array( const double_array& pos, const double_array& normal );
+	void append_array( const double_array& pos );
 
 	// This routine was adapted from faces_heightfield.py.  It averages the normal
 	// vectors at coincident vertices to smooth out boundaries between facets,
@@ -42,12 +85,32 @@ class faces : public arrayprim_color
 	void smooth();
 	void smooth_d(const float);
 
+	/** Give each vertex the average of the normals of the triangles around
+		it, weighted by their areas.  Triangles at a vertex whose normals are
+		more than crease_angle (radians) apart get copies of the vertex, so
+		that sharp edges stay sharp.  Without an index, the triangles around a
+		vertex are those with a corner at the same position, and only
+		triangles near those changed since the last call are redone.
+	*/
+	void smooth_normals( double crease_angle);
+
 	void make_normals();
 	void make_twosided();
-	
+	bool get_twosided() const { return twosided; }
+	void set_twosided( bool);
+	/** Draw the triangles of translucent faces from back to front. */
+	bool get_depth_sort() const { return depth_sort; }
+	void set_depth_sort( bool);
+
+	/** An Mx3 array of vertex numbers, one row per triangle.  An empty array
+		returns to drawing each three vertexes as a triangle. */
+	boost::python::object get_index();
+	void set_index( const double_array& index);
+
 	boost::python::object get_normal();
 	void set_normal( const double_array& normal);
 	void set_normal_v( const vector);
+	virtual void mark_dirty( int begin = 0, int end = -1);
 };
 
 } } // !namespace cvisual::python
@@ -53,10 +53,35 @@ class numeric_texture : public texture
 	bool tex_mipmapped;
 	bool tex_antialias;
     bool tex_clamp;
+	int tex_reduction; // texture loaded at 1/2**tex_reduction of the data size to fit the memory budget
+
+	// The region of texdata, in texels, that has changed since it was last
+	// loaded into OpenGL.  dirty_full is true when the whole texture must be
+	// reloaded (new geometry, type, or first use).
+	size_t dirty_x, dirty_y, dirty_width, dirty_height;
+	bool dirty_full;
+
+	// Pixel unpack buffer used to stream texel data to OpenGL without
+	// stalling the render thread.
+	unsigned int pbo;
+	PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB;
 
 	bool degenerate() const;
 	bool should_reinitialize() const;
 
+	// Grow the dirty region to cover the texels that differ between
+	// texdata and the equally shaped next_data.  Returns false if nothing
+	// changed.
+	bool damage_difference( const boost::python::numeric::array& next_data );
+	void damage_all();
+
+	// Load a region of pixels, an image row_width texels wide, into the bound
+	// texture, through a pixel buffer object when available.
+	void gl_load_region( const view& v, GLenum format, GLenum type,
+		const char* pixels, size_t row_width,
+		size_t x, size_t y, size_t width, size_t height );
+	static void gl_free_buffer( PFNGLDELETEBUFFERSARBPROC, unsigned int );
+
  protected:
 	virtual void gl_init(const struct view&);
 	virtual void gl_transform(void);
@@ -0,0 +1,105 @@
+#ifndef VPYTHON_PYTHON_POINTCLOUD_HPP
+#define VPYTHON_PYTHON_POINTCLOUD_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "renderable.hpp"
+#include "util/gl_buffer.hpp"
+#include "util/point_octree.hpp"
+#include "python/num_util.hpp"
+
+#include <string>
+#include <vector>
+
+namespace cvisual { namespace python {
+
+/** Points drawn from a point_octree file, which may hold far more points than
+	fit in memory.  Each frame, the nodes in view are chosen largest on the
+	screen first, until point_budget points are chosen or the points of the
+	chosen nodes are closer together than the point size.  Nodes not yet in
+	memory are read by background threads and uploaded a few per frame, and
+	the least recently drawn are dropped once more than memory_budget points
+	are held.
+*/
+class pointcloud : public renderable
+{
+ public:
+	pointcloud();
+	pointcloud( const pointcloud&);
+
+	/** The name of a file written by pointcloud_builder.  Opening it throws
+		std::runtime_error if it can't be read. */
+	void set_file( const std::string& filename);
+	std::string get_file() const { return filename; }
+
+	void set_size( float size);
+	float get_size() const { return size; }
+
+	void set_points_shape( const std::string& n_type);
+	std::string get_points_shape() const;
+
+	void set_point_budget( size_t n) { point_budget = n; }
+	size_t get_point_budget() const { return point_budget; }
+	void set_memory_budget( size_t n) { memory_budget = n; }
+	size_t get_memory_budget() const { return memory_budget; }
+
+	/** The number of points in the file, and the number drawn last frame. */
+	boost::uint64_t get_point_count() const;
+	size_t get_drawn_count() const { return drawn_count; }
+
+ private:
+	// The file, and the nodes read from it that are waiting to be uploaded.
+	// Shared with the reading threads, which may outlive this object.
+	struct source;
+	boost::shared_ptr<source> file;
+	std::string filename;
+
+	enum { ABSENT, LOADING, RESIDENT };
+	struct node_state
+	{
+		int status;
+		unsigned long last_drawn;  // frame number
+		gl_buffer points;
+		// Without buffer objects, the points are drawn from here.
+		std::vector<point_octree::record> client_points;
+	};
+	std::vector<node_state> nodes;
+	size_t resident_count;  // points uploaded
+	unsigned long frame;
+	size_t drawn_count;
+
+	float size;
+	enum { ROUND, SQUARE } points_shape;
+	size_t point_budget;
+	size_t memory_budget;
+
+	void upload( const view&);
+	void select( const view&, std::vector<size_t>& chosen);
+	void evict();
+
+	virtual void outer_render( const view&);
+	virtual void gl_render( const view&);
+	virtual void gl_pick_render( const view&);
+	virtual vector get_center() const;
+	virtual void grow_extent( extent&);
+};
+
+/** Builds a file for pointcloud from arrays of points added in chunks, so
+	that all of the points never need to be in memory at once. */
+class pointcloud_builder
+{
+ public:
+	pointcloud_builder( const std::string& filename, size_t node_points = 65536);
+
+	void add_points( const double_array& pos);
+	void add_points_color( const double_array& pos, const double_array& color);
+	void finish();
+
+ private:
+	boost::shared_ptr<point_octree_builder> builder;
+};
+
+} } // !namespace cvisual::python
+
+#endif // !defined VPYTHON_PYTHON_POINTCLOUD_HPP
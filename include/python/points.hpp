@@ -4,6 +4,7 @@
 #include "renderable.hpp"
 #include "python/num_util.hpp"
 #include "python/arrayprim.hpp"
+#include "util/gl_buffer.hpp"
 
 namespace cvisual { namespace python {
 
@@ -15,12 +16,31 @@ class points : public arrayprim_color
 	enum { WORLD, PIXELS } size_units;
 	
 	// Specifies the shape of the point. Future candidates are triangles,
-	// diamonds, etc. 
-	enum { ROUND, SQUARE } points_shape;
+	// diamonds, etc.  Spheres are round points shaded by the scene's lights.
+	enum { ROUND, SQUARE, SPHERE } points_shape;
 
 	// The size of the points
 	float size;
 	
+	// Float copies of pos and color, written only where points have been
+	// appended or edited since the last frame.  Colors stored as uint8 are
+	// copied as bytes unless they must be converted for anaglyph stereo.
+	gl_buffer vertex_buffer;
+	gl_buffer color_buffer;
+	size_t buffer_count;     // points written
+	size_t buffer_capacity;  // points allocated
+	array_version buffer_pos_version;
+	array_version buffer_color_version;
+	int buffer_color_mode;   // 0, or 1 and 2 for desaturated and grayscale anaglyph colors
+	GLenum buffer_color_type;
+	vector buffer_origin;    // the buffer holds positions less this: the first point, or 0 for floats
+
+	// Convert points [begin, end), less origin, to floats, and colors to color_type.
+	void write_points( size_t begin, size_t end, int color_mode, GLenum color_type,
+		const vector& origin, float* vertexes, void* colors);
+	// Bring the buffers up to date, returning false if buffer objects are unavailable.
+	bool update_buffers( const view&, int color_mode);
+
 	bool degenerate() const;
 	
 	virtual void outer_render( const view&);
@@ -40,6 +60,15 @@ class points : public arrayprim_color
 	
 	void set_size_units( const std::string& n_type);
 	std::string get_size_units( void);
+
+	/** The storage of pos, "float64" or "float32", and of color, which may
+		also be "float16" or "uint8".  The smaller types are drawn without
+		conversion.
+	*/
+	void set_pos_type( const std::string& n_type);
+	std::string get_pos_type( void);
+	void set_color_type( const std::string& n_type);
+	std::string get_color_type( void);
 };
 
 } } // !namespace cvisual::python
@@ -3,9 +3,8 @@
 
 // This alternative to numpy is not currently being used
 // but is retained in CVS for possible future use.
-// In particular, information about array objects such
-// as curve cannot currently be cached because we don't
-// know when a numpy pos array has been changed.
+// The array objects record their own changes to their
+// numpy arrays instead; see arrayprim_array.
 
 // Copyright (c) 2003, 2004 Jonathan Brandmeyer.
 // See the file license.txt for complete license terms.
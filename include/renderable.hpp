@@ -128,6 +128,13 @@ struct view
 	// to the screen, with a center at pos, and some radius.  If pos is behind
 	// the camera, it will return negative.
 	double pixel_coverage( const vector& pos, double radius) const;
+
+	// Multiply the modelview matrix by the scaling by gcfvec that takes world
+	// space to the scene, then by a translation to origin, so that vertexes
+	// may be drawn from their stored world coordinates less origin.  Floats
+	// measured from an origin near the points keep their precision however
+	// far the points are from the world origin.
+	void gl_world_transform( const vector& origin = vector()) const;
 };
 
 /** Virtual base class for all renderable objects and composites.
@@ -155,6 +162,12 @@ public:
 	 */
 	virtual void gl_pick_render( const view&);
 
+	/** Called when this object is picked, with the names that its
+	 * gl_pick_render() pushed onto the name stack below its own, if any.  The
+	 * default is to ignore them.
+	 */
+	virtual void pick_names( const unsigned int* name_top, const unsigned int* name_end) {}
+
 	/** Report the total extent of the object. */
 	virtual void grow_extent( extent&);
 
@@ -175,6 +188,14 @@ public:
 
 	virtual void get_children( std::vector< boost::shared_ptr<renderable> >& all ) {}
 
+	/** Called once at the start of each render cycle, before the extent of
+	 * the scene is computed. */
+	static void next_frame();
+	/** The number of render cycles begun so far.  Data asked for several times
+	 * in one cycle, by grow_extent() and gl_render() say, can be brought up to
+	 * date only the first time. */
+	static unsigned long frame();
+
 protected:
 	renderable();
 
@@ -7,6 +7,10 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "axial.hpp"
+#include "util/mesh.hpp"
+#include <map>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
 
 #ifdef __GNUC__
 # define NONNULL __attribute__((nonnull))
@@ -16,25 +20,6 @@
 
 namespace cvisual {
 
-// This model representation is intended to be "sort of like" what a next generation
-// two phase renderer would use.  Eventually, therefore, it should be replaced with
-// the real thing.
-struct fvertex {
-	union {
-		float v[3];
-		struct { float x, y, z; };
-	};
-	fvertex() {}  // uninitialized!
-	fvertex( const vector& v ) : x(v.x), y(v.y), z(v.z) {}
-};
-
-class model {
-public:
-	std::vector< unsigned short > indices;
-	std::vector< fvertex > vertex_pos;
-	std::vector< fvertex > vertex_normal;
-};
-
 class ring : public axial
 {
  private:
@@ -44,9 +29,14 @@ class ring : public axial
 	PRIMITIVE_TYPEINFO_DECL;
 	bool degenerate();
 
-	cvisual::model model;
-	int model_rings, model_bands;
-	double model_radius, model_thickness;
+	/** Unit torus models shared by all rings, keyed by the quantized ratio of
+		thickness to radius and by the number of rings and bands.  A ring is
+		drawn by scaling one of these by its radius.
+	*/
+	typedef boost::tuple<int, int, int> model_key;
+	typedef std::map<model_key, shared_ptr<mesh> > model_cache_t;
+	static model_cache_t model_cache;
+	static mesh& get_model( double thickness_ratio, int rings, int bands);
 
  public:
 	ring();
@@ -59,8 +49,6 @@ class ring : public axial
 	virtual void gl_render( const view&);
 	virtual void grow_extent( extent&);
 	void get_material_matrix(const view&, tmatrix& out);
-
-	void create_model( int rings, int bands, class model& m );
 };
 
 } // !namespace cvisual
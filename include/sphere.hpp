@@ -7,7 +7,7 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "axial.hpp"
-#include "util/displaylist.hpp"
+#include "util/mesh.hpp"
 
 namespace cvisual {
 
@@ -16,16 +16,18 @@ namespace cvisual {
 class sphere : public axial
 {
  private:
-	/** The level-of-detail cache.  It is stored for the life of the program, and
-		initialized when the first sphere is rendered. At one time there were
-		going to be additional entries for the textured case, but that was
-		not implemented.
+	/** The level-of-detail cache.  It is stored for the life of the program,
+		and each level is generated when it is first rendered.
 	*/
- 	static displaylist lod_cache[6];
-	/// True until the first sphere is rendered, then false.
-	static void init_model();
+ 	static lod_mesh_table lod_cache;
  
  public:
+	/** Change the approximate number of triangles used at a level of detail
+		(0 to 5) by all spheres and ellipsoids.
+	*/
+	static void set_lod_triangles( int level, size_t triangles);
+	static size_t get_lod_triangles( int level);
+
 	/** Construct a unit sphere at the origin. */
 	sphere();
 	sphere( const sphere& other);
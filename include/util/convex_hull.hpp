@@ -0,0 +1,24 @@
+#ifndef VPYTHON_UTIL_CONVEX_HULL_HPP
+#define VPYTHON_UTIL_CONVEX_HULL_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include <vector>
+#include <cstddef>
+
+namespace cvisual {
+
+/** Find the convex hull of n points, stored as x, y, z triples, by
+	quickhull.  The hull is returned as triangles of point numbers, wound
+	counterclockwise seen from outside.  Points within a small tolerance of
+	a face count as on it, so near-coplanar points don't produce slivers.
+	If the points all lie in a plane, the hull is the polygon around them,
+	with triangles facing both ways; if they lie on a line, it is empty.
+*/
+void
+convex_hull( const double* pos, size_t n, std::vector<unsigned int>& triangles);
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_CONVEX_HULL_HPP
@@ -0,0 +1,61 @@
+#ifndef VPYTHON_UTIL_GL_BUFFER_HPP
+#define VPYTHON_UTIL_GL_BUFFER_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "wrap_gl.hpp"
+#include <cstddef>
+
+namespace cvisual {
+
+struct view;
+
+/** A manager for an OpenGL buffer object (ARB_vertex_buffer_object).  The
+	buffer is created on first use, and released through on_gl_free.  When
+	buffer objects are not supported, gl_bind() returns false and callers
+	should draw from client memory instead.  A copy starts out empty, with a
+	size() of zero, for its owner to fill again.
+*/
+class gl_buffer
+{
+ private:
+	GLenum target;
+	unsigned int handle;
+	size_t bytes;
+	PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB;
+
+	static void gl_free( PFNGLDELETEBUFFERSARBPROC, unsigned int handle);
+
+ public:
+	/** target is GL_ARRAY_BUFFER_ARB or GL_ELEMENT_ARRAY_BUFFER_ARB. */
+	gl_buffer( GLenum target = GL_ARRAY_BUFFER_ARB);
+	gl_buffer( const gl_buffer&);
+	gl_buffer& operator=( const gl_buffer&);
+	~gl_buffer();
+
+	/** Bind the buffer, creating it if needed.
+		@return false if buffer objects are not available.
+	*/
+	bool gl_bind( const view&);
+	/** Bind zero to this buffer's target. */
+	void gl_unbind( const view&);
+
+	/** Replace the whole contents of the buffer (binding it). */
+	void gl_set_data( const view&, size_t bytes, const void* data,
+		GLenum usage = GL_STATIC_DRAW_ARB);
+	/** Overwrite part of the buffer (binding it).  The range must lie within
+		the size last given to gl_set_data().
+	*/
+	void gl_set_subdata( const view&, size_t offset, size_t bytes, const void* data);
+
+	/** The size of the data store, in bytes. */
+	size_t size() const { return bytes; }
+
+	/** Discard the buffer object; it will be recreated on next use. */
+	void reset();
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_GL_BUFFER_HPP
@@ -29,6 +29,7 @@ class gl_extensions {
 	PFNGLDELETEOBJECTARBPROC		glDeleteObjectARB;
 	PFNGLGETHANDLEARBPROC			glGetHandleARB;
 	PFNGLUNIFORM1IARBPROC			glUniform1iARB;
+	PFNGLUNIFORM1FARBPROC			glUniform1fARB;
 	PFNGLUNIFORMMATRIX4FVARBPROC	glUniformMatrix4fvARB;
 	PFNGLUNIFORM4FVARBPROC			glUniform4fvARB;
 	PFNGLGETUNIFORMLOCATIONARBPROC	glGetUniformLocationARB;
@@ -47,6 +48,34 @@ class gl_extensions {
 	// Extension: ARB_point_parameters
 	bool ARB_point_parameters;
 	PFNGLPOINTPARAMETERFVARBPROC	glPointParameterfvARB;
+
+	// Extension: ARB_vertex_buffer_object
+	bool ARB_vertex_buffer_object;
+	PFNGLGENBUFFERSARBPROC			glGenBuffersARB;
+	PFNGLBINDBUFFERARBPROC			glBindBufferARB;
+	PFNGLBUFFERDATAARBPROC			glBufferDataARB;
+	PFNGLBUFFERSUBDATAARBPROC		glBufferSubDataARB;
+	PFNGLMAPBUFFERARBPROC			glMapBufferARB;
+	PFNGLUNMAPBUFFERARBPROC			glUnmapBufferARB;
+	PFNGLDELETEBUFFERSARBPROC		glDeleteBuffersARB;
+
+	// Extension: ARB_pixel_buffer_object (uses the ARB_vertex_buffer_object entry points)
+	bool ARB_pixel_buffer_object;
+
+	// Extension: SGIS_generate_mipmap (a texture parameter; no entry points)
+	bool SGIS_generate_mipmap;
+
+	// Extension: ARB_texture_non_power_of_two (no entry points)
+	bool ARB_texture_non_power_of_two;
+
+	// Extension: ARB_texture_compression (only the generic compressed formats are used)
+	bool ARB_texture_compression;
+
+	// Extension: ARB_half_float_vertex (GL_HALF_FLOAT_ARB in vertex arrays; no entry points)
+	bool ARB_half_float_vertex;
+
+	// Extension: ARB_point_sprite (no entry points)
+	bool ARB_point_sprite;
 };
 
 }
@@ -0,0 +1,97 @@
+#ifndef VPYTHON_UTIL_MESH_HPP
+#define VPYTHON_UTIL_MESH_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/vector.hpp"
+#include "util/gl_buffer.hpp"
+#include <boost/utility.hpp>
+#include <vector>
+
+namespace cvisual {
+
+/** An indexed triangle mesh in single precision, with a normal and a 2D
+	texture coordinate for every vertex.  The geometry stays available on the
+	CPU; it is copied into OpenGL buffer objects, where they are supported, the
+	first time it is drawn.
+*/
+class mesh : boost::noncopyable
+{
+ public:
+	std::vector<float> pos;        ///< x, y, z for each vertex.
+	std::vector<float> normals;    ///< x, y, z for each vertex.
+	std::vector<float> tex_coords; ///< s, t for each vertex.
+	/** Three vertex indices per triangle, counterclockwise as seen from outside. */
+	std::vector<unsigned int> indices;
+
+	mesh();
+
+	size_t vertex_count() const { return pos.size() / 3; }
+	size_t triangle_count() const { return indices.size() / 3; }
+
+	/** Remove all geometry. */
+	void clear();
+	/** Append a vertex, returning its index. */
+	unsigned int add_vertex( const vector& p, const vector& n, double s, double t);
+	void add_triangle( unsigned int a, unsigned int b, unsigned int c);
+
+	/** Draw the mesh with the current OpenGL state. */
+	void gl_render( const struct view&);
+
+ private:
+	gl_buffer vertex_buffer; // pos, then normals, then tex_coords
+	gl_buffer index_buffer;
+	bool uploaded;
+};
+
+/** Generators for the unit models shared by sphere, cylinder, and cone.  Each
+	replaces the contents of the mesh.
+*/
+/** A unit sphere about the origin, with its poles on the z axis.  Texture
+	coordinates run around the equator (s) and from pole to pole (t).
+*/
+void make_sphere_mesh( mesh&, size_t slices, size_t stacks);
+/** A cylinder of unit radius from x=0 to x=1, with both ends closed. */
+void make_cylinder_mesh( mesh&, size_t slices, size_t stacks);
+/** A cone with a base of unit radius at x=0 and its tip at x=1, with the base closed. */
+void make_cone_mesh( mesh&, size_t slices, size_t stacks);
+/** A torus about the x axis, with a major radius of 1 and a cross section of
+	radius tube_radius, divided into rings around the axis and bands around the
+	cross section.
+*/
+void make_torus_mesh( mesh&, size_t rings, size_t bands, double tube_radius);
+
+/** The level-of-detail models of one shape.  Each level is generated from a
+	number of slices (around the axis) and stacks (along it), on first use and
+	again after the level's triangle count is changed.
+*/
+class lod_mesh_table : boost::noncopyable
+{
+ public:
+	static const int levels = 6;
+	typedef void (*generator)( mesh&, size_t slices, size_t stacks);
+
+	lod_mesh_table( generator make, const size_t slices[levels], const size_t stacks[levels]);
+
+	/** The model for a level, clamped to the valid range. */
+	mesh& operator[]( int level);
+
+	/** Request about this many triangles at a level.  The ratio of slices to
+		stacks is kept, so the result is approximate.
+	*/
+	void set_triangles( int level, size_t triangles);
+	/** The approximate number of triangles in a level's model. */
+	size_t get_triangles( int level);
+
+ private:
+	generator make;
+	size_t slices[levels];
+	size_t stacks[levels];
+	bool changed[levels];
+	mesh models[levels];
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_MESH_HPP
@@ -0,0 +1,22 @@
+#ifndef VPYTHON_UTIL_PARALLEL_HPP
+#define VPYTHON_UTIL_PARALLEL_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include <boost/function.hpp>
+#include <cstddef>
+
+namespace cvisual {
+
+/** Call f(begin, end) for ranges that together cover [0, n), each of at
+	least grain items, spread over a pool of threads (one per processor) and
+	the calling thread.  Returns once every call has returned.  Calls from
+	different threads take turns, and f must not itself call parallel_for().
+*/
+void
+parallel_for( size_t n, size_t grain, const boost::function<void (size_t, size_t)>& f);
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_PARALLEL_HPP
@@ -0,0 +1,137 @@
+#ifndef VPYTHON_UTIL_POINT_OCTREE_HPP
+#define VPYTHON_UTIL_POINT_OCTREE_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/vector.hpp"
+#include "util/thread.hpp"
+#include <boost/cstdint.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace cvisual {
+
+/** A point cloud file, organized as an octree for level of detail.  Each node
+	holds a random sample of the points in its cube that were not taken by its
+	ancestors, so drawing a node and its ancestors shows the cube at a density
+	set by their total size, and descending refines it.  The points of each
+	node are stored contiguously, in the order of a depth-first walk.
+
+	The file starts with a header and ends with the node table, which is
+	read when the file is opened; the points are read a node at a time.
+	Numbers are stored in the byte order of the machine that built the file.
+*/
+class point_octree
+{
+ public:
+	/** A point as stored, 16 bytes. */
+	struct record
+	{
+		float pos[3];
+		unsigned char color[4];  // red, green, blue, unused
+	};
+
+	/** The layout of the file's header, at its start, and of the entries of
+		its node table. */
+	struct disk_header
+	{
+		char magic[8];
+		boost::uint32_t colored;
+		boost::uint32_t nodes;
+		boost::uint64_t points;
+		boost::uint64_t table;  // byte offset of the node table
+	};
+	struct disk_node
+	{
+		boost::uint64_t first;
+		boost::uint32_t count;
+		boost::int32_t child[8];
+		float corner[3];  // the cube's lowest corner and edge length
+		float edge;
+		boost::uint32_t unused;
+	};
+
+	struct node
+	{
+		vector min_corner, max_corner;  // the node's cube
+		boost::uint64_t first;          // index of its first point
+		size_t count;
+		int child[8];                   // node indices, or -1
+	};
+
+	/** Open a file written by point_octree_builder, reading its node table.
+		Throws std::runtime_error if it can't be read.
+	*/
+	explicit point_octree( const std::string& filename);
+
+	const std::vector<node>& nodes() const { return table; }
+	/** False if the points were added without colors. */
+	bool has_color() const { return colored; }
+	boost::uint64_t size() const { return total; }
+
+	/** Replace out with the points of node n.  May be called from any thread. */
+	void read( size_t n, std::vector<record>& out);
+
+ private:
+	std::vector<node> table;
+	bool colored;
+	boost::uint64_t total;
+	std::ifstream file;
+	mutex file_lock;
+};
+
+/** Builds a point_octree file from points added in chunks of any size.  The
+	points are kept in a temporary file beside the output rather than in
+	memory.  Subtrees with no more than in_core_points points are built in
+	memory; larger ones are split through temporary files, one pass per level.
+*/
+class point_octree_builder
+{
+ public:
+	/** node_points is the number of points given to each node before its
+		children. */
+	point_octree_builder( const std::string& filename, size_t node_points = 65536,
+		size_t in_core_points = 1 << 23);
+	~point_octree_builder();
+
+	/** Add n points; color may be null, but must be given for every chunk
+		or none.  Components of color are from 0 to 1. */
+	void add( const double* pos, const double* color, size_t n);
+	/** Write the file.  No more points may be added. */
+	void finish();
+
+ private:
+	std::string filename;
+	size_t node_points;
+	size_t in_core_points;
+	std::string spill_name;
+	std::ofstream spill;
+	boost::uint64_t count;
+	int colored;  // -1 until the first chunk
+	vector lo, hi;
+	bool finished;
+
+	// State while finishing.
+	std::ofstream out;
+	std::vector<point_octree::disk_node> table;
+	boost::uint64_t written;
+	unsigned long spill_serial;
+	boost::uint32_t random_state;
+
+	boost::uint32_t random();
+	int build( const std::string& source, boost::uint64_t n,
+		const vector& corner, double edge, int depth);
+	int build_leaf( std::ifstream& source, boost::uint64_t n,
+		const vector& corner, double edge);
+	int build_in_core( point_octree::record* begin, point_octree::record* end,
+		const vector& corner, double edge, int depth);
+	int add_node( const point_octree::record* points, size_t n,
+		const vector& corner, double edge);
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_POINT_OCTREE_HPP
@@ -0,0 +1,35 @@
+#ifndef VPYTHON_UTIL_POINT_SHADER_HPP
+#define VPYTHON_UTIL_POINT_SHADER_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/shader_program.hpp"
+
+namespace cvisual {
+
+/** Binds the shader that draws GL_POINTS as point sprites, shaped in the
+	fragment shader, and enables the point sprite state it relies on.  Each
+	point is a disk, a square, or a sphere lit by the scene's lights.  Points
+	are pixel_size pixels across, or if that is zero, world_size eye space
+	units across at their own depth.  The state is restored on destruction.
+*/
+class use_point_shader
+{
+ public:
+	enum shape { DISK, SQUARE, SPHERE };
+
+	use_point_shader( const view&, shape, double pixel_size, double world_size);
+	~use_point_shader();
+	/** false if the shader or point sprites are unavailable, in which case
+		nothing was changed. */
+	bool ok() { return sprites; }
+
+ private:
+	use_shader_program program;
+	bool sprites;
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_POINT_SHADER_HPP
@@ -0,0 +1,120 @@
+#ifndef VPYTHON_UTIL_POLYLINE_LOD_HPP
+#define VPYTHON_UTIL_POLYLINE_LOD_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/vector.hpp"
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+namespace cvisual {
+
+/** A multiresolution hierarchy over a polyline that grows at its end and may
+	lose points from its front, as curves do when points are appended with
+	retain.  Points are known by their history index, which stays the same as
+	points before them are dropped.  A span of level L runs between points
+	whose history indices are successive multiples of 2^L, and the hierarchy
+	knows the largest distance of any point inside each span from the segment
+	between its ends.  A polyline is simplified by covering it with spans,
+	coarse where they are accurate enough and finer elsewhere.  Appending a
+	point costs O(levels) amortized, and dropping one O(1) amortized.
+*/
+class polyline_lod
+{
+ public:
+	static const int max_levels = 24;
+
+	polyline_lod();
+
+	/** Forget all points. */
+	void clear();
+	/** Take account of the n points of the x, y, z triples in pos, which have
+		history indices from first on.  Points seen before that are still
+		there must not have changed.
+	*/
+	void update( const double* pos, size_t first, size_t n);
+
+	size_t size() const { return end - begin; }
+	/** The number of levels that simplify anything, plus level 0. */
+	int levels() const;
+	/** The largest distance between a point and the line drawn at this level. */
+	double error( int level) const;
+	/** Replace out with the indices, counted from the first point, of the
+		points kept at a level.  The ends of the polyline that aren't aligned
+		to spans of the level are drawn with finer ones.
+	*/
+	void indices( int level, std::vector<unsigned int>& out) const;
+	/** As indices(), but choosing the coarsest span wherever that is
+		accurate enough.  accept( a, b, error) is asked about a span from
+		point a to point b, counted from the first point, whose points all lie
+		within error of the segment from a to b.
+	*/
+	template <class Accept>
+	void indices( Accept& accept, std::vector<unsigned int>& out) const;
+
+ private:
+	size_t begin, end;  // the history indices of the points seen
+	// span_error[L][i] is the error of span node_first[L] + i of level L,
+	// which runs from point (node_first[L] + i) * 2^L.
+	std::deque<double> span_error[max_levels];
+	size_t node_first[max_levels];
+	// The largest error of the spans of each level, found again after points
+	// are dropped.
+	mutable double level_error[max_levels];
+	mutable bool level_error_stale;
+
+	struct accept_all {
+		bool operator()( size_t, size_t, double) const { return true; }
+	};
+	template <class Accept>
+	void cover( size_t h, int level, Accept& accept, std::vector<unsigned int>& out) const;
+	template <class Accept>
+	void walk( int max_level, Accept& accept, std::vector<unsigned int>& out) const;
+};
+
+template <class Accept>
+void
+polyline_lod::cover( size_t h, int level, Accept& accept, std::vector<unsigned int>& out) const
+{
+	const size_t stride = size_t(1) << level;
+	if (!level || accept( h - begin, h + stride - begin,
+			span_error[level][(h >> level) - node_first[level]])) {
+		out.push_back( h + stride - begin);
+		return;
+	}
+	cover( h, level - 1, accept, out);
+	cover( h + stride/2, level - 1, accept, out);
+}
+
+template <class Accept>
+void
+polyline_lod::walk( int max_level, Accept& accept, std::vector<unsigned int>& out) const
+{
+	out.clear();
+	if (begin == end)
+		return;
+	const size_t last = end - 1;
+	out.push_back( 0);
+	// The largest spans that fit, each simplified from the top down.
+	for (size_t h = begin; h < last; ) {
+		int level = 0;
+		while (level < max_level && !(h & ((size_t(2) << level) - 1))
+				&& h + (size_t(2) << level) <= last)
+			++level;
+		cover( h, level, accept, out);
+		h += size_t(1) << level;
+	}
+}
+
+template <class Accept>
+void
+polyline_lod::indices( Accept& accept, std::vector<unsigned int>& out) const
+{
+	walk( max_levels - 1, accept, out);
+}
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_POLYLINE_LOD_HPP
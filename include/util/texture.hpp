@@ -6,6 +6,7 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include <string>
+#include <list>
 #include <boost/shared_ptr.hpp>
 #include "util/gl_free.hpp"
 #include "util/thread.hpp"
@@ -23,6 +24,17 @@ class texture
 	bool damaged;
 	unsigned int handle;
 
+	// Graphics memory accounting.  Every texture holding an OpenGL texture
+	// object is on a list ordered from most to least recently used.
+	size_t resident_bytes;
+	unsigned long last_used;
+	bool listed;
+	std::list<texture*>::iterator lru_position;
+
+	// Delete the OpenGL texture object, leaving this texture to be
+	// reinitialized the next time it is used.
+	void evict();
+
  public:
 	/** Release the handle to OpenGL.  Subclasses must not call
  		glDeleteTextures() on this class's handle.
@@ -49,6 +61,29 @@ class texture
 	*/
 	virtual int enable_type() const;
 
+	/** The number of bytes of graphics memory held by this texture. */
+	size_t get_resident_bytes() const;
+
+	/** The total graphics memory, in bytes, held by all textures. */
+	static size_t get_total_resident_bytes();
+	/** The number of textures holding graphics memory. */
+	static size_t get_resident_count();
+
+	/** Limit on the graphics memory used by textures, in bytes; 0 (the
+		default) means no limit.  When it is exceeded, the least recently used
+		textures are released and reloaded when next used, and textures
+		that still don't fit are loaded at reduced resolution.
+	*/
+	static void set_memory_budget( size_t bytes);
+	static size_t get_memory_budget();
+
+	/** Request compressed internal formats where the driver supports them. */
+	static void set_compression( bool);
+	static bool get_compression();
+
+	/** Called once at the start of each render cycle. */
+	static void next_frame();
+
  protected:
 	// A unique identifier for the texture, to be obtained from glGenTextures().
 	bool have_opacity;
@@ -82,6 +117,16 @@ class texture
 	// needs to be reloaded into OpenGL.
 	void damage();
 
+	// Subclasses report the graphics memory occupied by their texture object
+	// from gl_init().
+	void set_resident_bytes( size_t bytes);
+
+	// Called from gl_init() before allocating a texture of the given size.
+	// Releases least recently used textures to make room, and returns how
+	// many times the texture should be halved in each dimension to fit
+	// within the budget.
+	int fit_memory_budget( size_t bytes);
+
  public:
  	// Should be protected; makeing this public works around a GCC 3.4.2 bug
 	static void gl_free( GLuint handle );
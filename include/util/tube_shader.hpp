@@ -0,0 +1,31 @@
+#ifndef VPYTHON_UTIL_TUBE_SHADER_HPP
+#define VPYTHON_UTIL_TUBE_SHADER_HPP
+
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/shader_program.hpp"
+
+namespace cvisual {
+
+/** Binds the shader that draws polylines as screen-facing ribbons, mitered at
+	the joins and lit as the visible half of a round tube.  Each point is sent
+	as two vertexes: the point in gl_Vertex.xyz and the signed half-width of the
+	ribbon in gl_Vertex.w, negative on one side and positive on the other.  The
+	previous and next points along the line go in gl_MultiTexCoord0 and
+	gl_Normal.  Widths are multiplied by scale.
+*/
+class use_tube_shader
+{
+ public:
+	use_tube_shader( const view&, double scale);
+	/** false if shaders are unavailable, in which case nothing was bound. */
+	bool ok() { return program.ok(); }
+
+ private:
+	use_shader_program program;
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_TUBE_SHADER_HPP
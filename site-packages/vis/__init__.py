@@ -3,8 +3,9 @@ version = ('5.72', 'release')
 from .cvisual import (vector, dot, mag, mag2, norm, cross, rotate,
                        comp, proj, diff_angle, rate, waitclose)
 from .primitives import (arrow, cylinder, cone, sphere, box, ring, label,
-                               frame, pyramid, ellipsoid, curve, faces, convex, helix,
-                               points, text, distant_light, local_light, extrusion)
+                               frame, pyramid, ellipsoid, curve, curves, faces, convex, helix,
+                               points, pointcloud, text, distant_light, local_light, extrusion)
+from .cvisual import pointcloud_builder
 try:
     from Polygon import Polygon
 except:
@@ -22,6 +22,18 @@ Stable Interfaces:
         Load and save uncompressed TGA files; typically used to supply the data
         parameter to texture().  file may be a filename or file object.
 
+    materials.set_texture_memory_budget( bytes, compress=None )
+        Limit the graphics memory used by textures to bytes (0 for no limit).
+        Least recently used textures are released when the limit is exceeded,
+        and textures that still don't fit are loaded at reduced resolution.
+        If compress is True, textures loaded afterwards use compressed
+        formats where the graphics driver offers them.
+
+    materials.texture_memory_usage()
+        Returns a dictionary giving the graphics memory used by textures
+        ('bytes'), the number of textures loaded ('count'), the budget
+        ('budget') and whether compression is requested ('compress').
+
 Unstable interfaces:
     materials.shader( name, shader, version, textures=(), translucent=False )
         This is the low level interface for constructing a material based on
@@ -69,6 +81,17 @@ class raw_texture(cvisual.texture):
         for key, value in kwargs.items():
             self.__setattr__(key, value)
 
+def set_texture_memory_budget(bytes, compress=None):
+    cvisual.texbase.set_memory_budget(int(bytes))
+    if compress is not None:
+        cvisual.texbase.set_compression(bool(compress))
+
+def texture_memory_usage():
+    return dict(bytes=cvisual.texbase.get_total_resident_bytes(),
+                count=cvisual.texbase.get_resident_count(),
+                budget=cvisual.texbase.get_memory_budget(),
+                compress=cvisual.texbase.get_compression())
+
 class shader_material(cvisual.material):
     def __init__(self, **kwargs):
         cvisual.material.__init__(self)
@@ -636,6 +659,7 @@ library = """
     uniform int light_count;
     uniform vec4 light_pos[8];
     uniform vec4 light_color[8];
+    uniform int two_sided;         // light back faces, with their normals reversed
 
     // Outputs of a material_main() function
 
@@ -646,6 +670,8 @@ library = """
     //   specified by the light_* uniforms.
     vec3 lightAt( vec3 normal, vec3 to_eye, vec3 diffuse_color, vec3 specular_color, float shininess )
     {    
+        if (two_sided != 0 && !gl_FrontFacing)
+            normal = -normal;
         vec3 color = gl_LightModel.ambient.rgb * diffuse_color;
 
         // All this ugliness is to deal with the need of Geforce 7xxx (and probably similar generation
@@ -340,6 +340,13 @@ class curve (py_renderable_arrayobject, cvisual.curve ):
     green = property( py_renderable_arrayobject.get_green, cvisual.curve.set_green, None)
     blue = property( py_renderable_arrayobject.get_blue, cvisual.curve.set_blue, None)
 
+class curves (py_renderable_arrayobject, cvisual.curves ):
+    
+    pos = property( cvisual.curves.get_pos, cvisual.curves.set_pos, None)
+    def set_offsets(self, offsets):
+        cvisual.curves.set_offsets(self, array(offsets))
+    offsets = property( cvisual.curves.get_offsets, set_offsets, None)
+
 class extrusion (py_renderable_uniform, py_renderable_arrayobject, cvisual.extrusion ):
 
     def get_faces(self):
@@ -527,6 +534,14 @@ class extrusion (py_renderable_uniform, py_renderable_arrayobject, cvisual.extru
     
 class points ( py_renderable_arrayobject, cvisual.points ):
     
+    def process_init_args_from_keyword_dictionary( self, keywords ):
+        # The storage must be chosen before pos and color fill it.
+        for name in ('pos_type', 'color_type'):
+            if name in keywords:
+                setattr(self, name, keywords[name])
+                del keywords[name]
+        super(points, self).process_init_args_from_keyword_dictionary( keywords )
+
     pos = property( cvisual.points.get_pos, cvisual.points.set_pos, None)
     color = property( cvisual.points.get_color, cvisual.points.set_color, None)
     x = property( py_renderable_arrayobject.get_x, cvisual.points.set_x, None)
@@ -536,6 +551,11 @@ class points ( py_renderable_arrayobject, cvisual.points ):
     green = property( py_renderable_arrayobject.get_green, cvisual.points.set_green, None)
     blue = property( py_renderable_arrayobject.get_blue, cvisual.points.set_blue, None)
 
+class pointcloud ( py_renderable, cvisual.pointcloud ):
+    # The points and their colors come from the file, written by
+    # cvisual.pointcloud_builder; color is used if the file has none.
+    pass
+
 class convex( py_renderable_arrayobject, py_renderable_uniform, cvisual.convex ):
     pos = property( cvisual.convex.get_pos, cvisual.convex.set_pos, None)
 
@@ -543,6 +563,7 @@ class faces( py_renderable_arrayobject, cvisual.faces ):
     
     pos = property( cvisual.faces.get_pos, cvisual.faces.set_pos, None)
     normal = property( cvisual.faces.get_normal, cvisual.faces.set_normal, None)
+    index = property( cvisual.faces.get_index, cvisual.faces.set_index, None)
     color = property( cvisual.faces.get_color, cvisual.faces.set_color, None)
     red = property( py_renderable_arrayobject.get_red, cvisual.faces.set_red, None)
     green = property( py_renderable_arrayobject.get_green, cvisual.faces.set_green, None)
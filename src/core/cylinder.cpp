@@ -5,8 +5,7 @@
 
 #include "cylinder.hpp"
 #include "util/errors.hpp"
-#include "util/displaylist.hpp"
-#include "util/quadric.hpp"
+#include "util/mesh.hpp"
 #include "util/gl_enable.hpp"
 
 namespace cvisual {
@@ -17,20 +16,13 @@ cylinder::degenerate()
 	return !visible || radius == 0.0 || axis.mag() == 0.0;
 }
 
-// TODO: This model currently uses three-deep glPushMatrix() to run.  It should
-// be reduced.
-static void
-render_cylinder_model( size_t n_sides, size_t n_stacks = 1)
-{
-	quadric q;
-	q.render_cylinder( 1.0, 1.0, n_sides, n_stacks);
-	q.render_disk( 1.0, n_sides, 1, -1); // left end of cylinder
-	gl_matrix_stackguard guard;
-	glTranslatef( 1.0f, 0.0f, 0.0f);
-	q.render_disk( 1.0, n_sides, 1, 1); // right end of cylinder
+namespace {
+// The number of faces and stacks corresponding to each level of detail.
+const size_t cylinder_slices[] = { 8, 16, 32, 64, 96, 188 };
+const size_t cylinder_stacks[] = { 1, 1, 3, 6, 10, 20 };
 }
 
-static displaylist cylinder_simple_model[6];
+lod_mesh_table cylinder::lod_cache( &make_cylinder_mesh, cylinder_slices, cylinder_stacks);
 
 cylinder::cylinder()
 {
@@ -46,20 +38,15 @@ cylinder::~cylinder()
 }
 
 void
-cylinder::init_model()
+cylinder::set_lod_triangles( int level, size_t triangles)
 {
-	if (!cylinder_simple_model[0]) {
-		clear_gl_error();
-		// The number of faces corrisponding to each level of detail.
-		size_t n_faces[] = { 8, 16, 32, 64, 96, 188 };
-		size_t n_stacks[] = {1, 1, 3, 6, 10, 20 };
-		for (size_t i = 0; i < 6; ++i) {
-			cylinder_simple_model[i].gl_compile_begin();
-			render_cylinder_model( n_faces[i], n_stacks[i]);
-			cylinder_simple_model[i].gl_compile_end();
-		}
-		check_gl_error();
-	}
+	lod_cache.set_triangles( level, triangles);
+}
+
+size_t
+cylinder::get_lod_triangles( int level)
+{
+	return lod_cache.get_triangles( level);
 }
 
 void
@@ -79,7 +66,6 @@ cylinder::gl_pick_render( const view& scene)
 {
 	if (degenerate())
 		return;
-	init_model();
 
 	size_t lod = 2;
 	clear_gl_error();
@@ -88,7 +74,7 @@ cylinder::gl_pick_render( const view& scene)
 	const double length = axis.mag();
 	model_world_transform( scene.gcf, vector( length, radius, radius ) ).gl_mult();
 
-	cylinder_simple_model[lod].gl_render();
+	lod_cache[lod].gl_render( scene);
 	check_gl_error();
 }
 
@@ -97,7 +83,6 @@ cylinder::gl_render( const view& scene)
 {
 	if (degenerate())
 		return;
-	init_model();
 
 	clear_gl_error();
 
@@ -134,15 +119,15 @@ cylinder::gl_render( const view& scene)
 
 		// Render the back half.
 		glCullFace( GL_FRONT);
-		cylinder_simple_model[lod].gl_render();
+		lod_cache[lod].gl_render( scene);
 
 		// Render the front half.
 		glCullFace( GL_BACK);
-		cylinder_simple_model[lod].gl_render();
+		lod_cache[lod].gl_render( scene);
 	}
 	else {
 		color.gl_set(opacity);
-		cylinder_simple_model[lod].gl_render();
+		lod_cache[lod].gl_render( scene);
 	}
 
 	// Cleanup.
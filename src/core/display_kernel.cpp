@@ -770,6 +770,7 @@ display_kernel::render_scene(void)
 		last_time = start_time;
 	}
 	try {
+		renderable::next_frame();
 		recalc_extent();
 		view scene_geometry( internal_forward.norm(), center, view_width,
 			view_height, forward_changed, gcf, gcfvec, gcf_changed, glext);
@@ -778,6 +779,7 @@ display_kernel::render_scene(void)
 		clear_gl_error();
 
 		on_gl_free.frame();
+		texture::next_frame();
 
 		glClearColor( background.red, background.green, background.blue, 0);
 		// Control which type of stereo to perform.
@@ -1065,11 +1067,14 @@ display_kernel::pick( int x, int y, float d_pixels)
 				best_pick_depth = min_hit_depth;
 				best_pick = name_table[*(hit_record+3)];
 				if (n_names > 1) {
-					// Then the picked object is the child of a frame.
+					// Then the picked object is the child of a frame, or an
+					// object that names its own parts.
 					frame* ref_frame = dynamic_cast<frame*>(best_pick.get());
-					assert(ref_frame != NULL);
-					best_pick = ref_frame->lookup_name(
-						hit_record + 4, hit_record + 3 + n_names);
+					if (ref_frame)
+						best_pick = ref_frame->lookup_name(
+							hit_record + 4, hit_record + 3 + n_names);
+					else
+						best_pick->pick_names( hit_record + 4, hit_record + 3 + n_names);
 				}
 			}
 			hit_record += 3 + n_names;
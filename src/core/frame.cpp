@@ -285,11 +285,11 @@ frame::lookup_name(
 
 	if (name_end - name_top > 1) {
 		frame* ref_frame = dynamic_cast<frame*>(ret.get());
-		assert( ref_frame != NULL);
-		return ref_frame->lookup_name(name_top + 1, name_end);
+		if (ref_frame)
+			return ref_frame->lookup_name(name_top + 1, name_end);
+		ret->pick_names( name_top + 1, name_end);
 	}
-	else
-		return ret;
+	return ret;
 }
 
 vector
@@ -40,7 +40,7 @@ material::set_translucent( bool t ) {
 	translucent = t;
 }
 
-apply_material::apply_material( const view& v, material* m, tmatrix& model_material )
+apply_material::apply_material( const view& v, material* m, tmatrix& model_material, bool two_sided )
  : v(v), sp( v, m ? m->shader.get() : NULL )
 {
 	if (!m || !sp.ok()) return;
@@ -73,6 +73,9 @@ apply_material::apply_material( const view& v, material* m, tmatrix& model_mater
 
 	if ( (loc = m->shader->get_uniform_location( v, "light_color" )) >= 0 && v.light_count[0] )
 		v.glext.glUniform4fvARB( loc, v.light_count[0], &v.light_color[0] );
+
+	if ( (loc = m->shader->get_uniform_location( v, "two_sided" )) >= 0 )
+		v.glext.glUniform1iARB( loc, two_sided );
 }
 
 apply_material::~apply_material() {
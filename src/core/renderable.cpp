@@ -53,6 +53,33 @@ view::pixel_coverage( const vector& pos, double radius) const
 
 }
 
+void
+view::gl_world_transform( const vector& origin) const
+{
+	// Composed here in double precision, rather than by the driver.
+	tmatrix m;
+	m.gl_modelview_get();
+	m.scale( gcfvec);
+	m.translate( origin);
+	m.gl_load();
+}
+
+namespace {
+unsigned long frame_count = 0;
+}
+
+void
+renderable::next_frame()
+{
+	++frame_count;
+}
+
+unsigned long
+renderable::frame()
+{
+	return frame_count;
+}
+
 renderable::renderable()
 	: visible(true), opacity( 1.0 )
 {
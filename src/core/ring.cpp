@@ -8,12 +8,12 @@
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
 
-#include <utility>
-#include <boost/scoped_array.hpp>
-using boost::scoped_array;
+#include <cmath>
 
 namespace cvisual {
 
+ring::model_cache_t ring::model_cache;
+
 bool
 ring::degenerate()
 {
@@ -21,7 +21,7 @@ ring::degenerate()
 }
 
 ring::ring()
-	: thickness(0.0), model_rings(-1)
+	: thickness(0.0)
 {
 }
 
@@ -66,24 +66,27 @@ ring::gl_render( const view& scene)
 	int rings = static_cast<int>( sqrt(ring_coverage * 4.0) );
 	rings = clamp( 4, rings, 80);
 
-	if (model_rings != rings || model_bands != bands || model_radius != radius || model_thickness != thickness) {
-		model_rings = rings; model_bands = bands; model_radius = radius; model_thickness = thickness;
-		create_model( rings, bands, model );
-	}
+	// Round the subdivisions up so that rings of similar size share a model.
+	rings = (rings + 7) / 8 * 8;
+	bands = (bands + 3) / 4 * 4;
+
+	// In Visual 3, rendered thickness was (incorrectly) double what was documented.
+	// The documentation said that thickness was the diameter of a cross section of
+	// a solid part of the ring, but in fact ring.thickness was the radius of the
+	// cross section. Presumably we have to maintain the incorrect Visual 3 behavior
+	// and change the documentation.
+	double scaled_thickness = 0.2;
+	if (thickness != 0.0) scaled_thickness = 2*thickness / radius;
+
+	mesh& model = get_model( scaled_thickness, rings, bands);
 
 	clear_gl_error();
 	{
-		gl_enable_client vertex_array( GL_VERTEX_ARRAY);
-		gl_enable_client normal_array( GL_NORMAL_ARRAY);
-
 		gl_matrix_stackguard guard;
 		model_world_transform( scene.gcf, vector(radius,radius,radius) ).gl_mult();
 
 		color.gl_set(opacity);
-
-		glVertexPointer( 3, GL_FLOAT, 0, &model.vertex_pos[0] );
-		glNormalPointer( GL_FLOAT, 0, &model.vertex_normal[0] );
-		glDrawElements( GL_TRIANGLES, model.indices.size(), GL_UNSIGNED_SHORT, &model.indices[0] );
+		model.gl_render( scene);
 	}
 
 	check_gl_error();
@@ -104,67 +107,17 @@ ring::grow_extent( extent& world)
 	world.add_body();
 }
 
-void
-ring::create_model( int rings, int bands, class model& m )
+mesh&
+ring::get_model( double thickness_ratio, int rings, int bands)
 {
-	// In Visual 3, rendered thickness was (incorrectly) double what was documented.
-	// The documentation said that thickness was the diameter of a cross section of
-	// a solid part of the ring, but in fact ring.thickness was the radius of the
-	// cross section. Presumably we have to maintain the incorrect Visual 3 behavior
-	// and change the documentation.
-	double scaled_radius = 1.0;
-	double scaled_thickness = 0.2;
-	if (thickness != 0.0) scaled_thickness = 2*thickness / radius;
-
-	// First generate a circle of radius thickness in the xy plane
-	if (bands > 80) throw std::logic_error("ring::create_model: More bands than expected.");
-	vector circle[80];
-	circle[0] = vector(0,scaled_thickness*0.5,0);
-	tmatrix rotator = rotation( 2.0 * M_PI / bands, vector( 0,0,1 ), vector( 0,0,0 ) );
-	for (int i = 1; i < bands; i ++)
-		circle[i] = rotator * circle[i-1];
-
-	m.vertex_pos.resize( rings * bands );
-	m.vertex_normal.resize( rings * bands );
-	fvertex* vertexes = &m.vertex_pos[0];
-	fvertex* normals = &m.vertex_normal[0];
-
-	// ... and then sweep it in a circle around the x axis
-	vector radial = vector(0,1,0);
-	int i=0;
-	rotator = rotation( 2.0 * M_PI / rings, vector( 1,0,0 ), vector( 0,0,0 ) );
-	for(int r=0; r<rings; r++) {
-		for(int b=0; b<bands; b++, i++) {
-			normals[i].x = circle[b].x;
-			normals[i].y = radial.y * circle[b].y;
-			normals[i].z = radial.z * circle[b].y;
-			vertexes[i].x = normals[i].x;
-			vertexes[i].y = normals[i].y + radial.y;
-			vertexes[i].z = normals[i].z + radial.z;
-		}
-		radial = rotator * radial;
-	}
-
-	// Now generate triangle indices... could do this with triangle strips but I'm looking
-	// ahead to next renderer design, where it would be nice to always use indexed tris
-	m.indices.resize( rings*bands*6 );
-	unsigned short *ind = &m.indices[0];
-	i = 0;
-	for(int r=0; r<rings; r++) {
-		for(int b=0; b<bands; b++,i++,ind+=6) {
-			ind[0] = i; ind[1] = i+bands; ind[2] = i+1;
-			ind[3] = i+bands; ind[4] = i+bands+1; ind[5] = i+1;
-		}
-		ind[2-6] -= bands;
-		ind[4-6] -= bands;
-		ind[5-6] -= bands;
-	}
-	ind -= 6*bands;
-	for(int b=0; b<bands; b++,ind+=6) {
-		ind[1] -= rings*bands;
-		ind[3] -= rings*bands;
-		ind[4] -= rings*bands;
+	// Ratios within 1% of each other share a model.
+	const int ratio_step = static_cast<int>( std::floor( std::log( std::fabs( thickness_ratio)) / std::log( 1.01) + 0.5));
+	shared_ptr<mesh>& model = model_cache[ model_key( ratio_step, rings, bands)];
+	if (!model) {
+		model.reset( new mesh);
+		make_torus_mesh( *model, rings, bands, 0.5 * std::pow( 1.01, ratio_step));
 	}
+	return *model;
 }
 
 void
@@ -4,7 +4,6 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "sphere.hpp"
-#include "util/quadric.hpp"
 #include "util/errors.hpp"
 #include "util/icososphere.hpp"
 #include "util/gl_enable.hpp"
@@ -13,7 +12,13 @@
 
 namespace cvisual {
 
-displaylist sphere::lod_cache[6];
+namespace {
+// The number of slices and stacks corresponding to each level of detail.
+const size_t sphere_slices[] = { 13, 19, 35, 55, 70, 140 };
+const size_t sphere_stacks[] = { 7, 11, 19, 29, 34, 69 };
+}
+
+lod_mesh_table sphere::lod_cache( &make_sphere_mesh, sphere_slices, sphere_stacks);
 
 sphere::sphere()
 {
@@ -33,14 +38,13 @@ sphere::gl_pick_render( const view& geometry)
 {
 	if (degenerate())
 		return;
-	init_model();
 
 	clear_gl_error();
 
 	gl_matrix_stackguard guard;
 	model_world_transform( geometry.gcf, get_scale() ).gl_mult();
 
-	lod_cache[0].gl_render();
+	lod_cache[0].gl_render( geometry);
 	check_gl_error();
 }
 
@@ -50,8 +54,6 @@ sphere::gl_render( const view& geometry)
 	if (degenerate())
 		return;
 
-	init_model();
-
 	clear_gl_error();
 	
 	// coverage is the radius of this sphere in pixels:
@@ -88,15 +90,15 @@ sphere::gl_render( const view& geometry)
 
 		// Render the back half (inside)
 		glCullFace( GL_FRONT );
-		lod_cache[lod].gl_render();
+		lod_cache[lod].gl_render( geometry);
 
 		// Render the front half (outside)
 		glCullFace( GL_BACK );
-		lod_cache[lod].gl_render();
+		lod_cache[lod].gl_render( geometry);
 	}
 	else {
 		// Render a simple sphere.
-		lod_cache[lod].gl_render();
+		lod_cache[lod].gl_render( geometry);
 	}
 	check_gl_error();
 }
@@ -109,40 +111,15 @@ sphere::grow_extent( extent& e)
 }
 
 void
-sphere::init_model()
+sphere::set_lod_triangles( int level, size_t triangles)
 {
-	if (lod_cache[0]) return;
-
-	clear_gl_error();
+	lod_cache.set_triangles( level, triangles);
+}
 
-	quadric sph;
-	
-	lod_cache[0].gl_compile_begin();
-	sph.render_sphere( 1.0, 13, 7);
-	lod_cache[0].gl_compile_end();
-
-	lod_cache[1].gl_compile_begin();
-	sph.render_sphere( 1.0, 19, 11);
-	lod_cache[1].gl_compile_end();
-
-	lod_cache[2].gl_compile_begin();
-	sph.render_sphere( 1.0, 35, 19);
-	lod_cache[2].gl_compile_end();
-
-	lod_cache[3].gl_compile_begin();
-	sph.render_sphere( 1.0, 55, 29);
-	lod_cache[3].gl_compile_end();
-
-	lod_cache[4].gl_compile_begin();
-	sph.render_sphere( 1.0, 70, 34);
-	lod_cache[4].gl_compile_end();
-
-	// Only for the very largest bodies.
-	lod_cache[5].gl_compile_begin();
-	sph.render_sphere( 1.0, 140, 69);
-	lod_cache[5].gl_compile_end();
-	
-	check_gl_error();
+size_t
+sphere::get_lod_triangles( int level)
+{
+	return lod_cache.get_triangles( level);
 }
 
 vector
@@ -178,6 +178,8 @@ void layout_texture::set_image( int width, int height, int gl_internal_format, i
 	
 	glTexImage2D( type, 0, gl_internal_format, tx_width, tx_height, 0, gl_format, gl_type, NULL );
 	check_gl_error();
+	set_resident_bytes( tx_width * tx_height *
+		(gl_internal_format == GL_ALPHA || gl_internal_format == GL_LUMINANCE ? 1 : 4) );
 	glTexSubImage2D(type, 0, 0, 0, width, height, gl_format, gl_type, data);
 	check_gl_error();
 
@@ -0,0 +1,326 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/convex_hull.hpp"
+#include "util/vector.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <cfloat>
+
+namespace cvisual {
+
+namespace {
+
+// A face of the walk over the faces that the eye is above: the edge to
+// cross next, and the number of edges left.
+struct step { int face, edge, left; };
+
+struct hull_face
+{
+	unsigned int v[3];
+	// The face across edge i, from v[i] to v[(i+1)%3], and the number of the
+	// same edge in it.
+	int next[3];
+	int next_edge[3];
+	vector normal;
+	double d;
+	std::vector<unsigned int> outside;  // points above this face
+	bool dead;
+};
+
+class quickhull
+{
+ public:
+	quickhull( const double* pos, double eps) : pos(pos), eps(eps) {}
+
+	void build( size_t n, const unsigned int simplex[4], std::vector<unsigned int>& out);
+
+ private:
+	const double* pos;
+	const double eps;
+	std::vector<hull_face> faces;
+
+	vector point( size_t i) const { return vector( pos + 3*i); }
+	double distance( const hull_face& f, size_t i) const
+	{ return f.normal.dot( point( i)) - f.d; }
+
+	int add_face( unsigned int a, unsigned int b, unsigned int c);
+	void link( int f, int e, int g, int ge);
+	// Give each point to the first of faces [first, last) that it is above.
+	void assign( const std::vector<unsigned int>& points, unsigned int skip,
+		int first, int last);
+};
+
+int
+quickhull::add_face( unsigned int a, unsigned int b, unsigned int c)
+{
+	faces.push_back( hull_face());
+	hull_face& f = faces.back();
+	f.v[0] = a;
+	f.v[1] = b;
+	f.v[2] = c;
+	const vector pa = point( a), pb = point( b), pc = point( c);
+	f.normal = (pb - pa).cross( pc - pa).norm();
+	f.d = f.normal.dot( (pa + pb + pc) / 3.0);
+	f.dead = false;
+	return faces.size() - 1;
+}
+
+void
+quickhull::link( int f, int e, int g, int ge)
+{
+	faces[f].next[e] = g;
+	faces[f].next_edge[e] = ge;
+	faces[g].next[ge] = f;
+	faces[g].next_edge[ge] = e;
+}
+
+void
+quickhull::assign( const std::vector<unsigned int>& points, unsigned int skip,
+	int first, int last)
+{
+	for (size_t i = 0; i < points.size(); ++i) {
+		if (points[i] == skip)
+			continue;
+		for (int f = first; f < last; ++f) {
+			if (distance( faces[f], points[i]) > eps) {
+				faces[f].outside.push_back( points[i]);
+				break;
+			}
+		}
+	}
+}
+
+void
+quickhull::build( size_t n, const unsigned int s[4], std::vector<unsigned int>& out)
+{
+	// A tetrahedron, with s[3] below the face s[0], s[1], s[2].
+	add_face( s[0], s[1], s[2]);
+	add_face( s[1], s[0], s[3]);
+	add_face( s[2], s[1], s[3]);
+	add_face( s[0], s[2], s[3]);
+	link( 0, 0, 1, 0);
+	link( 0, 1, 2, 0);
+	link( 0, 2, 3, 0);
+	link( 1, 1, 3, 2);
+	link( 1, 2, 2, 1);
+	link( 2, 2, 3, 1);
+
+	std::vector<unsigned int> rest;
+	rest.reserve( n);
+	for (size_t i = 0; i < n; ++i)
+		if (i != s[0] && i != s[1] && i != s[2] && i != s[3])
+			rest.push_back( i);
+	assign( rest, n, 0, 4);
+
+	std::vector<int> work;
+	for (int f = 0; f < 4; ++f)
+		if (!faces[f].outside.empty())
+			work.push_back( f);
+
+	std::vector<step> stack;
+	std::vector<int> visible;
+	std::vector<std::pair<int, int> > horizon;
+	std::vector<unsigned int> orphans;
+	while (!work.empty()) {
+		const int f = work.back();
+		work.pop_back();
+		if (faces[f].dead || faces[f].outside.empty())
+			continue;
+
+		// The point farthest above the face is certainly on the hull.
+		unsigned int eye = faces[f].outside[0];
+		double farthest = distance( faces[f], eye);
+		for (size_t i = 1; i < faces[f].outside.size(); ++i) {
+			const double d = distance( faces[f], faces[f].outside[i]);
+			if (d > farthest) {
+				farthest = d;
+				eye = faces[f].outside[i];
+			}
+		}
+
+		// Remove the faces that the eye is above, walking them depth first
+		// from f, so that the edges around them are found in order.
+		visible.assign( 1, f);
+		horizon.clear();
+		faces[f].dead = true;
+		const step first = { f, 0, 3 };
+		stack.assign( 1, first);
+		while (!stack.empty()) {
+			step& s = stack.back();
+			if (!s.left) {
+				stack.pop_back();
+				continue;
+			}
+			const int face = s.face;
+			const int e = s.edge;
+			s.edge = (e + 1) % 3;
+			--s.left;
+			const int g = faces[face].next[e];
+			if (faces[g].dead)
+				continue;
+			if (distance( faces[g], eye) > eps) {
+				faces[g].dead = true;
+				visible.push_back( g);
+				const step across = { g, (faces[face].next_edge[e] + 1) % 3, 2 };
+				stack.push_back( across);
+			}
+			else
+				horizon.push_back( std::make_pair( face, e));
+		}
+
+		// Cone the eye to the horizon.
+		const int first_new = faces.size();
+		for (size_t k = 0; k < horizon.size(); ++k) {
+			const int face = horizon[k].first;
+			const int e = horizon[k].second;
+			const unsigned int a = faces[face].v[e];
+			const unsigned int b = faces[face].v[(e + 1) % 3];
+			const int g = faces[face].next[e];
+			const int ge = faces[face].next_edge[e];
+			const int nf = add_face( a, b, eye);
+			link( nf, 0, g, ge);
+		}
+		const int h = horizon.size();
+		for (int k = 0; k < h; ++k)
+			link( first_new + k, 1, first_new + (k + 1) % h, 2);
+
+		for (size_t i = 0; i < visible.size(); ++i) {
+			orphans.clear();
+			orphans.swap( faces[visible[i]].outside);
+			assign( orphans, eye, first_new, first_new + h);
+		}
+		for (int k = first_new; k < first_new + h; ++k)
+			if (!faces[k].outside.empty())
+				work.push_back( k);
+	}
+
+	for (size_t f = 0; f < faces.size(); ++f) {
+		if (faces[f].dead)
+			continue;
+		out.push_back( faces[f].v[0]);
+		out.push_back( faces[f].v[1]);
+		out.push_back( faces[f].v[2]);
+	}
+}
+
+// The 2D hull, by Andrew's monotone chain, of points lying in the plane
+// through origin with the axes u and w, triangulated from its first corner
+// on both sides.
+void
+planar_hull( const double* pos, size_t n, const vector& origin,
+	const vector& u, const vector& w, double eps, std::vector<unsigned int>& out)
+{
+	typedef std::pair<std::pair<double, double>, unsigned int> point2;
+	std::vector<point2> points( n);
+	for (size_t i = 0; i < n; ++i) {
+		const vector p = vector( pos + 3*i) - origin;
+		points[i] = point2( std::make_pair( p.dot( u), p.dot( w)), i);
+	}
+	std::sort( points.begin(), points.end());
+
+	// The lower half, then back along the upper half.
+	std::vector<point2> chain( 2*n);
+	size_t k = 0;
+	size_t floor = 2;
+	for (size_t j = 0; j < 2*n - 1; ++j) {
+		if (j == n)
+			floor = k + 1;
+		const point2& p = j < n ? points[j] : points[2*n - 2 - j];
+		while (k >= floor) {
+			const point2& a = chain[k-2];
+			const point2& b = chain[k-1];
+			const double cross = (b.first.first - a.first.first) * (p.first.second - a.first.second)
+				- (b.first.second - a.first.second) * (p.first.first - a.first.first);
+			if (cross > eps)
+				break;
+			--k;
+		}
+		chain[k++] = p;
+	}
+	--k;  // The first point ends the upper half.
+	chain.resize( k);
+	if (k < 3)
+		return;
+	for (size_t i = 1; i + 1 < k; ++i) {
+		out.push_back( chain[0].second);
+		out.push_back( chain[i].second);
+		out.push_back( chain[i+1].second);
+		out.push_back( chain[0].second);
+		out.push_back( chain[i+1].second);
+		out.push_back( chain[i].second);
+	}
+}
+
+} // !namespace (anonymous)
+
+void
+convex_hull( const double* pos, size_t n, std::vector<unsigned int>& triangles)
+{
+	triangles.clear();
+	if (n < 3)
+		return;
+
+	// The tolerance grows with the size of the coordinates, as in qhull.
+	size_t lo[3] = { 0, 0, 0 }, hi[3] = { 0, 0, 0 };
+	double largest[3] = { 0, 0, 0 };
+	for (size_t i = 0; i < n; ++i) {
+		for (int k = 0; k < 3; ++k) {
+			const double x = pos[3*i+k];
+			if (x < pos[3*lo[k]+k])
+				lo[k] = i;
+			if (x > pos[3*hi[k]+k])
+				hi[k] = i;
+			largest[k] = std::max( largest[k], std::fabs( x));
+		}
+	}
+	const double eps = 3 * DBL_EPSILON * (largest[0] + largest[1] + largest[2]);
+
+	// Start from the widest pair of extreme points, the point farthest from
+	// the line through them, and the point farthest from the plane of all three.
+	unsigned int s[4];
+	double widest = -1;
+	for (int k = 0; k < 3; ++k) {
+		const double d = (vector( pos + 3*hi[k]) - vector( pos + 3*lo[k])).mag();
+		if (d > widest) {
+			widest = d;
+			s[0] = lo[k];
+			s[1] = hi[k];
+		}
+	}
+	if (widest <= eps)
+		return;
+	const vector origin( pos + 3*s[0]);
+	const vector axis = (vector( pos + 3*s[1]) - origin).norm();
+	double farthest = -1;
+	for (size_t i = 0; i < n; ++i) {
+		const double d = axis.cross( vector( pos + 3*i) - origin).mag();
+		if (d > farthest) {
+			farthest = d;
+			s[2] = i;
+		}
+	}
+	if (farthest <= eps)
+		return;
+	const vector normal = axis.cross( vector( pos + 3*s[2]) - origin).norm();
+	double height = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const double d = normal.dot( vector( pos + 3*i) - origin);
+		if (std::fabs( d) > std::fabs( height)) {
+			height = d;
+			s[3] = i;
+		}
+	}
+	if (std::fabs( height) <= eps) {
+		planar_hull( pos, n, origin, axis, normal.cross( axis), eps, triangles);
+		return;
+	}
+	if (height > 0)
+		std::swap( s[1], s[2]);
+
+	quickhull( pos, eps).build( n, s, triangles);
+}
+
+} // !namespace cvisual
@@ -0,0 +1,90 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/gl_buffer.hpp"
+#include "util/gl_free.hpp"
+#include "renderable.hpp"
+
+#include <boost/bind.hpp>
+
+namespace cvisual {
+
+gl_buffer::gl_buffer( GLenum t)
+	: target(t), handle(0), bytes(0), glDeleteBuffersARB(0)
+{
+}
+
+gl_buffer::gl_buffer( const gl_buffer& other)
+	: target(other.target), handle(0), bytes(0), glDeleteBuffersARB(0)
+{
+}
+
+gl_buffer&
+gl_buffer::operator=( const gl_buffer& other)
+{
+	if (this != &other) {
+		reset();
+		target = other.target;
+	}
+	return *this;
+}
+
+gl_buffer::~gl_buffer()
+{
+	reset();
+}
+
+void
+gl_buffer::reset()
+{
+	if (handle)
+		on_gl_free.free( boost::bind( &gl_buffer::gl_free, glDeleteBuffersARB, handle));
+	handle = 0;
+	bytes = 0;
+}
+
+bool
+gl_buffer::gl_bind( const view& v)
+{
+	if (!v.glext.ARB_vertex_buffer_object)
+		return false;
+	if (!handle) {
+		v.glext.glGenBuffersARB( 1, &handle);
+		glDeleteBuffersARB = v.glext.glDeleteBuffersARB;
+		on_gl_free.connect( boost::bind( &gl_buffer::gl_free, glDeleteBuffersARB, handle));
+	}
+	v.glext.glBindBufferARB( target, handle);
+	return true;
+}
+
+void
+gl_buffer::gl_unbind( const view& v)
+{
+	if (v.glext.ARB_vertex_buffer_object)
+		v.glext.glBindBufferARB( target, 0);
+}
+
+void
+gl_buffer::gl_set_data( const view& v, size_t n_bytes, const void* data, GLenum usage)
+{
+	if (!gl_bind( v))
+		return;
+	v.glext.glBufferDataARB( target, n_bytes, data, usage);
+	bytes = n_bytes;
+}
+
+void
+gl_buffer::gl_set_subdata( const view& v, size_t offset, size_t n_bytes, const void* data)
+{
+	if (!gl_bind( v))
+		return;
+	v.glext.glBufferSubDataARB( target, offset, n_bytes, data);
+}
+
+void
+gl_buffer::gl_free( PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB, unsigned int handle)
+{
+	glDeleteBuffersARB( 1, &handle);
+}
+
+} // !namespace cvisual
@@ -33,6 +33,7 @@ void gl_extensions::init( display_kernel& d ) {
 		F( glDeleteObjectARB );
 		F( glGetHandleARB );
 		F( glUniform1iARB );
+		F( glUniform1fARB );
 		F( glUniformMatrix4fvARB );
 		F( glUniform4fvARB );
 		F( glGetUniformLocationARB );
@@ -59,6 +60,29 @@ void gl_extensions::init( display_kernel& d ) {
 	if ( ARB_point_parameters = d.hasExtension( "GL_ARB_point_parameters" ) ) {
 		F( glPointParameterfvARB );
 	}
+
+	if ( ARB_vertex_buffer_object = d.hasExtension( "GL_ARB_vertex_buffer_object" ) ) {
+		F( glGenBuffersARB );
+		F( glBindBufferARB );
+		F( glBufferDataARB );
+		F( glBufferSubDataARB );
+		F( glMapBufferARB );
+		F( glUnmapBufferARB );
+		F( glDeleteBuffersARB );
+	}
+
+	ARB_pixel_buffer_object = ARB_vertex_buffer_object &&
+		( d.hasExtension( "GL_ARB_pixel_buffer_object" ) || d.hasExtension( "GL_EXT_pixel_buffer_object" ) );
+
+	SGIS_generate_mipmap = d.hasExtension( "GL_SGIS_generate_mipmap" );
+
+	ARB_texture_non_power_of_two = d.hasExtension( "GL_ARB_texture_non_power_of_two" );
+
+	ARB_texture_compression = d.hasExtension( "GL_ARB_texture_compression" );
+
+	ARB_half_float_vertex = d.hasExtension( "GL_ARB_half_float_vertex" );
+
+	ARB_point_sprite = d.hasExtension( "GL_ARB_point_sprite" );
 }
 
 } // namespace cvisual
@@ -0,0 +1,274 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/mesh.hpp"
+#include "util/gl_enable.hpp"
+#include "renderable.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace cvisual {
+
+mesh::mesh()
+	: vertex_buffer( GL_ARRAY_BUFFER_ARB), index_buffer( GL_ELEMENT_ARRAY_BUFFER_ARB),
+	uploaded(false)
+{
+}
+
+void
+mesh::clear()
+{
+	pos.clear();
+	normals.clear();
+	tex_coords.clear();
+	indices.clear();
+	uploaded = false;
+}
+
+unsigned int
+mesh::add_vertex( const vector& p, const vector& n, double s, double t)
+{
+	pos.push_back( p.x);
+	pos.push_back( p.y);
+	pos.push_back( p.z);
+	normals.push_back( n.x);
+	normals.push_back( n.y);
+	normals.push_back( n.z);
+	tex_coords.push_back( s);
+	tex_coords.push_back( t);
+	uploaded = false;
+	return vertex_count() - 1;
+}
+
+void
+mesh::add_triangle( unsigned int a, unsigned int b, unsigned int c)
+{
+	indices.push_back( a);
+	indices.push_back( b);
+	indices.push_back( c);
+	uploaded = false;
+}
+
+void
+mesh::gl_render( const view& v)
+{
+	if (indices.empty())
+		return;
+
+	const char* p = reinterpret_cast<const char*>( &pos[0]);
+	const char* n = reinterpret_cast<const char*>( &normals[0]);
+	const char* t = reinterpret_cast<const char*>( &tex_coords[0]);
+	const char* i = reinterpret_cast<const char*>( &indices[0]);
+
+	const bool buffered = vertex_buffer.gl_bind( v);
+	if (buffered) {
+		const size_t pos_bytes = pos.size() * sizeof(float);
+		const size_t tex_bytes = tex_coords.size() * sizeof(float);
+		if (!uploaded) {
+			vertex_buffer.gl_set_data( v, 2*pos_bytes + tex_bytes, 0);
+			vertex_buffer.gl_set_subdata( v, 0, pos_bytes, p);
+			vertex_buffer.gl_set_subdata( v, pos_bytes, pos_bytes, n);
+			vertex_buffer.gl_set_subdata( v, 2*pos_bytes, tex_bytes, t);
+			index_buffer.gl_set_data( v, indices.size() * sizeof(unsigned int), i);
+			uploaded = true;
+		}
+		index_buffer.gl_bind( v);
+		// Offsets into the bound buffers.
+		p = 0;
+		n = p + pos_bytes;
+		t = p + 2*pos_bytes;
+		i = 0;
+	}
+
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	gl_enable_client norms( GL_NORMAL_ARRAY);
+	gl_enable_client texcoords( GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer( 3, GL_FLOAT, 0, p);
+	glNormalPointer( GL_FLOAT, 0, n);
+	glTexCoordPointer( 2, GL_FLOAT, 0, t);
+	glDrawElements( GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, i);
+
+	if (buffered) {
+		index_buffer.gl_unbind( v);
+		vertex_buffer.gl_unbind( v);
+	}
+}
+
+void
+make_sphere_mesh( mesh& m, size_t slices, size_t stacks)
+{
+	m.clear();
+	stacks = std::max( stacks, size_t(2));
+	// A grid of (slices+1) x (stacks+1) vertexes; the first and last columns
+	// coincide so that the texture coordinates can wrap.
+	for (size_t j = 0; j <= stacks; ++j) {
+		const double phi = M_PI * j / stacks;
+		for (size_t i = 0; i <= slices; ++i) {
+			const double theta = 2 * M_PI * i / slices;
+			vector p( std::sin(phi) * std::cos(theta), std::sin(phi) * std::sin(theta),
+				std::cos(phi));
+			m.add_vertex( p, p, double(i) / slices, 1.0 - double(j) / stacks);
+		}
+	}
+	const size_t row = slices + 1;
+	for (size_t j = 0; j < stacks; ++j) {
+		for (size_t i = 0; i < slices; ++i) {
+			const unsigned int a = j*row + i;
+			const unsigned int b = a + 1;
+			const unsigned int c = a + row;
+			const unsigned int d = c + 1;
+			// The triangles touching the poles would be degenerate.
+			if (j != 0)
+				m.add_triangle( a, c, b);
+			if (j != stacks - 1)
+				m.add_triangle( b, c, d);
+		}
+	}
+}
+
+namespace {
+
+// A flat disk of unit radius in the plane x = x0, facing +x if facing > 0
+// and -x otherwise.
+void
+add_end_cap( mesh& m, size_t slices, double x0, double facing)
+{
+	const vector normal( facing > 0 ? 1 : -1, 0, 0);
+	const unsigned int center = m.add_vertex( vector(x0, 0, 0), normal, 0.5, 0.5);
+	for (size_t i = 0; i <= slices; ++i) {
+		const double theta = 2 * M_PI * i / slices;
+		const double c = std::cos(theta), s = std::sin(theta);
+		m.add_vertex( vector(x0, c, s), normal, 0.5 + 0.5*c, 0.5 + 0.5*s);
+	}
+	for (size_t i = 0; i < slices; ++i) {
+		if (facing > 0)
+			m.add_triangle( center, center+1+i, center+2+i);
+		else
+			m.add_triangle( center, center+2+i, center+1+i);
+	}
+}
+
+// The curved surface of a cylinder or cone along +x, with radius 1 at x=0
+// and radius top_radius at x=1.
+void
+add_tube( mesh& m, size_t slices, size_t stacks, double top_radius)
+{
+	// The outward normal of the surface r(x) = 1 + (top_radius-1)*x.
+	const double slope = 1.0 - top_radius;
+	const double norm = std::sqrt( 1 + slope*slope);
+
+	const unsigned int first = m.vertex_count();
+	for (size_t j = 0; j <= stacks; ++j) {
+		const double x = double(j) / stacks;
+		const double r = 1 + (top_radius - 1) * x;
+		for (size_t i = 0; i <= slices; ++i) {
+			const double theta = 2 * M_PI * i / slices;
+			const double c = std::cos(theta), s = std::sin(theta);
+			m.add_vertex( vector( x, r*c, r*s), vector( slope, c, s) / norm,
+				x, double(i) / slices);
+		}
+	}
+	const size_t row = slices + 1;
+	for (size_t j = 0; j < stacks; ++j) {
+		for (size_t i = 0; i < slices; ++i) {
+			const unsigned int a = first + j*row + i;
+			const unsigned int b = a + 1;
+			const unsigned int c = a + row;
+			const unsigned int d = c + 1;
+			m.add_triangle( a, b, c);
+			// At the tip of a cone this triangle would be degenerate.
+			if (top_radius != 0 || j != stacks - 1)
+				m.add_triangle( b, d, c);
+		}
+	}
+}
+
+} // !namespace (anonymous)
+
+void
+make_cylinder_mesh( mesh& m, size_t slices, size_t stacks)
+{
+	m.clear();
+	add_tube( m, slices, stacks, 1.0);
+	add_end_cap( m, slices, 0.0, -1);
+	add_end_cap( m, slices, 1.0, +1);
+}
+
+void
+make_cone_mesh( mesh& m, size_t slices, size_t stacks)
+{
+	m.clear();
+	add_tube( m, slices, stacks, 0.0);
+	add_end_cap( m, slices, 0.0, -1);
+}
+
+void
+make_torus_mesh( mesh& m, size_t rings, size_t bands, double tube_radius)
+{
+	m.clear();
+	for (size_t r = 0; r <= rings; ++r) {
+		const double phi = 2 * M_PI * r / rings;
+		const vector radial( 0, std::cos(phi), std::sin(phi));
+		for (size_t b = 0; b <= bands; ++b) {
+			const double theta = 2 * M_PI * b / bands;
+			const vector normal = radial * std::cos(theta) + vector( std::sin(theta), 0, 0);
+			m.add_vertex( radial + normal * tube_radius, normal,
+				double(r) / rings, double(b) / bands);
+		}
+	}
+	const size_t row = bands + 1;
+	for (size_t r = 0; r < rings; ++r) {
+		for (size_t b = 0; b < bands; ++b) {
+			const unsigned int i = r*row + b;
+			m.add_triangle( i, i + row, i + 1);
+			m.add_triangle( i + row, i + row + 1, i + 1);
+		}
+	}
+}
+
+lod_mesh_table::lod_mesh_table( generator g, const size_t n_slices[levels],
+	const size_t n_stacks[levels])
+	: make(g)
+{
+	for (int i = 0; i < levels; ++i) {
+		slices[i] = n_slices[i];
+		stacks[i] = n_stacks[i];
+		changed[i] = true;
+	}
+}
+
+mesh&
+lod_mesh_table::operator[]( int level)
+{
+	level = clamp( 0, level, levels-1);
+	if (changed[level]) {
+		changed[level] = false;
+		make( models[level], slices[level], stacks[level]);
+	}
+	return models[level];
+}
+
+void
+lod_mesh_table::set_triangles( int level, size_t triangles)
+{
+	if (level < 0 || level >= levels)
+		throw std::out_of_range( "level of detail must be between 0 and 5");
+	// Each slice of each stack contributes two triangles.
+	const double ratio = double(slices[level]) / stacks[level];
+	const double n_stacks = std::sqrt( triangles / (2*ratio));
+	stacks[level] = std::max( size_t(n_stacks + 0.5), size_t(1));
+	slices[level] = std::max( size_t(ratio*n_stacks + 0.5), size_t(3));
+	changed[level] = true;
+}
+
+size_t
+lod_mesh_table::get_triangles( int level)
+{
+	if (level < 0 || level >= levels)
+		throw std::out_of_range( "level of detail must be between 0 and 5");
+	return 2 * slices[level] * stacks[level];
+}
+
+} // !namespace cvisual
@@ -0,0 +1,59 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/parallel.hpp"
+#include "util/thread.hpp"
+
+#include <threadpool.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+
+namespace cvisual {
+
+namespace {
+mutex pool_lock;
+
+size_t
+processors()
+{
+	const size_t n = boost::thread::hardware_concurrency();
+	return n ? n : 1;
+}
+
+boost::threadpool::pool&
+workers()
+{
+	static boost::threadpool::pool* pool = NULL;
+	if (!pool)
+		pool = new boost::threadpool::pool( processors() - 1);
+	return *pool;
+}
+} // !namespace (anonymous)
+
+void
+parallel_for( size_t n, size_t grain, const boost::function<void (size_t, size_t)>& f)
+{
+	const size_t parts = std::min( processors(), n / std::max( grain, (size_t)1));
+	if (parts <= 1) {
+		if (n)
+			f( 0, n);
+		return;
+	}
+
+	lock L(pool_lock);
+	boost::threadpool::pool& pool = workers();
+	for (size_t i = 1; i < parts; ++i)
+		pool.schedule( boost::bind( f, n * i / parts, n * (i+1) / parts));
+	try {
+		f( 0, n / parts);
+	}
+	catch (...) {
+		// The other calls may be using the caller's data.
+		pool.wait();
+		throw;
+	}
+	pool.wait();
+}
+
+} // !namespace cvisual
@@ -0,0 +1,348 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/point_octree.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+namespace cvisual {
+
+namespace {
+const char magic[8] = { 'V', 'P', 'Y', 'O', 'C', 'T', '1', 0 };
+
+// Deeper than this, a node keeps all of its points, since they may be
+// identical and impossible to separate.
+const int max_depth = 24;
+
+// The records copied at once by streaming passes.
+const size_t chunk_records = 1 << 16;
+
+int
+octant( const point_octree::record& r, const vector& corner, double half)
+{
+	return (r.pos[0] >= corner.x + half ? 1 : 0)
+		| (r.pos[1] >= corner.y + half ? 2 : 0)
+		| (r.pos[2] >= corner.z + half ? 4 : 0);
+}
+
+vector
+octant_corner( int c, const vector& corner, double half)
+{
+	return corner + vector( c & 1 ? half : 0, c & 2 ? half : 0, c & 4 ? half : 0);
+}
+
+unsigned char
+color_byte( double c)
+{
+	return static_cast<unsigned char>(
+		std::floor( std::max( 0.0, std::min( 1.0, c)) * 255.0 + 0.5));
+}
+} // !namespace (anonymous)
+
+point_octree::point_octree( const std::string& filename)
+	: colored(false), total(0), file( filename.c_str(), std::ios::in | std::ios::binary)
+{
+	disk_header header;
+	if (!file.read( reinterpret_cast<char*>(&header), sizeof header)
+		|| std::memcmp( header.magic, magic, sizeof magic))
+		throw std::runtime_error( "Not a point cloud file: " + filename);
+	colored = header.colored != 0;
+	total = header.points;
+
+	std::vector<disk_node> entries( header.nodes);
+	file.seekg( static_cast<std::streamoff>(header.table));
+	if (entries.empty() || !file.read( reinterpret_cast<char*>(&entries[0]),
+			entries.size() * sizeof(disk_node)))
+		throw std::runtime_error( "Truncated point cloud file: " + filename);
+
+	table.resize( entries.size());
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const disk_node& e = entries[i];
+		node& n = table[i];
+		n.min_corner = vector( e.corner[0], e.corner[1], e.corner[2]);
+		n.max_corner = n.min_corner + vector( e.edge, e.edge, e.edge);
+		n.first = e.first;
+		n.count = e.count;
+		for (int c = 0; c < 8; ++c)
+			n.child[c] = e.child[c] < static_cast<boost::int32_t>(entries.size()) ? e.child[c] : -1;
+	}
+}
+
+void
+point_octree::read( size_t n, std::vector<record>& out)
+{
+	const node& source = table.at( n);
+	out.resize( source.count);
+	if (out.empty())
+		return;
+	lock L(file_lock);
+	file.clear();
+	file.seekg( static_cast<std::streamoff>(
+		sizeof(disk_header) + source.first * sizeof(record)));
+	if (!file.read( reinterpret_cast<char*>(&out[0]), out.size() * sizeof(record)))
+		throw std::runtime_error( "Truncated point cloud file");
+}
+
+point_octree_builder::point_octree_builder( const std::string& filename,
+	size_t node_points, size_t in_core_points)
+	: filename( filename), node_points( std::max( node_points, size_t(1))),
+	in_core_points( std::max( in_core_points, node_points)),
+	spill_name( filename + ".tmp"), count(0), colored(-1), finished(false),
+	written(0), spill_serial(0), random_state(2463534242u)
+{
+	spill.open( spill_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!spill)
+		throw std::runtime_error( "Can't write " + spill_name);
+}
+
+point_octree_builder::~point_octree_builder()
+{
+	if (!finished) {
+		spill.close();
+		std::remove( spill_name.c_str());
+	}
+}
+
+boost::uint32_t
+point_octree_builder::random()
+{
+	// xorshift32
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+void
+point_octree_builder::add( const double* pos, const double* color, size_t n)
+{
+	if (finished)
+		throw std::invalid_argument( "The point cloud has already been written.");
+	if (colored == -1)
+		colored = color ? 1 : 0;
+	else if (colored != (color ? 1 : 0))
+		throw std::invalid_argument( "Colors must be given for all points or none.");
+
+	std::vector<point_octree::record> chunk( std::min( n, chunk_records));
+	for (size_t done = 0; done < n; ) {
+		const size_t block = std::min( n - done, chunk_records);
+		for (size_t i = 0; i < block; ++i) {
+			point_octree::record& r = chunk[i];
+			const double* p = pos + 3*(done + i);
+			const vector v( p);
+			if (!count && !done && !i)
+				lo = hi = v;
+			lo = vector( std::min( lo.x, v.x), std::min( lo.y, v.y), std::min( lo.z, v.z));
+			hi = vector( std::max( hi.x, v.x), std::max( hi.y, v.y), std::max( hi.z, v.z));
+			for (int d = 0; d < 3; ++d) {
+				r.pos[d] = static_cast<float>( p[d]);
+				r.color[d] = color ? color_byte( color[3*(done + i) + d]) : 255;
+			}
+			r.color[3] = 255;
+		}
+		spill.write( reinterpret_cast<const char*>(&chunk[0]), block * sizeof(point_octree::record));
+		done += block;
+	}
+	if (!spill)
+		throw std::runtime_error( "Can't write " + spill_name);
+	count += n;
+}
+
+void
+point_octree_builder::finish()
+{
+	if (finished)
+		throw std::invalid_argument( "The point cloud has already been written.");
+	if (!count)
+		throw std::invalid_argument( "A point cloud must have at least one point.");
+	spill.close();
+	finished = true;
+
+	out.open( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::runtime_error( "Can't write " + filename);
+	point_octree::disk_header header;
+	std::memcpy( header.magic, magic, sizeof magic);
+	header.colored = colored == 1;
+	header.nodes = 0;
+	header.points = count;
+	header.table = 0;
+	out.write( reinterpret_cast<const char*>(&header), sizeof header);
+
+	// The root is the cube that just encloses the points.
+	const vector extent = hi - lo;
+	double edge = std::max( extent.x, std::max( extent.y, extent.z));
+	if (edge <= 0.0)
+		edge = 1.0;
+	build( spill_name, count, lo, edge * (1 + 1e-6), 0);
+	std::remove( spill_name.c_str());
+
+	header.nodes = table.size();
+	header.table = sizeof header + written * sizeof(point_octree::record);
+	out.write( reinterpret_cast<const char*>(&table[0]), table.size() * sizeof(table[0]));
+	out.seekp( 0);
+	out.write( reinterpret_cast<const char*>(&header), sizeof header);
+	out.close();
+	if (!out)
+		throw std::runtime_error( "Can't write " + filename);
+	table.clear();
+}
+
+int
+point_octree_builder::add_node( const point_octree::record* points, size_t n,
+	const vector& corner, double edge)
+{
+	point_octree::disk_node d;
+	std::memset( &d, 0, sizeof d);
+	d.first = written;
+	d.count = n;
+	for (int c = 0; c < 8; ++c)
+		d.child[c] = -1;
+	d.corner[0] = corner.x;
+	d.corner[1] = corner.y;
+	d.corner[2] = corner.z;
+	d.edge = edge;
+	if (n)
+		out.write( reinterpret_cast<const char*>(points), n * sizeof(point_octree::record));
+	written += n;
+	table.push_back( d);
+	return table.size() - 1;
+}
+
+int
+point_octree_builder::build_in_core( point_octree::record* begin, point_octree::record* end,
+	const vector& corner, double edge, int depth)
+{
+	// The points are in random order, so any prefix is a fair sample, and
+	// the stable partition below keeps each octant in random order too.
+	const size_t n = end - begin;
+	const size_t k = depth >= max_depth ? n : std::min( n, node_points);
+	const int node = add_node( begin, k, corner, edge);
+	if (k == n)
+		return node;
+
+	const double half = edge * 0.5;
+	size_t offsets[9] = { 0 };
+	for (point_octree::record* i = begin + k; i != end; ++i)
+		++offsets[octant( *i, corner, half) + 1];
+	for (int c = 0; c < 8; ++c)
+		offsets[c+1] += offsets[c];
+	std::vector<point_octree::record> sorted( n - k);
+	size_t next[8];
+	std::copy( offsets, offsets + 8, next);
+	for (point_octree::record* i = begin + k; i != end; ++i)
+		sorted[next[octant( *i, corner, half)]++] = *i;
+	std::copy( sorted.begin(), sorted.end(), begin + k);
+	sorted.clear();
+
+	for (int c = 0; c < 8; ++c) {
+		if (offsets[c] == offsets[c+1])
+			continue;
+		const int child = build_in_core( begin + k + offsets[c], begin + k + offsets[c+1],
+			octant_corner( c, corner, half), half, depth + 1);
+		table[node].child[c] = child;
+	}
+	return node;
+}
+
+int
+point_octree_builder::build_leaf( std::ifstream& source, boost::uint64_t n,
+	const vector& corner, double edge)
+{
+	const int node = add_node( 0, 0, corner, edge);
+	std::vector<point_octree::record> chunk( chunk_records);
+	for (boost::uint64_t done = 0; done < n; ) {
+		const size_t block = static_cast<size_t>( std::min<boost::uint64_t>( n - done, chunk_records));
+		source.read( reinterpret_cast<char*>(&chunk[0]), block * sizeof(point_octree::record));
+		out.write( reinterpret_cast<const char*>(&chunk[0]), block * sizeof(point_octree::record));
+		done += block;
+	}
+	written += n;
+	table[node].count = n;
+	return node;
+}
+
+int
+point_octree_builder::build( const std::string& source_name, boost::uint64_t n,
+	const vector& corner, double edge, int depth)
+{
+	std::ifstream source( source_name.c_str(), std::ios::in | std::ios::binary);
+	if (!source)
+		throw std::runtime_error( "Can't read " + source_name);
+
+	if (n <= in_core_points) {
+		// Shuffle the points, then split them in memory.
+		std::vector<point_octree::record> points( static_cast<size_t>(n));
+		source.read( reinterpret_cast<char*>(&points[0]), points.size() * sizeof(points[0]));
+		if (!source)
+			throw std::runtime_error( "Can't read " + source_name);
+		for (size_t i = points.size() - 1; i > 0; --i)
+			std::swap( points[i], points[random() % (i + 1)]);
+		return build_in_core( &points[0], &points[0] + points.size(), corner, edge, depth);
+	}
+	if (depth >= max_depth)
+		return build_leaf( source, n, corner, edge);
+
+	// Too many points to hold: draw this node's sample by reservoir sampling
+	// while passing every other point to a file for its octant.
+	const double half = edge * 0.5;
+	std::vector<std::string> child_names( 8);
+	std::vector<boost::uint64_t> child_counts( 8);
+	std::ofstream children[8];
+	for (int c = 0; c < 8; ++c) {
+		std::ostringstream name;
+		name << spill_name << '.' << spill_serial++;
+		child_names[c] = name.str();
+		children[c].open( child_names[c].c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!children[c])
+			throw std::runtime_error( "Can't write " + child_names[c]);
+	}
+
+	std::vector<point_octree::record> sample( node_points);
+	std::vector<point_octree::record> chunk( chunk_records);
+	boost::uint64_t seen = 0;
+	while (seen < n) {
+		const size_t block = static_cast<size_t>( std::min<boost::uint64_t>( n - seen, chunk_records));
+		source.read( reinterpret_cast<char*>(&chunk[0]), block * sizeof(point_octree::record));
+		if (!source)
+			throw std::runtime_error( "Can't read " + source_name);
+		for (size_t i = 0; i < block; ++i, ++seen) {
+			point_octree::record r = chunk[i];
+			if (seen < node_points) {
+				sample[seen] = r;
+				continue;
+			}
+			const boost::uint64_t j = ((boost::uint64_t(random()) << 32) | random()) % (seen + 1);
+			if (j < node_points)
+				std::swap( r, sample[j]);
+			const int c = octant( r, corner, half);
+			children[c].write( reinterpret_cast<const char*>(&r), sizeof r);
+			++child_counts[c];
+		}
+	}
+	source.close();
+	for (int c = 0; c < 8; ++c) {
+		children[c].close();
+		if (!children[c])
+			throw std::runtime_error( "Can't write " + child_names[c]);
+	}
+
+	const int node = add_node( &sample[0], sample.size(), corner, edge);
+	sample.clear();
+	for (int c = 0; c < 8; ++c) {
+		if (child_counts[c]) {
+			const int child = build( child_names[c], child_counts[c],
+				octant_corner( c, corner, half), half, depth + 1);
+			table[node].child[c] = child;
+		}
+		std::remove( child_names[c].c_str());
+	}
+	return node;
+}
+
+} // !namespace cvisual
@@ -0,0 +1,93 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/point_shader.hpp"
+#include "util/tmatrix.hpp"
+
+namespace cvisual {
+
+namespace {
+const char* point_shader_source =
+	"[varying]\n"
+	"varying vec3 center;\n"  // eye space center of the point
+	"[vertex]\n"
+	"uniform float pixel_size;\n"
+	"uniform float world_size;\n"  // pixels across at an eye space depth of 1
+	"void main() {\n"
+	"	vec4 eye = gl_ModelViewMatrix * gl_Vertex;\n"
+	"	center = eye.xyz;\n"
+	"	gl_Position = gl_ProjectionMatrix * eye;\n"
+	"	gl_PointSize = pixel_size > 0.0 ? pixel_size : world_size / max( -eye.z, 1e-6);\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"	gl_TexCoord[0] = vec4( 0.0);\n"  // replaced by the sprite coordinates
+	"}\n"
+	"[fragment]\n"
+	"uniform int shape;\n"  // DISK, SQUARE, or SPHERE
+	"uniform int light_count;\n"
+	"uniform vec4 light_pos[8];\n"
+	"uniform vec4 light_color[8];\n"
+	"void main() {\n"
+	"	vec2 p = gl_TexCoord[0].xy * 2.0 - 1.0;\n"
+	"	float r2 = dot( p, p);\n"
+	"	if (shape != 1 && r2 > 1.0) discard;\n"
+	"	vec3 color = gl_Color.rgb;\n"
+	"	if (shape == 2) {\n"
+	"		vec3 normal = vec3( p.x, -p.y, sqrt( 1.0 - r2));\n"
+	"		color = gl_LightModel.ambient.rgb * gl_Color.rgb;\n"
+	"		for (int i = 0; i < 8; i++) {\n"
+	"			if (i < light_count) {\n"
+	"				vec3 L = normalize( light_pos[i].xyz - center*light_pos[i].w);\n"
+	"				color += light_color[i].rgb * max( dot( normal, L), 0.0) * gl_Color.rgb;\n"
+	"			}\n"
+	"		}\n"
+	"	}\n"
+	"	gl_FragColor = vec4( color, gl_Color.a);\n"
+	"}\n";
+
+shader_program point_shader( point_shader_source);
+
+shader_program*
+point_shader_if_usable( const view& v)
+{
+	if (!v.enable_shaders || !v.glext.ARB_shader_objects || !v.glext.ARB_point_sprite)
+		return 0;
+	return &point_shader;
+}
+} // !namespace (anonymous)
+
+use_point_shader::use_point_shader( const view& v, shape s, double pixel_size, double world_size)
+	: program( v, point_shader_if_usable( v)), sprites( false)
+{
+	if (!program.ok())
+		return;
+	sprites = true;
+
+	int loc;
+	if ((loc = point_shader.get_uniform_location( v, "shape")) >= 0)
+		v.glext.glUniform1iARB( loc, s);
+	if ((loc = point_shader.get_uniform_location( v, "pixel_size")) >= 0)
+		v.glext.glUniform1fARB( loc, pixel_size);
+	if ((loc = point_shader.get_uniform_location( v, "world_size")) >= 0)
+		v.glext.glUniform1fARB( loc, world_size);
+	if ((loc = point_shader.get_uniform_location( v, "light_count")) >= 0)
+		v.glext.glUniform1iARB( loc, v.light_count[0]);
+	if ((loc = point_shader.get_uniform_location( v, "light_pos")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( loc, v.light_count[0], &v.light_pos[0]);
+	if ((loc = point_shader.get_uniform_location( v, "light_color")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( loc, v.light_count[0], &v.light_color[0]);
+
+	glEnable( GL_VERTEX_PROGRAM_POINT_SIZE_ARB);
+	glEnable( GL_POINT_SPRITE_ARB);
+	glTexEnvi( GL_POINT_SPRITE_ARB, GL_COORD_REPLACE_ARB, GL_TRUE);
+}
+
+use_point_shader::~use_point_shader()
+{
+	if (!sprites)
+		return;
+	glTexEnvi( GL_POINT_SPRITE_ARB, GL_COORD_REPLACE_ARB, GL_FALSE);
+	glDisable( GL_POINT_SPRITE_ARB);
+	glDisable( GL_VERTEX_PROGRAM_POINT_SIZE_ARB);
+}
+
+} // !namespace cvisual
@@ -0,0 +1,113 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/polyline_lod.hpp"
+
+#include <algorithm>
+
+namespace cvisual {
+
+namespace {
+// The distance from p to the segment from a to b.
+double
+segment_distance( const vector& p, const vector& a, const vector& b)
+{
+	const vector ab = b - a;
+	const double len2 = ab.mag2();
+	double t = len2 ? (p - a).dot( ab) / len2 : 0.0;
+	t = std::max( 0.0, std::min( 1.0, t));
+	return (p - (a + ab*t)).mag();
+}
+} // !namespace (anonymous)
+
+polyline_lod::polyline_lod()
+{
+	clear();
+}
+
+void
+polyline_lod::clear()
+{
+	begin = end = 0;
+	for (int level = 0; level < max_levels; ++level) {
+		span_error[level].clear();
+		node_first[level] = 0;
+	}
+	std::fill( level_error, level_error + max_levels, 0.0);
+	level_error_stale = false;
+}
+
+void
+polyline_lod::update( const double* pos, size_t first, size_t n)
+{
+	if (first < begin || first > end) {
+		clear();
+		begin = end = first;
+	}
+	if (first > begin) {
+		// Drop the spans that start before the first point.
+		for (int level = 1; level < max_levels; ++level) {
+			std::deque<double>& spans = span_error[level];
+			while (!spans.empty() && (node_first[level] << level) < first) {
+				spans.pop_front();
+				++node_first[level];
+			}
+		}
+		begin = first;
+		level_error_stale = true;
+	}
+
+	for (size_t h = end; h < first + n; ++h) {
+		// Point h completes the span that ends at it on every level whose
+		// stride divides h.
+		const vector p( pos + 3*(h - first));
+		for (int level = 1; level < max_levels; ++level) {
+			const size_t stride = size_t(1) << level;
+			if (h % stride || h < begin + stride)
+				break;
+			const size_t a_i = h - stride - first;
+			const vector a( pos + 3*a_i);
+			double worst = 0.0;
+			for (size_t j = a_i + 1; j < h - first; ++j)
+				worst = std::max( worst, segment_distance( vector( pos + 3*j), a, p));
+			if (span_error[level].empty())
+				node_first[level] = h/stride - 1;
+			span_error[level].push_back( worst);
+			level_error[level] = std::max( level_error[level], worst);
+		}
+	}
+	end = first + n;
+}
+
+int
+polyline_lod::levels() const
+{
+	int ret = 1;
+	while (ret < max_levels && (size_t(1) << ret) < size())
+		++ret;
+	return ret;
+}
+
+double
+polyline_lod::error( int level) const
+{
+	if (level_error_stale) {
+		for (int i = 1; i < max_levels; ++i)
+			level_error[i] = span_error[i].empty() ? 0.0
+				: *std::max_element( span_error[i].begin(), span_error[i].end());
+		level_error_stale = false;
+	}
+	double ret = 0.0;
+	for (int i = 1; i <= level && i < max_levels; ++i)
+		ret = std::max( ret, level_error[i]);
+	return ret;
+}
+
+void
+polyline_lod::indices( int level, std::vector<unsigned int>& out) const
+{
+	accept_all accept;
+	walk( level, accept, out);
+}
+
+} // !namespace cvisual
@@ -11,13 +11,30 @@ using boost::lexical_cast;
 
 namespace cvisual {
 
+namespace {
+// Shared by all textures; guards the memory accounting below.
+mutex budget_mtx;
+std::list<texture*> lru;
+size_t total_bytes = 0;
+size_t budget_bytes = 0;
+unsigned long frame_count = 0;
+bool compression = false;
+} // !namespace (anonymous)
+
 texture::texture()
-	: damaged(false), handle(0), have_opacity(false)
+	: damaged(false), handle(0), resident_bytes(0), last_used(0), listed(false),
+	have_opacity(false)
 {
 }
 
 texture::~texture()
 {
+	{
+		lock L(budget_mtx);
+		if (listed)
+			lru.erase( lru_position);
+		total_bytes -= resident_bytes;
+	}
 	if (handle) on_gl_free.free( boost::bind( &gl_free, handle ) );
 }
 
@@ -43,7 +60,14 @@ texture::gl_activate(const view& v)
 		check_gl_error();
 	}
 	if (!handle) return;
-	
+
+	{
+		lock L(budget_mtx);
+		last_used = frame_count;
+		if (listed)
+			lru.splice( lru.begin(), lru, lru_position);
+	}
+
 	glBindTexture( enable_type(), handle );
 	this->gl_transform();
 	check_gl_error();
@@ -64,6 +88,115 @@ texture::set_handle( const view&, unsigned h ) {
 	VPYTHON_NOTE( "Allocated texture number " + lexical_cast<std::string>(handle));
 }
 
+void
+texture::set_resident_bytes( size_t bytes)
+{
+	lock L(budget_mtx);
+	total_bytes += bytes - resident_bytes;
+	resident_bytes = bytes;
+	last_used = frame_count;
+	if (!listed) {
+		lru_position = lru.insert( lru.begin(), this);
+		listed = true;
+	}
+	else
+		lru.splice( lru.begin(), lru, lru_position);
+}
+
+int
+texture::fit_memory_budget( size_t bytes)
+{
+	lock L(budget_mtx);
+	if (!budget_bytes)
+		return 0;
+
+	// Release the least recently used textures that aren't needed for the
+	// frame in progress, until this one fits.
+	std::list<texture*>::reverse_iterator i = lru.rbegin();
+	while (total_bytes - resident_bytes + bytes > budget_bytes && i != lru.rend()) {
+		texture* victim = *i;
+		++i;
+		if (victim == this || victim->last_used == frame_count)
+			continue;
+		victim->evict();
+	}
+
+	int reduction = 0;
+	while (total_bytes - resident_bytes + (bytes >> 2*reduction) > budget_bytes
+			&& (bytes >> 2*reduction) > 4096)
+		++reduction;
+	return reduction;
+}
+
+void
+texture::evict()
+{
+	// Called with budget_mtx held.
+	VPYTHON_NOTE( "Evicting texture number " + lexical_cast<std::string>(handle));
+	if (listed) {
+		lru.erase( lru_position);
+		listed = false;
+	}
+	total_bytes -= resident_bytes;
+	resident_bytes = 0;
+	if (handle) on_gl_free.free( boost::bind( &gl_free, handle ) );
+	handle = 0;
+	damaged = true;
+}
+
+size_t
+texture::get_resident_bytes() const
+{
+	return resident_bytes;
+}
+
+size_t
+texture::get_total_resident_bytes()
+{
+	lock L(budget_mtx);
+	return total_bytes;
+}
+
+size_t
+texture::get_resident_count()
+{
+	lock L(budget_mtx);
+	return lru.size();
+}
+
+void
+texture::set_memory_budget( size_t bytes)
+{
+	lock L(budget_mtx);
+	budget_bytes = bytes;
+}
+
+size_t
+texture::get_memory_budget()
+{
+	lock L(budget_mtx);
+	return budget_bytes;
+}
+
+void
+texture::set_compression( bool c)
+{
+	compression = c;
+}
+
+bool
+texture::get_compression()
+{
+	return compression;
+}
+
+void
+texture::next_frame()
+{
+	lock L(budget_mtx);
+	++frame_count;
+}
+
 void
 texture::gl_free(GLuint handle)
 {
@@ -0,0 +1,75 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/tube_shader.hpp"
+
+namespace cvisual {
+
+namespace {
+const char* tube_shader_source =
+	"[varying]\n"
+	"varying vec3 position;\n" // eye space position on the ribbon
+	"varying vec3 across;\n"   // eye space unit vector across the ribbon
+	"varying float side;\n"    // -1 to 1 across the ribbon
+	"[vertex]\n"
+	"uniform float scale;\n"
+	"void main() {\n"
+	"	vec3 here = vec3( gl_ModelViewMatrix * vec4( gl_Vertex.xyz, 1.0));\n"
+	"	vec3 prev = vec3( gl_ModelViewMatrix * vec4( gl_MultiTexCoord0.xyz, 1.0));\n"
+	"	vec3 next = vec3( gl_ModelViewMatrix * vec4( gl_Normal, 1.0));\n"
+	"	vec3 to_eye = normalize( -here);\n"
+	"	vec3 n1 = cross( here - prev, to_eye);\n"
+	"	vec3 n2 = cross( next - here, to_eye);\n"
+	"	if (dot( n1, n1) == 0.0) n1 = n2;\n"  // at the ends of an open line
+	"	if (dot( n2, n2) == 0.0) n2 = n1;\n"
+	"	if (dot( n1, n1) == 0.0) { n1 = vec3( 0.0, 1.0, 0.0); n2 = n1; }\n"
+	"	n1 = normalize( n1);\n"
+	"	n2 = normalize( n2);\n"
+	"	vec3 miter = n1 + n2;\n"
+	"	miter = dot( miter, miter) > 1e-6 ? normalize( miter) : n1;\n"
+	"	float stretch = 1.0 / max( dot( miter, n1), 0.25);\n"
+	"	side = sign( gl_Vertex.w);\n"
+	"	across = miter;\n"
+	"	position = here + miter * (scale * stretch * gl_Vertex.w);\n"
+	"	gl_Position = gl_ProjectionMatrix * vec4( position, 1.0);\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"}\n"
+	"[fragment]\n"
+	"uniform int light_count;\n"
+	"uniform vec4 light_pos[8];\n"
+	"uniform vec4 light_color[8];\n"
+	"void main() {\n"
+	"	vec3 to_eye = normalize( -position);\n"
+	"	float s = clamp( side, -1.0, 1.0);\n"
+	"	vec3 normal = normalize( across*s + to_eye*sqrt( 1.0 - s*s));\n"
+	"	vec3 color = gl_LightModel.ambient.rgb * gl_Color.rgb;\n"
+	"	for (int i = 0; i < 8; i++) {\n"
+	"		if (i < light_count) {\n"
+	"			vec3 L = normalize( light_pos[i].xyz - position*light_pos[i].w);\n"
+	"			color += light_color[i].rgb * max( dot( normal, L), 0.0) * gl_Color.rgb;\n"
+	"		}\n"
+	"	}\n"
+	"	gl_FragColor = vec4( color, gl_Color.a);\n"
+	"}\n";
+
+shader_program tube_shader( tube_shader_source);
+} // !namespace (anonymous)
+
+use_tube_shader::use_tube_shader( const view& v, double scale)
+	: program( v, tube_shader)
+{
+	if (!program.ok())
+		return;
+
+	int loc;
+	if ((loc = tube_shader.get_uniform_location( v, "scale")) >= 0)
+		v.glext.glUniform1fARB( loc, scale);
+	if ((loc = tube_shader.get_uniform_location( v, "light_count")) >= 0)
+		v.glext.glUniform1iARB( loc, v.light_count[0]);
+	if ((loc = tube_shader.get_uniform_location( v, "light_pos")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( loc, v.light_count[0], &v.light_pos[0]);
+	if ((loc = tube_shader.get_uniform_location( v, "light_color")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( loc, v.light_count[0], &v.light_color[0]);
+}
+
+} // !namespace cvisual
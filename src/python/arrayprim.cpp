@@ -1,52 +1,370 @@
 #include "python/arrayprim.hpp"
 #include "python/slice.hpp"
 
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+
 namespace cvisual { namespace python {
 
 using boost::python::object;
-using boost::python::make_tuple;
 using boost::python::tuple;
 
+namespace {
+// IEEE half precision, as numpy's float16 stores it.
+double
+half_to_double( npy_uint16 h)
+{
+	const int exponent = (h >> 10) & 0x1f;
+	const double mantissa = h & 0x3ff;
+	double ret;
+	if (exponent == 0)
+		ret = std::ldexp( mantissa, -24);
+	else if (exponent == 31)
+		ret = mantissa ? std::numeric_limits<double>::quiet_NaN()
+			: std::numeric_limits<double>::infinity();
+	else
+		ret = std::ldexp( mantissa + 1024, exponent - 25);
+	return (h & 0x8000) ? -ret : ret;
+}
+
+npy_uint16
+double_to_half( double d)
+{
+	npy_uint16 sign = 0;
+	if (d < 0) {
+		sign = 0x8000;
+		d = -d;
+	}
+	if (d != d)
+		return 0x7e00;
+	if (d >= 65520.0)
+		return sign | 0x7c00;
+	int exponent;
+	std::frexp( d, &exponent);  // d = f * 2^exponent, with f in [0.5, 1)
+	if (exponent < -13)  // subnormal
+		return sign | npy_uint16( d * 16777216.0 + 0.5);
+	const double mantissa = std::ldexp( d, 11 - exponent) - 1024;  // in [0, 1024)
+	npy_uint16 bits = npy_uint16( ((exponent + 14) << 10) + npy_uint16( mantissa + 0.5));
+	return sign | bits;  // rounding up into the next exponent carries correctly
+}
+
+double
+stored_element( const void* p, int storage, size_t i)
+{
+	switch (storage) {
+		case NPY_DOUBLE: return ((const double*)p)[i];
+		case NPY_FLOAT: return ((const float*)p)[i];
+		case NPY_HALF: return half_to_double( ((const npy_uint16*)p)[i]);
+		case NPY_UBYTE: return ((const npy_uint8*)p)[i];
+		default: return 0.0;
+	}
+}
+
+void
+store_element( void* p, int storage, size_t i, double value)
+{
+	switch (storage) {
+		case NPY_DOUBLE: ((double*)p)[i] = value; break;
+		case NPY_FLOAT: ((float*)p)[i] = value; break;
+		case NPY_HALF: ((npy_uint16*)p)[i] = double_to_half( value); break;
+		case NPY_UBYTE:
+			((npy_uint8*)p)[i] = npy_uint8( std::max( 0.0, std::min( 255.0, value + 0.5)));
+			break;
+		default: break;
+	}
+}
+} // !namespace (anonymous)
+
 template <class CTYPE>
 arrayprim_array<CTYPE>::arrayprim_array()
- : array(NULL), length(0), allocated(256)
+ : array(NULL), length(0), allocated(256), head(0),
+	storage(type_npy_traits<CTYPE>::npy_type), itemsize(sizeof(CTYPE)), scale(1.0),
+	log_next(0), log_used(0), version(0), log_floor(0), dropped(0), watched(0),
+	exposed(false), seen_frame(0), adopted(false)
 {
 	std::vector<npy_intp> dims(2);
 	dims[0] = allocated;
 	dims[1] = 3;
-	array::operator=( makeNum( dims, (NPY_TYPES)type_npy_traits<CTYPE>::npy_type ) );
+	array::operator=( makeNum( dims, (NPY_TYPES)storage ) );
 }
 
 template <class CTYPE>
-void arrayprim_array<CTYPE>::set_length( size_t new_len ) {
-	using cvisual::python::slice;
+arrayprim_array<CTYPE>::arrayprim_array( const arrayprim_array& r )
+ : array(NULL), length(r.length), allocated(r.allocated), head(r.head),
+	storage(r.storage), itemsize(r.itemsize), scale(r.scale),
+	log_next(0), log_used(0), version(r.version), log_floor(r.version),
+	dropped(r.dropped), watched(r.watched), exposed(false), seen_frame(0), adopted(false)
+{
+	// The storage is always copied, so that sliding the copy's window can't
+	// move points inside an array adopted by r.  The version carries over, so
+	// caches copied along with their owner stay valid.
+	std::vector<npy_intp> dims(2);
+	dims[0] = allocated;
+	dims[1] = 3;
+	array::operator=( makeNum( dims, (NPY_TYPES)storage ) );
+	std::memcpy( cvisual::python::data(*this), cvisual::python::data(r), itemsize * 3 * allocated );
+}
+
+template <class CTYPE>
+array_version arrayprim_array<CTYPE>::get_version() {
+	if (exposed && seen_frame != renderable::frame()) {
+		seen_frame = renderable::frame();
+		check_views();
+	}
+	watched = dropped + length;
+	array_version ret;
+	ret.number = version;
+	ret.first = dropped;
+	ret.end = dropped + length;
+	return ret;
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::expose() {
+	if (adopted || exposed)
+		return;
+	exposed = true;
+	const char* storage_begin = (const char*)cvisual::python::data(*this);
+	seen.assign( storage_begin, storage_begin + itemsize * 3 * allocated);
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::check_views() {
+	if (!exposed || !length)
+		return;
+	const size_t row = itemsize * 3;
+	const char* now = (const char*)raw(0);
+	const char* was = &seen[head * row];
+	if (!std::memcmp( now, was, length * row))
+		return;
+	size_t begin = 0, end = length;
+	while (!std::memcmp( now + begin*row, was + begin*row, row))
+		++begin;
+	while (!std::memcmp( now + (end-1)*row, was + (end-1)*row, row))
+		--end;
+	modified( begin, end);
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::modified( size_t begin, size_t end ) {
+	++version;
+	if (exposed && begin < end)
+		std::memcpy( &seen[(head + begin) * itemsize * 3], raw( begin), (end - begin) * itemsize * 3);
+	begin += dropped;
+	end += dropped;
+	// Every consumer saw the points end before watched at most, and takes
+	// those after it as appended.
+	if (begin >= watched)
+		return;
+	if (log_used) {
+		// Writing the same points again, as append() does after growing the
+		// array, needs no new entry.
+		change& last = log[(log_next + log_size - 1) % log_size];
+		if (begin == last.begin && end == last.end) {
+			last.version = version;
+			return;
+		}
+	}
+	if (log_used == log_size)
+		log_floor = log[log_next].version;
+	else
+		++log_used;
+	change& c = log[log_next];
+	c.version = version;
+	c.begin = begin;
+	c.end = end;
+	log_next = (log_next + 1) % log_size;
+}
+
+template <class CTYPE>
+bool arrayprim_array<CTYPE>::written_since( const array_version& since, size_t& begin, size_t& end ) const {
+	if (since.number == version)
+		return false;
+	const size_t history_end = dropped + length;
+	if (since.number < log_floor || since.number > version) {
+		begin = dropped;
+		end = history_end;
+		return true;
+	}
+	begin = history_end;
+	end = 0;
+	if (since.end < history_end) {
+		begin = since.end;
+		end = history_end;
+	}
+	for (int i = 0; i < log_used; ++i) {
+		const change& c = log[i];
+		if (c.version > since.number) {
+			begin = std::min( begin, c.begin);
+			end = std::max( end, c.end);
+		}
+	}
+	end = std::max( std::min( end, history_end), dropped);
+	begin = std::min( std::max( begin, dropped), end);
+	return true;
+}
+
+template <class CTYPE>
+bool arrayprim_array<CTYPE>::changed_since( const array_version& since, size_t& begin, size_t& end ) const {
+	if (!written_since( since, begin, end))
+		return false;
+	if (since.first != dropped) {
+		begin = 0;
+		end = length;
+		return true;
+	}
+	begin -= dropped;
+	end -= dropped;
+	return true;
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::set_storage( int npy_type, double n_scale ) {
+	if (npy_type == storage && n_scale == scale)
+		return;
+	// As in set_length, the first point is meaningful even when length is 0.
+	const size_t kept = std::max( length, size_t(1));
+	std::vector<npy_intp> dims(2);
+	dims[0] = allocated;
+	dims[1] = 3;
+	array n_arr = makeNum( dims, (NPY_TYPES)npy_type );
+	const void* from = raw(0);
+	void* to = cvisual::python::data(n_arr);
+	for (size_t i = 0; i < 3*kept; ++i)
+		store_element( to, npy_type, i, stored_element( from, storage, i) / scale * n_scale);
+	array::operator=( n_arr );
+
+	storage = npy_type;
+	itemsize = PyArray_ITEMSIZE( (PyArrayObject*)ptr());
+	scale = n_scale;
+	head = 0;
+	// Views held by Python now refer to the old storage.
+	exposed = false;
+	std::vector<char>().swap( seen);
+	adopted = false;
+	modified( 0, length);
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::adopt( const array& a ) {
+	PyArrayObject* arr = (PyArrayObject*)a.ptr();
+	if (!PyArray_Check( a.ptr()) || PyArray_NDIM( arr) != 2 || PyArray_DIM( arr, 1) != 3
+			|| PyArray_DIM( arr, 0) < 1)
+		throw std::invalid_argument( "Only an Nx3 array with N > 0 can be used directly.");
+	if (PyArray_TYPE( arr) != storage || scale != 1.0)
+		throw std::invalid_argument( "Only an array of the type already stored can be used directly.");
+	if (!PyArray_ISCARRAY( arr))
+		throw std::invalid_argument(
+			"Only a C-contiguous, aligned and writeable array can be used directly.");
+
+	array::operator=( a );
+	allocated = length = PyArray_DIM( arr, 0);
+	head = 0;
+	exposed = false;
+	std::vector<char>().swap( seen);
+	adopted = true;
+	modified( 0, length);
+}
 
+template <class CTYPE>
+const void* arrayprim_array<CTYPE>::raw( size_t index ) const {
+	return (const char*)cvisual::python::data(*this) + (head+index)*3*itemsize;
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::get( size_t index, CTYPE out[3] ) const {
+	const void* p = raw( index);
+	for (int i = 0; i < 3; ++i)
+		out[i] = stored_element( p, storage, i) / scale;
+}
+
+template <class CTYPE>
+vector arrayprim_array<CTYPE>::get( size_t index ) const {
+	CTYPE p[3];
+	get( index, p);
+	return vector( p[0], p[1], p[2]);
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::set( size_t index, const CTYPE in[3] ) {
+	void* p = const_cast<void*>( raw( index));
+	for (int i = 0; i < 3; ++i)
+		store_element( p, storage, i, in[i] * scale);
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::set_elements( size_t first, size_t n, int comp, const double* src, size_t stride ) {
+	if (native()) {
+		CTYPE* dest = data( first) + comp;
+		for (size_t i = 0; i < n; ++i, dest += 3, src += stride)
+			*dest = *src;
+		return;
+	}
+	void* dest = const_cast<void*>( raw( first));
+	for (size_t i = 0; i < n; ++i, src += stride)
+		store_element( dest, storage, 3*i + comp, *src * scale);
+}
+
+template <class CTYPE>
+object arrayprim_array<CTYPE>::get_view() {
+	if (scale != 1.0)
+		return (*this)[all()] / scale;
+	expose();
+	return (*this)[all()];
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::set_length( size_t new_len ) {
 	size_t old_len = length;
 
 	if (new_len < old_len ) {
-		// Shrink, keeping the last points (for retain)
-		//(*this)[ slice(0,new_len) ] = (*this)[ slice(old_len-new_len,old_len) ];
-		// Avoid array operations because they release the lock.
-		memmove( data(0), data(old_len-new_len), sizeof(CTYPE) * new_len * 3 );
+		// Shrink, keeping the last points (for retain).  The window slides
+		// forward over them, so that appending with retain costs O(1) amortized.
+		// Their history indices stay the same.
+		if (new_len)
+			head += old_len - new_len;
+		dropped += old_len - new_len;
+		++version;
 	}
 	if (!old_len && allocated) old_len = 1;  // The very first point is meaningful even when length is 0; that's how an empty curve can have a color
+	const size_t kept = std::min( old_len, std::max( new_len, size_t(1)));
 
-	if (new_len > allocated) {
-		// Expand allocated size, keeping old_len points
-		std::vector<npy_intp> dims(2);
-		dims[0] = 2*(new_len-1);
-		dims[1] = 3;
-
-		array n_arr = makeNum( dims, (NPY_TYPES)type_npy_traits<CTYPE>::npy_type );
-		std::memcpy( cvisual::python::data(n_arr), data(0), sizeof(CTYPE) * old_len * dims[1] );
-		array::operator=( n_arr ); // doesn't actually copy
-
-		allocated = dims[0];
+	if (head + new_len > allocated) {
+		// Avoid array operations because they release the lock.
+		if (2*new_len <= allocated && !adopted) {
+			// Slide the window back to the start of the storage.  At least
+			// allocated - new_len points were appended since it last moved.
+			memmove( cvisual::python::data(*this), raw(0), itemsize * kept * 3 );
+			if (exposed)
+				memmove( &seen[0], &seen[head * itemsize * 3], itemsize * kept * 3 );
+		}
+		else {
+			// Expand allocated size, keeping the meaningful points
+			std::vector<npy_intp> dims(2);
+			dims[0] = 2*new_len;
+			dims[1] = 3;
+
+			array n_arr = makeNum( dims, (NPY_TYPES)storage );
+			std::memcpy( cvisual::python::data(n_arr), raw(0), itemsize * kept * dims[1] );
+			array::operator=( n_arr ); // doesn't actually copy
+
+			allocated = dims[0];
+			// Views held by Python now refer to the old storage.
+			exposed = false;
+			std::vector<char>().swap( seen);
+			adopted = false;
+		}
+		head = 0;
 	}
 
 	if (new_len > old_len) {
 		// Broadcast the last meaningful point over the new points
-		(*this)[ slice( old_len, new_len ) ] = (*this)[ slice( old_len-1, old_len ) ];
+		const char* last = (const char*)raw( old_len-1);
+		for (size_t i = old_len; i < new_len; ++i)
+			std::memcpy( const_cast<void*>( raw( i)), last, 3*itemsize );
+		modified( length, new_len);
 	}
 
 	length = new_len;
@@ -69,8 +387,50 @@ void arrayprim::set_length( size_t new_len ) {
 	count = new_len;
 }
 
+void arrayprim::update_bounds() const {
+	// Remembering what has been seen doesn't change pos.
+	const array_version v = const_cast<arrayprim_array<double>&>(pos).get_version();
+	size_t begin = 0, end = 0;
+	if (!pos.changed_since( bounds_version, begin, end))
+		return;
+
+	size_t first = bounds_version.end - bounds_version.first;
+	if (pos.first() != bounds_version.first || begin < first)
+		first = 0;
+	if (!first) {
+		pos_sum = vector();
+		bounds_min = bounds_max = pos.get( 0);
+	}
+	for (size_t i = first; i < count; ++i) {
+		const vector point = pos.get( i);
+		pos_sum += point;
+		for (int d = 0; d < 3; ++d) {
+			bounds_min[d] = std::min( bounds_min[d], point[d]);
+			bounds_max[d] = std::max( bounds_max[d], point[d]);
+		}
+	}
+	bounds_version = v;
+}
+
+void arrayprim::adopt_pos( const array& n_pos ) {
+	pos.adopt( n_pos);
+	// The other arrays follow pos's new length; pos already has it.
+	set_length( shape( n_pos)[0]);
+}
+
+void arrayprim::dirty_rows( int begin, int end, size_t& first, size_t& last ) const {
+	last = end < 0 ? count : std::min( (size_t)end, count);
+	first = std::min( (size_t)std::max( begin, 0), last);
+}
+
+void arrayprim::mark_dirty( int begin, int end ) {
+	size_t first, last;
+	dirty_rows( begin, end, first, last);
+	pos.modified( first, last);
+}
+
 object arrayprim::get_pos() {
-	return pos[all()];
+	return pos.get_view();
 }
 
 void arrayprim::set_pos( const double_array& n_pos )
@@ -86,13 +446,18 @@ void arrayprim::set_pos( const double_array& n_pos )
 	}
 	if (dims[1] == 2) {
 		set_length( dims[0] );
-		pos[make_tuple(all(), slice(0,2))] = n_pos;
-		pos[make_tuple(all(), 2)] = 0.0;
+		const double* xy = (const double*)data( n_pos);
+		const double zero = 0.0;
+		pos.set_elements( 0, count, 0, xy, 2);
+		pos.set_elements( 0, count, 1, xy + 1, 2);
+		pos.set_elements( 0, count, 2, &zero, 0);
+		pos.modified( 0, count);
 		return;
 	}
 	else if (dims[1] == 3) {
 		set_length( dims[0] );
-		pos[all()] = n_pos;
+		copy_rows( pos, 0, n_pos, 0, count);
+		pos.modified( 0, count);
 		return;
 	}
 	else {
@@ -102,46 +467,54 @@ void arrayprim::set_pos( const double_array& n_pos )
 
 void arrayprim::set_pos_v( const vector& npos ) {
 	set_length(1);
-	pos[all()] = npos;
+	const double p[3] = { npos.x, npos.y, npos.z };
+	pos.set( 0, p);
+	pos.modified( 0, count);
 }
 
 void arrayprim::set_x( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("x must be a 1D array.");
 	set_length( shape(arg)[0] );
-	pos[make_tuple( all(), 0)] = arg;
+	pos.set_elements( 0, count, 0, (const double*)data( arg), 1);
+	pos.modified( 0, count);
 }
 
 void arrayprim::set_y( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("y must be a 1D array.");
 	set_length( shape(arg)[0] );
-	pos[make_tuple( all(), 1)] = arg;
+	pos.set_elements( 0, count, 1, (const double*)data( arg), 1);
+	pos.modified( 0, count);
 }
 
 void arrayprim::set_z( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("z must be a 1D array.");
 	set_length( shape(arg)[0] );
-	pos[make_tuple( all(), 2)] = arg;
+	pos.set_elements( 0, count, 2, (const double*)data( arg), 1);
+	pos.modified( 0, count);
 }
 
 void arrayprim::set_x_d( const double x)
 {
 	if (!count)	set_length(1);
-	pos[make_tuple( all(), 0)] = x;
+	pos.set_elements( 0, count, 0, &x, 0);
+	pos.modified( 0, count);
 }
 
 void arrayprim::set_y_d( const double y)
 {
 	if (!count)	set_length(1);
-	pos[make_tuple( all(), 1)] = y;
+	pos.set_elements( 0, count, 1, &y, 0);
+	pos.modified( 0, count);
 }
 
 void arrayprim::set_z_d( const double z)
 {
 	if (!count)	set_length(1);
-	pos[make_tuple( all(), 2)] = z;
+	pos.set_elements( 0, count, 2, &z, 0);
+	pos.modified( 0, count);
 }
 
 void arrayprim::append( const vector& npos, int retain )
@@ -151,10 +524,61 @@ void arrayprim::append( const vector& npos, int retain )
 	else if (retain == 0)
 		set_length(0);
 	set_length( count+1);
-	double* last_pos = pos.data( count-1 );
-	last_pos[0] = npos.x;
-	last_pos[1] = npos.y;
-	last_pos[2] = npos.z;
+	const double last_pos[3] = { npos.x, npos.y, npos.z };
+	pos.set( count-1, last_pos);
+}
+
+size_t arrayprim::append_rows( size_t n, int retain, size_t& skip )
+{
+	skip = 0;
+	size_t keep_old = count;
+	if (retain == 0)
+		keep_old = 0;
+	else if (retain > 0) {
+		if (n > (size_t)retain) {
+			skip = n - retain;
+			n = retain;
+		}
+		keep_old = std::min( count, retain - n);
+	}
+	if (keep_old < count)
+		set_length( keep_old);		// slides the window
+	const size_t first = count;
+	set_length( count + n);
+	return first;
+}
+
+size_t arrayprim::point_rows( const double_array& a, const char* name )
+{
+	std::vector<npy_intp> dims = shape( a);
+	if (dims.size() == 1 && dims[0] == 3)
+		return 1;
+	if (dims.size() == 2 && dims[1] == 3)
+		return dims[0];
+	throw std::invalid_argument( std::string(name) + " must be an Nx3 array");
+}
+
+void arrayprim::copy_rows( arrayprim_array<double>& dest, size_t first,
+	const double_array& src, size_t skip, size_t n )
+{
+	const double* src_i = (const double*)data( src);
+	const bool single = shape( src).size() == 1;
+	if (!single)
+		src_i += 3*skip;
+	if (dest.native() && !single) {
+		std::memcpy( dest.data( first), src_i, sizeof(double) * 3 * n );
+		return;
+	}
+	for (size_t i = 0; i < n; ++i)
+		dest.set( first + i, single ? src_i : src_i + 3*i);
+}
+
+void arrayprim::append_array( const double_array& n_pos, int retain )
+{
+	const size_t n = point_rows( n_pos, "pos");
+	size_t skip;
+	const size_t first = append_rows( n, retain, skip);
+	copy_rows( pos, first, n_pos, skip, count - first);
 }
 
 ////////////////////////////////
@@ -169,8 +593,21 @@ void arrayprim_color::set_length( size_t new_len ) {
 	arrayprim::set_length( new_len );
 }
 
+void arrayprim_color::adopt_color( const array& n_color ) {
+	if (shape( n_color).size() != 2 || size_t(shape( n_color)[0]) != count)
+		throw std::invalid_argument( "An adopted color array must have a row for each point.");
+	color.adopt( n_color);
+}
+
+void arrayprim_color::mark_dirty( int begin, int end ) {
+	arrayprim::mark_dirty( begin, end);
+	size_t first, last;
+	dirty_rows( begin, end, first, last);
+	color.modified( first, last);
+}
+
 object arrayprim_color::get_color() {
-	return color[all()];
+	return color.get_view();
 }
 
 void arrayprim_color::set_color( const double_array& n_color)
@@ -179,13 +616,15 @@ void arrayprim_color::set_color( const double_array& n_color)
 	if (dims.size() == 1 && dims[0] == 3) {
 		// A single color, broadcast across the entire (used) array.
 		int npoints = (count) ? count : 1;
-		color[slice( 0, npoints)] = n_color;
+		copy_rows( color, 0, n_color, 0, npoints);
+		color.modified( 0, count ? count : 1);
 		return;
 	}
 	if (dims.size() == 2 && dims[1] == 3) {
 		// An RGB chunk of color
 		set_length(dims[0]);
-		color[all()] = n_color;
+		copy_rows( color, 0, n_color, 0, count);
+		color.modified( 0, count ? count : 1);
 		return;
 	}
 	throw std::invalid_argument( "color must be an Nx3 array");
@@ -195,57 +634,74 @@ void arrayprim_color::set_red( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("red must be a 1D array.");
 	set_length( shape(arg)[0] );
-	color[make_tuple( all(), 0)] = arg;
+	color.set_elements( 0, count, 0, (const double*)data( arg), 1);
+	color.modified( 0, count ? count : 1);
 }
 
 void arrayprim_color::set_green( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("green must be a 1D array.");
 	set_length( shape(arg)[0] );
-	color[make_tuple( all(), 1)] = arg;
+	color.set_elements( 0, count, 1, (const double*)data( arg), 1);
+	color.modified( 0, count ? count : 1);
 }
 
 void arrayprim_color::set_blue( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("blue must be a 1D array.");
 	set_length( shape(arg)[0] );
-	color[make_tuple( all(), 2)] = arg;
+	color.set_elements( 0, count, 2, (const double*)data( arg), 1);
+	color.modified( 0, count ? count : 1);
 }
 
 void arrayprim_color::set_red_d( const double arg )
 {
 	int npoints = count ? count : 1;
-	color[make_tuple(slice(0,npoints), 0)] = arg;
+	color.set_elements( 0, npoints, 0, &arg, 0);
+	color.modified( 0, count ? count : 1);
 }
 
 void arrayprim_color::set_green_d( const double arg )
 {
 	int npoints = count ? count : 1;
-	color[make_tuple(slice(0,npoints), 1)] = arg;
+	color.set_elements( 0, npoints, 1, &arg, 0);
+	color.modified( 0, count ? count : 1);
 }
 
 void arrayprim_color::set_blue_d( const double arg )
 {
 	int npoints = count ? count : 1;
-	color[make_tuple(slice(0,npoints), 2)] = arg;
+	color.set_elements( 0, npoints, 2, &arg, 0);
+	color.modified( 0, count ? count : 1);
 }
 
 void arrayprim_color::append( const vector& npos, const rgb& ncolor, int retain )
 {
 	append( npos, retain );
-	double* last_color = color.data( count-1 );
-	last_color[0] = ncolor.red;
-	last_color[1] = ncolor.green;
-	last_color[2] = ncolor.blue;
+	const double last_color[3] = { ncolor.red, ncolor.green, ncolor.blue };
+	color.set( count-1, last_color);
 }
 
 void arrayprim_color::append_rgb( const vector& npos, double red, double green, double blue, int retain)
 {
 	append( npos, retain );
-	double* last_color = color.data( count-1 );
+	double last_color[3];
+	color.get( count-1, last_color);
 	if (red != -1) last_color[0] = red;
 	if (green != -1) last_color[1] = green;
 	if (blue != -1)	last_color[2] = blue;
+	color.set( count-1, last_color);
+}
+
+void arrayprim_color::append_array( const double_array& n_pos, const double_array& n_color, int retain)
+{
+	const size_t n = point_rows( n_pos, "pos");
+	if (point_rows( n_color, "color") != n && shape( n_color).size() != 1)
+		throw std::invalid_argument( "color must have a row for each point");
+	size_t skip;
+	const size_t first = append_rows( n, retain, skip);
+	copy_rows( pos, first, n_pos, skip, count - first);
+	copy_rows( color, first, n_color, skip, count - first);
 }
 
 } } // namespace cvisual::python
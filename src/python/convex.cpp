@@ -7,22 +7,12 @@
 #include "python/slice.hpp"
 #include "util/gl_enable.hpp"
 #include "util/errors.hpp"
+#include "util/convex_hull.hpp"
 
 #include <boost/python/extract.hpp>
-#include <boost/crc.hpp>
 
 namespace cvisual { namespace python {
 
-convex::jitter_table convex::jitter;
-
-long
-convex::checksum() const
-{
-	boost::crc_32_type engine;
-	engine.process_block( pos.data(), pos.end() );
-	return engine.checksum();
-}
-
 bool
 convex::degenerate() const
 {
@@ -30,83 +20,44 @@ convex::degenerate() const
 }
 
 void
-convex::recalc()
+convex::update_hull()
 {
-	hull.clear();
-
-	const double* pos_i = pos.data();
-	// A face from the first, second, and third vectors.
-	hull.push_back( face( vector(pos_i), vector(pos_i+3), vector(pos_i+3*2)));
-	// The reverse face from the first, third, and second vectors.
-	hull.push_back( face( vector(pos_i), vector(pos_i+3*2), vector(pos_i+3)));
-	// The remainder of the possible faces.
-	for (size_t i = 3; i < count; ++i) {
-		add_point( i, vector(pos_i + i*3));
-	}
-	
-	// Calculate extents
-	min_extent = max_extent = vector( pos_i );
-	for(size_t i=1; i<count; i++)
-		for(size_t j=0; j<3; j++) {
-			if (*pos_i < min_extent[j]) min_extent[j] = *pos_i;
-			else if (*pos_i > max_extent[j]) max_extent[j] = *pos_i;
-			pos_i++;
-		}
-
-	last_checksum = checksum();
-}
-
-void
-convex::add_point( size_t n, vector pv)
-{
-	double m = pv.mag();
-	pv.x += m * jitter.v[(n  ) & jitter.mask];
-	pv.y += m * jitter.v[(n+1) & jitter.mask];
-	pv.z += m * jitter.v[(n+2) & jitter.mask];
-
-	std::vector<edge> hole;
-	for (size_t f=0; f<hull.size(); ) {
-		if ( hull[f].visible_from(pv) ) {
-			// hull[f] is visible from pv.  We will never get here if pv is
-			//   inside the hull.
-
-			// add the edges to the hole.  If an edge is already in the hole,
-			//   it is not on the boundary of the hole and is removed.
-			for(int e=0; e<3; ++e) {
-				edge E( hull[f].corner[e], hull[f].corner[(e+1)%3] );
-
-				bool boundary = true;
-				for(std::vector<edge>::iterator h = hole.begin(); h != hole.end(); ++h) {
-					if (*h == E) {
-						*h = hole.back();
-						hole.pop_back();
-						boundary = false;
-						break;
-					}
-				}
-
-				if (boundary) {
-					hole.push_back(E);
-				}
-			}
-
-			// remove hull[f]
-			hull[f] = hull.back();
-			hull.pop_back();
+	// grow_extent(), get_material_matrix() and gl_render() all need the
+	// hull, so it is checked against pos only on the first call each frame.
+	if (hull_made && hull_frame == renderable::frame())
+		return;
+	hull_frame = renderable::frame();
+	const array_version version = pos.get_version();
+	if (hull_made && version == hull_version)
+		return;
+	hull_made = true;
+	hull_version = version;
+	convex_hull( pos.data(), count, hull);
+
+	// The normals are worked out once here rather than as each frame is drawn.
+	mesh_origin = count ? vector( pos.data()) : vector();
+	mesh.resize( hull.size() * 6);
+	for (size_t t = 0; t < hull.size(); t += 3) {
+		const vector a( pos.data( hull[t]));
+		const vector b( pos.data( hull[t+1]));
+		const vector c( pos.data( hull[t+2]));
+		const vector n = (b - a).cross( c - a).norm();
+		for (int k = 0; k < 3; ++k) {
+			const vector p = vector( pos.data( hull[t+k])) - mesh_origin;
+			float* m = &mesh[6*(t+k)];
+			m[0] = p.x;
+			m[1] = p.y;
+			m[2] = p.z;
+			m[3] = n.x;
+			m[4] = n.y;
+			m[5] = n.z;
 		}
-		else
-			f++;
-	}
-
-	// Now add the boundary of the hole to the hull.  If pv was inside
-	//   the hull, the hole will be empty and nothing happens here.
-	for (std::vector<edge>::const_iterator h = hole.begin(); h != hole.end(); ++h) {
-		hull.push_back(face(h->v[0], h->v[1], pv));
 	}
+	mesh_stale = true;
 }
 
 convex::convex()
-	: last_checksum(0)
+	: hull_made(false), hull_frame(0), mesh_stale(true)
 {
 }
 
@@ -125,40 +76,50 @@ convex::gl_render( const view& scene)
 {
 	if (degenerate())
 		return;
-	long check = checksum();
-	if (check != last_checksum) {
-		recalc();
-		last_checksum = check;
-	}
+	update_hull();
+	if (hull.empty())
+		return;
 
-	glShadeModel(GL_FLAT);
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform( mesh_origin);
 	gl_enable cull_face( GL_CULL_FACE);
 	color.gl_set(1.0);
 
-	glBegin(GL_TRIANGLES);
-	for (std::vector<face>::const_iterator f = hull.begin(); f != hull.end(); ++f) {
-		f->normal.gl_normal();
-		(f->corner[0] * scene.gcf).gl_render();
-		(f->corner[1] * scene.gcf).gl_render();
-		(f->corner[2] * scene.gcf).gl_render();
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	gl_enable_client normals( GL_NORMAL_ARRAY);
+	const float* base = &mesh[0];
+	const bool buffered = scene.glext.ARB_vertex_buffer_object;
+	if (buffered) {
+		if (mesh_stale || !mesh_buffer.size())
+			mesh_buffer.gl_set_data( scene, mesh.size() * sizeof(float), &mesh[0]);
+		else
+			mesh_buffer.gl_bind( scene);
+		mesh_stale = false;
+		base = 0;
 	}
-	glEnd();
-	glShadeModel( GL_SMOOTH);
+	glVertexPointer( 3, GL_FLOAT, 6*sizeof(float), base);
+	glNormalPointer( GL_FLOAT, 6*sizeof(float), base + 3);
+	glDrawArrays( GL_TRIANGLES, 0, hull.size());
+	if (buffered)
+		mesh_buffer.gl_unbind( scene);
 }
 
 vector
 convex::get_center() const
 {
-	if (degenerate())
+	if (degenerate() || hull.empty())
 		return vector();
 
+	// The hull may be older than pos.
 	vector ret;
-	for (std::vector<face>::const_iterator f = hull.begin(); f != hull.end(); ++f) {
-		ret += f->center;
+	size_t n = 0;
+	for (size_t i = 0; i < hull.size(); ++i) {
+		if (hull[i] < count) {
+			ret += vector( pos.data( hull[i]));
+			++n;
+		}
 	}
-	ret /= hull.empty() ? 1 : hull.size();
-
-	return ret;
+	return n ? ret / n : ret;
 }
 
 void
@@ -172,28 +133,27 @@ convex::grow_extent( extent& world)
 {
 	if (degenerate())
 		return;
-
-	long check = checksum();
-	if (check != last_checksum) {
-		recalc();
-	}
-	assert( hull.size() != 0);
-
-	for (std::vector<face>::const_iterator f = hull.begin(); f != hull.end(); ++f) {
-		world.add_point( f->corner[0]);
-		world.add_point( f->corner[1]);
-		world.add_point( f->corner[2]);
-	}
+	update_hull();
+	for (size_t i = 0; i < hull.size(); ++i)
+		world.add_point( vector( pos.data( hull[i])));
 	world.add_body();
 }
 
 void 
-convex::get_material_matrix( const view& v, tmatrix& out ) {
+convex::get_material_matrix( const view&, tmatrix& out ) {
+	if (degenerate())
+		return;
+	update_bounds();
+	const vector& min_extent = bounds_min;
+	const vector& max_extent = bounds_max;
+
 	out.translate( vector(.5,.5,.5) );
 	
-	out.scale( vector(1,1,1) * (.999 / (v.gcf * std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z)))) );
+	out.scale( vector(1,1,1) * (.999 / std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z))) );
 	
-	out.translate( -.5 * v.gcf * (min_extent + max_extent) );
+	out.translate( -.5 * (min_extent + max_extent) );
+	update_hull();
+	out.translate( mesh_origin ); // the mesh is drawn relative to mesh_origin
 }
 
 } } // !namespace cvisual::python
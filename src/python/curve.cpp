@@ -3,10 +3,11 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include <boost/python/detail/wrap_python.hpp>
-#include <boost/crc.hpp>
 
+#include "material.hpp"
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
+#include "util/tube_shader.hpp"
 
 #include "python/slice.hpp"
 #include "python/curve.hpp"
@@ -15,13 +16,20 @@
 #include <cassert>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 
 // Recall that the default constructor for object() is a reference to None.
 
 namespace cvisual { namespace python {
 
 curve::curve()
-	: antialias( true), radius(0.0), sides(4)
+	: antialias( true), radius(0.0), sides(4),
+	tube( GL_ARRAY_BUFFER_ARB), tube_colors( GL_ARRAY_BUFFER_ARB),
+	tube_count(0), tube_capacity(0), tube_first(0),
+	tube_color_mode(0),
+	lod_pixels(0.0), lod_active(false),
+	lod_tube( GL_ARRAY_BUFFER_ARB), lod_tube_colors( GL_ARRAY_BUFFER_ARB),
+	lod_tube_stale(true)
 {
 	for (size_t i=0; i<sides; i++) {
 		curve_sc[i]  = (float) std::cos(i * 2 * M_PI / sides);
@@ -93,23 +101,10 @@ eq_frac( double lhs, double rhs, double frac)
 vector
 curve::get_center() const
 {
-	// TODO: Optimize this by only recomputing the center when the checksum of
-	// the entire object has changed.
-	// TODO: Only add the "optimization" if the checksum is actually faster than
-	// computing the average value every time...
 	if (degenerate())
 		return vector();
-	vector ret;
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.end();
-	while (pos_i < pos_end) {
-		ret.x += pos_i[0];
-		ret.y += pos_i[1];
-		ret.z += pos_i[2];
-		pos_i += 3;
-	}
-	ret /= count;
-	return ret;
+	update_bounds();
+	return pos_sum / count;
 }
 
 void
@@ -183,7 +178,7 @@ struct converter
 } // !namespace (anonymous)
 
 void
-curve::thickline( const view& scene, double* spos, float* tcolor, size_t pcount, double scaled_radius)
+curve::thickline( const view& scene, const double* spos, float* tcolor, size_t pcount, double line_radius)
 {
 	float *cost = curve_sc;
 	float *sint = cost + sides;
@@ -257,8 +252,8 @@ curve::thickline( const view& scene, double* spos, float* tcolor, size_t pcount,
 			}
 
 			// scale radii
-			x *= scaled_radius;
-			y *= scaled_radius;
+			x *= line_radius;
+			y *= line_radius;
 
 			for (size_t a=0; a < sides; a++) {
 				vector rel = x*sint[a] + y*cost[a]; // first point is "up"
@@ -376,73 +371,332 @@ curve::thickline( const view& scene, double* spos, float* tcolor, size_t pcount,
 		glDisableClientState( GL_COLOR_ARRAY);
 }
 
+namespace {
+// Floats per vertex in the position and color buffers.
+const size_t tube_pos_floats = 4;
+const size_t tube_color_floats = 3;
+} // !namespace (anonymous)
+
 void
-curve::gl_render( const view& scene)
+curve::tube_vertexes( size_t k, int color_mode, float*& v_i, float*& c_i)
 {
-	if (degenerate())
+	const double* p = pos.data( k);
+	const double* c = color.data( k);
+	rgb point_color( c[0], c[1], c[2]);
+	if (color_mode == 1)
+		point_color = point_color.desaturate();
+	else if (color_mode == 2)
+		point_color = point_color.grayscale();
+	for (int side = -1; side <= 1; side += 2) {
+		*v_i++ = p[0] - tube_origin.x;
+		*v_i++ = p[1] - tube_origin.y;
+		*v_i++ = p[2] - tube_origin.z;
+		*v_i++ = side;
+		*c_i++ = point_color.red;
+		*c_i++ = point_color.green;
+		*c_i++ = point_color.blue;
+	}
+}
+
+void
+curve::write_tube( const view& scene, size_t begin, size_t end, bool closed, int color_mode)
+{
+	// Slot i holds point i-1 as a pair of ribbon vertexes.  Slots 0 and
+	// count+1 pad the ends with the neighbors seen by the shader from the
+	// first and last points: the far end of a closed curve, or the endpoint
+	// itself for an open one.  Slot 0 is shift slots into the buffers.
+	const size_t shift = pos.first() - tube_first;
+	std::vector<float> vertexes( 2*(end-begin) * tube_pos_floats);
+	std::vector<float> colors( 2*(end-begin) * tube_color_floats);
+	float* v_i = &vertexes[0];
+	float* c_i = &colors[0];
+
+	for (size_t i = begin; i < end; ++i) {
+		size_t k = i - 1;
+		if (i == 0)
+			k = closed ? count-2 : 0;
+		else if (i == count+1)
+			k = closed ? 1 : count-1;
+		tube_vertexes( k, color_mode, v_i, c_i);
+	}
+	tube.gl_set_subdata( scene, 2*(shift + begin) * tube_pos_floats * sizeof(float),
+		vertexes.size() * sizeof(float), &vertexes[0]);
+	tube_colors.gl_set_subdata( scene, 2*(shift + begin) * tube_color_floats * sizeof(float),
+		colors.size() * sizeof(float), &colors[0]);
+}
+
+void
+curve::write_lod_tube( const view& scene, int color_mode)
+{
+	// Laid out as the tube is, for the points in lod_indices.
+	const size_t n = lod_indices.size();
+	const bool closed = vector( pos.data()) == vector( pos.data( count-1));
+	std::vector<float> vertexes( 2*(n+2) * tube_pos_floats);
+	std::vector<float> colors( 2*(n+2) * tube_color_floats);
+	float* v_i = &vertexes[0];
+	float* c_i = &colors[0];
+	tube_vertexes( lod_indices[closed ? n-2 : 0], color_mode, v_i, c_i);
+	for (size_t i = 0; i < n; ++i)
+		tube_vertexes( lod_indices[i], color_mode, v_i, c_i);
+	tube_vertexes( lod_indices[closed ? 1 : n-1], color_mode, v_i, c_i);
+	lod_tube.gl_set_data( scene, vertexes.size() * sizeof(float), &vertexes[0],
+		GL_STREAM_DRAW_ARB);
+	lod_tube_colors.gl_set_data( scene, colors.size() * sizeof(float), &colors[0],
+		GL_STREAM_DRAW_ARB);
+	lod_tube_stale = false;
+}
+
+bool
+curve::update_tube( const view& scene)
+{
+	if (!scene.glext.ARB_vertex_buffer_object)
+		return false;
+
+	const int color_mode = !scene.anaglyph ? 0 : scene.coloranaglyph ? 1 : 2;
+	const array_version pos_version = pos.get_version();
+	const array_version color_version = color.get_version();
+	if (tube.size() && pos_version == tube_pos_version && color_version == tube_color_version
+			&& color_mode == tube_color_mode)
+		return true;
+	const double* p = pos.data();
+	const bool closed = vector( p) == vector( p + 3*(count-1));
+
+	// The buffers hold the points by history index, from tube_first on.  As
+	// points are dropped from the front by retaining, the slots in use slide
+	// along the buffers like a ring buffer's, and only appended and edited
+	// points are written.  Once the slots run out, everything is written
+	// again at the start of new buffers, with room for as many points again.
+	const bool full = pos.first() - tube_first + count + 2 > tube_capacity || !tube.size();
+	if (full || color_mode != tube_color_mode) {
+		if (full) {
+			tube_capacity = 2*(count + 2);
+			tube_origin = vector( p);
+			tube.gl_set_data( scene, 2*tube_capacity * tube_pos_floats * sizeof(float),
+				0, GL_DYNAMIC_DRAW_ARB);
+			tube_colors.gl_set_data( scene, 2*tube_capacity * tube_color_floats * sizeof(float),
+				0, GL_DYNAMIC_DRAW_ARB);
+		}
+		tube_first = pos.first();
+		write_tube( scene, 0, count + 2, closed, color_mode);
+	}
+	else {
+		size_t first = pos.first() + count, last = pos.first();
+		size_t b, e;
+		if (pos.written_since( tube_pos_version, b, e)) {
+			first = std::min( first, b);
+			last = std::max( last, e);
+		}
+		if (color.written_since( tube_color_version, b, e)) {
+			first = std::min( first, b);
+			last = std::max( last, e);
+		}
+		// Point k is in slot k+1.  The padding slots are rewritten every
+		// time, since they move with the ends of the curve.
+		if (first < last)
+			write_tube( scene, first - pos.first() + 1, last - pos.first() + 1, closed, color_mode);
+		write_tube( scene, 0, 1, closed, color_mode);
+		write_tube( scene, count + 1, count + 2, closed, color_mode);
+	}
+
+	lod_tube_stale = true;
+	tube_count = count;
+	tube_pos_version = pos_version;
+	tube_color_version = color_version;
+	tube_color_mode = color_mode;
+	return true;
+}
+
+namespace {
+// Whether a span of a curve is drawn simplified: where the span comes
+// nearest the camera, its error must be at most half a pixel.
+struct span_accept
+{
+	const view* scene;
+	const double* pos;
+
+	bool operator()( size_t a, size_t b, double error) const
+	{
+		// Every point of the span lies within error of the segment a-b.
+		const double depth = std::min(
+			(vector( pos + 3*a) - scene->camera).dot( scene->forward),
+			(vector( pos + 3*b) - scene->camera).dot( scene->forward)) - error;
+		if (depth <= 0.0)
+			return false;
+		// pixel_coverage() gives the diameter of a circle, here one unit across.
+		const double pixels_per_unit = scene->pixel_coverage(
+			scene->camera + scene->forward * depth, 0.5);
+		return pixels_per_unit > 0.0 && error * pixels_per_unit <= 0.5;
+	}
+};
+} // !namespace (anonymous)
+
+void
+curve::update_lod( const view& scene)
+{
+	const array_version version = pos.get_version();
+	const double pixels = scene.view_width / scene.tan_hfov_x;
+	if (version == lod_pos_version && scene.camera == lod_camera
+			&& scene.forward == lod_forward && pixels == lod_pixels)
 		return;
-	const size_t true_size = count;
-	// Set up the leading and trailing points for the joins.  See
-	// glePolyCylinder() for details.  The intent is to create joins that are
-	// perpendicular to the path at the last segment.  When the path appears
-	// to be closed, it should be rendered that way on-screen.
-	// The maximum number of points to display.
-	const int LINE_LENGTH = 1000;
-	// Data storage for the position and color data (plus room for 3 extra points)
-	double spos[3*(LINE_LENGTH+3)];
-	float tcolor[3*(LINE_LENGTH+3)]; // opacity not yet implemented for curves
-	float fstep = (float)(count-1)/(float)(LINE_LENGTH-1);
-	if (fstep < 1.0F) fstep = 1.0F;
-	size_t iptr=0, iptr3, pcount=0;
+	// Points dropped by retaining are simply forgotten, but editing points
+	// that have been seen means starting over.
+	size_t begin, end;
+	if (pos.written_since( lod_pos_version, begin, end) && begin < lod_pos_version.end)
+		lod.clear();
+	lod.update( pos.data(), pos.first(), count);
+	lod_pos_version = version;
+	lod_camera = scene.camera;
+	lod_forward = scene.forward;
+	lod_pixels = pixels;
+
+	// Each span of the curve is drawn as simply as its distance allows, so
+	// that the far parts of a long curve are simplified even while a near
+	// part, or a sharp corner, is drawn in full.
+	span_accept accept = { &scene, pos.data() };
+	lod.indices( accept, lod_indices);
+	lod_active = lod_indices.size() < count;
+	lod_tube_stale = true;
+}
+
+bool
+curve::gl_render_tube( const view& scene)
+{
+	// Materials bring their own shaders, which can't be combined with this one.
+	// The ribbon is lit the same way as by materials.diffuse, which every
+	// object gets by default, so that one is drawn here.
+	if ((mat && mat->get_name() != "diffuse") || !scene.enable_shaders || !scene.glext.ARB_shader_objects
+		|| !update_tube( scene))
+		return false;
+
+	use_tube_shader program( scene, radius * scene.gcfvec[0]);
+	if (!program.ok())
+		return false;
+
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform( tube_origin);
+
+	// The previous and next points are the same data, one slot either side.
+	const char* base = 0;
+	const GLsizei stride = tube_pos_floats * sizeof(float);
+	const GLsizei color_stride = tube_color_floats * sizeof(float);
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	gl_enable_client prev( GL_TEXTURE_COORD_ARRAY);
+	gl_enable_client next( GL_NORMAL_ARRAY);
+	gl_enable_client colors( GL_COLOR_ARRAY);
+	// The vertexes of the slots before slot 0.
+	size_t skip = 2*(pos.first() - tube_first);
+	gl_buffer* vertex_buffer = &tube;
+	gl_buffer* color_buffer = &tube_colors;
+	size_t n = tube_count;
+	if (lod_active) {
+		// The simplified points have other neighbors.
+		if (lod_tube_stale)
+			write_lod_tube( scene, tube_color_mode);
+		skip = 0;
+		vertex_buffer = &lod_tube;
+		color_buffer = &lod_tube_colors;
+		n = lod_indices.size();
+	}
+	vertex_buffer->gl_bind( scene);
+	glVertexPointer( 4, GL_FLOAT, stride, base + (skip + 2)*stride);
+	glTexCoordPointer( 3, GL_FLOAT, stride, base + skip*stride);
+	glNormalPointer( GL_FLOAT, stride, base + (skip + 4)*stride);
+	color_buffer->gl_bind( scene);
+	glColorPointer( 3, GL_FLOAT, color_stride, base + (skip + 2)*color_stride);
+	glDrawArrays( GL_TRIANGLE_STRIP, 0, 2*n);
+	color_buffer->gl_unbind( scene);
+	return true;
+}
+
+bool
+curve::gl_render_line( const view& scene)
+{
+	if (!update_tube( scene))
+		return false;
+
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform( tube_origin);
+
+	// One vertex of each ribbon pair.
+	const char* base = 0;
+	const GLsizei stride = 2 * tube_pos_floats * sizeof(float);
+	const GLsizei color_stride = 2 * tube_color_floats * sizeof(float);
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	gl_enable_client colors( GL_COLOR_ARRAY);
+	const size_t shift = pos.first() - tube_first;
+	tube.gl_bind( scene);
+	glVertexPointer( 3, GL_FLOAT, stride, base + (shift + 1)*stride);
+	tube_colors.gl_bind( scene);
+	glColorPointer( 3, GL_FLOAT, color_stride, base + (shift + 1)*color_stride);
+	if (lod_active)
+		glDrawElements( GL_LINE_STRIP, lod_indices.size(), GL_UNSIGNED_INT, &lod_indices[0]);
+	else
+		glDrawArrays( GL_LINE_STRIP, 0, tube_count);
+	tube_colors.gl_unbind( scene);
+	return true;
+}
 
+void
+curve::gl_render_client( const view& scene)
+{
+	// Without buffer objects, draw from the points chosen for this level of
+	// detail, in place unless some are skipped.
+	const size_t pcount = lod_active ? lod_indices.size() : count;
+	std::vector<double> spos;
+	std::vector<float> tcolor( 3*pcount); // opacity not yet implemented for curves
 	const double* p_i = pos.data();
 	const double* c_i = color.data();
-
-	// Choose which points to display
-	for (float fptr=0.0; iptr < count && pcount < LINE_LENGTH; fptr += fstep, iptr = (int) (fptr+.5), ++pcount) {
-		iptr3 = 3*iptr;
-		spos[3*pcount] = p_i[iptr3];
-		spos[3*pcount+1] = p_i[iptr3+1];
-		spos[3*pcount+2] = p_i[iptr3+2];
-		tcolor[3*pcount] = c_i[iptr3];
-		tcolor[3*pcount+1] = c_i[iptr3+1];
-		tcolor[3*pcount+2] = c_i[iptr3+2];
+	if (lod_active) {
+		spos.resize( 3*pcount);
+		for (size_t i = 0; i < pcount; ++i)
+			for (int d = 0; d < 3; ++d)
+				spos[3*i+d] = p_i[3*lod_indices[i]+d];
+		p_i = &spos[0];
+	}
+	for (size_t i = 0; i < pcount; ++i) {
+		const size_t k = lod_active ? lod_indices[i] : i;
+		for (int d = 0; d < 3; ++d)
+			tcolor[3*i+d] = c_i[3*k+d];
 	}
 
-	// Do scaling if necessary
-	double scaled_radius = radius;
-	if (scene.gcf != 1.0 || (scene.gcfvec[0] != scene.gcfvec[1])) {
-		scaled_radius = radius*scene.gcfvec[0];
-		for (size_t i = 0; i < pcount; ++i) {
-			spos[3*i] *= scene.gcfvec[0];
-			spos[3*i+1] *= scene.gcfvec[1];
-			spos[3*i+2] *= scene.gcfvec[2];
-		}
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform();
+	if (radius == 0.0) {
+		gl_enable_client vertexes( GL_VERTEX_ARRAY);
+		glVertexPointer( 3, GL_DOUBLE, 0, p_i);
+		bool mono = adjust_colors( scene, &tcolor[0], pcount);
+		if (!mono) glColorPointer( 3, GL_FLOAT, 0, &tcolor[0]);
+		glDrawArrays( GL_LINE_STRIP, 0, pcount);
+		glDisableClientState( GL_COLOR_ARRAY);
+	}
+	else {
+		thickline( scene, p_i, &tcolor[0], pcount, radius);
 	}
+}
+
+void
+curve::gl_render( const view& scene)
+{
+	if (degenerate())
+		return;
 
 	clear_gl_error();
+	update_lod( scene);
 
 	if (radius == 0.0) {
-		glEnableClientState( GL_VERTEX_ARRAY);
 		glDisable( GL_LIGHTING);
-		// Assume monochrome.
 		if (antialias) {
 			glEnable( GL_LINE_SMOOTH);
 		}
-
-		glVertexPointer( 3, GL_DOUBLE, 0, spos);
-		bool mono = adjust_colors( scene, tcolor, pcount);
-		if (!mono) glColorPointer( 3, GL_FLOAT, 0, tcolor);
-		glDrawArrays( GL_LINE_STRIP, 0, pcount);
-		glDisableClientState( GL_VERTEX_ARRAY);
-		glDisableClientState( GL_COLOR_ARRAY);
+		if (!gl_render_line( scene))
+			gl_render_client( scene);
 		glEnable( GL_LIGHTING);
 		if (antialias) {
 			glDisable( GL_LINE_SMOOTH);
 		}
 	}
-	else {
-		thickline( scene, spos, tcolor, pcount, scaled_radius);
+	else if (!gl_render_tube( scene)) {
+		gl_render_client( scene);
 	}
 
 	check_gl_error();
@@ -457,29 +711,19 @@ curve::outer_render( const view& v ) {
 }
 
 void
-curve::get_material_matrix( const view& v, tmatrix& out ) {
+curve::get_material_matrix( const view&, tmatrix& out ) {
 	if (degenerate()) return;
 
 	// TODO: note this code is identical to faces::get_material_matrix, except for considering radius
 
-	// TODO: Add some caching for extent with grow_extent etc
-	vector min_extent, max_extent;
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.end();
-	min_extent = max_extent = vector( pos_i ); pos_i += 3;
-	while (pos_i < pos_end)
-		for(int j=0; j<3; j++) {
-			if (*pos_i < min_extent[j]) min_extent[j] = *pos_i;
-			else if (*pos_i > max_extent[j]) max_extent[j] = *pos_i;
-			pos_i++;
-		}
-
+	update_bounds();
+	vector min_extent = bounds_min, max_extent = bounds_max;
 	min_extent -= vector(radius,radius,radius);
 	max_extent += vector(radius,radius,radius);
 
 	out.translate( vector(.5,.5,.5) );
-	out.scale( vector(1,1,1) * (.999 / (v.gcf * std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z)))) );
-	out.translate( -.5 * v.gcf * (min_extent + max_extent) );
+	out.scale( vector(1,1,1) * (.999 / std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z))) );
+	out.translate( -.5 * (min_extent + max_extent) );
 }
 
 } } // !namespace cvisual::python
@@ -0,0 +1,534 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "python/curves.hpp"
+#include "util/gl_enable.hpp"
+#include "util/tube_shader.hpp"
+#include "util/errors.hpp"
+#include "material.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace cvisual { namespace python {
+
+namespace {
+// Floats per vertex: the point and its signed radius, then the previous and
+// next points.
+const size_t vertex_floats = 10;
+
+rgb
+anaglyph_color( const rgb& c, int color_mode)
+{
+	if (color_mode == 1)
+		return c.desaturate();
+	if (color_mode == 2)
+		return c.grayscale();
+	return c;
+}
+} // !namespace (anonymous)
+
+curves::curves()
+	: radius(0.0), antialias(true), pick_index(-1),
+	vertexes( GL_ARRAY_BUFFER_ARB), colors( GL_ARRAY_BUFFER_ARB),
+	dirty_begin(0), dirty_end(0), visible_changed(true),
+	buffer_count(0), buffer_capacity(0), buffer_color_mode(0)
+{
+}
+
+void
+curves::check_line( int line) const
+{
+	if (line < 0 || size_t(line) >= starts.size())
+		throw std::out_of_range( "line index out of range");
+}
+
+void
+curves::line_range( size_t line, size_t& begin, size_t& end) const
+{
+	begin = std::min( starts[line], count);
+	end = line + 1 < starts.size() ? std::min( starts[line+1], count) : count;
+	end = std::max( begin, end);
+}
+
+size_t
+curves::line_of( size_t point) const
+{
+	return std::upper_bound( starts.begin(), starts.end(), point) - starts.begin() - 1;
+}
+
+void
+curves::line_changed( size_t line)
+{
+	size_t begin, end;
+	line_range( line, begin, end);
+	dirty_begin = std::min( dirty_begin, begin);
+	dirty_end = std::max( dirty_end, end);
+	visible_changed = true;
+}
+
+void
+curves::all_lines_changed()
+{
+	dirty_begin = 0;
+	dirty_end = count;
+	visible_changed = true;
+}
+
+void
+curves::start_line( size_t first, const rgb& n_color, double n_radius)
+{
+	starts.push_back( first);
+	line_colors.push_back( n_color.red);
+	line_colors.push_back( n_color.green);
+	line_colors.push_back( n_color.blue);
+	line_radii.push_back( n_radius);
+	line_visible.push_back( true);
+}
+
+int
+curves::add_line( const double_array& n_pos, const rgb& n_color, double n_radius)
+{
+	std::vector<npy_intp> dims = shape( n_pos);
+	if (dims.size() != 2 || dims[1] != 3)
+		throw std::invalid_argument( "pos must be an Nx3 array");
+
+	const size_t first = count;
+	set_length( count + dims[0]);
+	std::memcpy( pos.data( first), data( n_pos), sizeof(double) * 3 * dims[0]);
+
+	start_line( first, n_color, n_radius);
+	line_changed( starts.size() - 1);
+	return starts.size() - 1;
+}
+
+int
+curves::add_line_default( const double_array& n_pos)
+{
+	return add_line( n_pos, color, radius);
+}
+
+int
+curves::add_line_color( const double_array& n_pos, const rgb& n_color)
+{
+	return add_line( n_pos, n_color, radius);
+}
+
+void
+curves::drop_points( size_t dropped)
+{
+	if (!dropped || starts.empty())
+		return;
+	// The last line runs to the end of pos, so it always keeps a point.
+	size_t gone = 0;
+	while (gone + 1 < starts.size() && starts[gone+1] <= dropped)
+		++gone;
+	starts.erase( starts.begin(), starts.begin() + gone);
+	line_colors.erase( line_colors.begin(), line_colors.begin() + 3*gone);
+	line_radii.erase( line_radii.begin(), line_radii.begin() + gone);
+	line_visible.erase( line_visible.begin(), line_visible.begin() + gone);
+	for (size_t i = 0; i < starts.size(); ++i)
+		starts[i] = starts[i] > dropped ? starts[i] - dropped : 0;
+	all_lines_changed();
+}
+
+void
+curves::append( const vector& n_pos, int retain)
+{
+	// Points appended to no line would never be drawn, so they start one.
+	if (starts.empty())
+		start_line( count, color, radius);
+	const size_t before = count;
+	arrayprim::append( n_pos, retain);
+	drop_points( before + 1 - count);
+}
+
+void
+curves::append_array( const double_array& n_pos, int retain)
+{
+	if (starts.empty())
+		start_line( count, color, radius);
+	const size_t before = count;
+	size_t n = point_rows( n_pos, "pos");
+	if (retain > 0)
+		n = std::min( n, (size_t)retain);
+	arrayprim::append_array( n_pos, retain);
+	drop_points( before + n - count);
+}
+
+list
+curves::get_offsets() const
+{
+	list ret;
+	for (size_t i = 0; i < starts.size(); ++i)
+		ret.append( starts[i]);
+	return ret;
+}
+
+void
+curves::set_offsets( const array& n_offsets)
+{
+	std::vector<npy_intp> dims = shape( n_offsets);
+	if (dims.size() != 1)
+		throw std::invalid_argument( "offsets must be a 1D array.");
+	if (dims[0] && !PyArray_ISINTEGER( (PyArrayObject*)n_offsets.ptr()))
+		throw std::invalid_argument( "offsets must be an array of integers.");
+	// A contiguous copy of a known integer type.
+	array offsets = astype( n_offsets, NPY_LONG);
+	const long* o = (const long*)data( offsets);
+	for (npy_intp i = 0; i < dims[0]; ++i)
+		if (o[i] < 0 || (size_t)o[i] > count || (i && o[i] < o[i-1]))
+			throw std::invalid_argument(
+				"offsets must be nondecreasing, from 0 up to the number of points.");
+
+	starts.assign( o, o + dims[0]);
+	const size_t old_lines = line_radii.size();
+	line_radii.resize( starts.size(), radius);
+	line_visible.resize( starts.size(), true);
+	line_colors.resize( 3*starts.size());
+	for (size_t i = old_lines; i < starts.size(); ++i) {
+		line_colors[3*i] = color.red;
+		line_colors[3*i+1] = color.green;
+		line_colors[3*i+2] = color.blue;
+	}
+	all_lines_changed();
+}
+
+rgb
+curves::get_line_color( int line) const
+{
+	check_line( line);
+	return rgb( line_colors[3*line], line_colors[3*line+1], line_colors[3*line+2]);
+}
+
+void
+curves::set_line_color( int line, const rgb& n_color)
+{
+	check_line( line);
+	line_colors[3*line] = n_color.red;
+	line_colors[3*line+1] = n_color.green;
+	line_colors[3*line+2] = n_color.blue;
+	line_changed( line);
+}
+
+double
+curves::get_line_radius( int line) const
+{
+	check_line( line);
+	return line_radii[line];
+}
+
+void
+curves::set_line_radius( int line, double n_radius)
+{
+	check_line( line);
+	line_radii[line] = n_radius;
+	line_changed( line);
+}
+
+bool
+curves::get_line_visible( int line) const
+{
+	check_line( line);
+	return line_visible[line];
+}
+
+void
+curves::set_line_visible( int line, bool n_visible)
+{
+	check_line( line);
+	line_visible[line] = n_visible;
+	visible_changed = true;
+}
+
+vector
+curves::get_center() const
+{
+	if (!count)
+		return vector();
+	update_bounds();
+	return pos_sum / count;
+}
+
+void
+curves::grow_extent( extent& world)
+{
+	const double* p = pos.data();
+	bool any = false;
+	for (size_t line = 0; line < starts.size(); ++line) {
+		if (!line_visible[line])
+			continue;
+		size_t begin, end;
+		line_range( line, begin, end);
+		for (size_t k = begin; k < end; ++k) {
+			if (line_radii[line])
+				world.add_sphere( vector( p + 3*k), line_radii[line]);
+			else
+				world.add_point( vector( p + 3*k));
+			any = true;
+		}
+	}
+	if (any)
+		world.add_body();
+}
+
+void
+curves::write_points( const view& scene, size_t first, size_t last, int color_mode)
+{
+	if (first >= last || starts.empty())
+		return;
+	std::vector<float> v( 2*(last - first) * vertex_floats);
+	std::vector<float> c( 2*(last - first) * 3);
+	const double* p = pos.data();
+
+	// Points before the first line belong to none, and are never drawn.
+	for (size_t line = line_of( std::max( first, starts[0])); line < starts.size(); ++line) {
+		size_t begin, end;
+		line_range( line, begin, end);
+		if (begin >= last)
+			break;
+		if (begin == end)
+			continue;
+		const bool closed = end - begin > 2
+			&& vector( p + 3*begin) == vector( p + 3*(end-1));
+		const rgb line_color = anaglyph_color( rgb( line_colors[3*line],
+			line_colors[3*line+1], line_colors[3*line+2]), color_mode);
+
+		for (size_t k = std::max( begin, first); k < std::min( end, last); ++k) {
+			const size_t prev = k > begin ? k-1 : closed ? end-2 : k;
+			const size_t next = k+1 < end ? k+1 : closed ? begin+1 : k;
+			for (int side = 0; side < 2; ++side) {
+				float* v_i = &v[(2*(k - first) + side) * vertex_floats];
+				float* c_i = &c[(2*(k - first) + side) * 3];
+				for (int d = 0; d < 3; ++d) {
+					v_i[d] = p[3*k+d] - buffer_origin[d];
+					v_i[4+d] = p[3*prev+d] - buffer_origin[d];
+					v_i[7+d] = p[3*next+d] - buffer_origin[d];
+				}
+				v_i[3] = side ? line_radii[line] : -line_radii[line];
+				c_i[0] = line_color.red;
+				c_i[1] = line_color.green;
+				c_i[2] = line_color.blue;
+			}
+		}
+	}
+	vertexes.gl_set_subdata( scene, 2*first * vertex_floats * sizeof(float),
+		v.size() * sizeof(float), &v[0]);
+	colors.gl_set_subdata( scene, 2*first * 3 * sizeof(float),
+		c.size() * sizeof(float), &c[0]);
+}
+
+void
+curves::update_buffers( const view& scene, int color_mode)
+{
+	const array_version version = pos.get_version();
+	size_t begin = dirty_begin, end = dirty_end;
+	size_t b, e;
+	if (pos.changed_since( buffer_pos_version, b, e)) {
+		begin = std::min( begin, b);
+		end = std::max( end, e);
+	}
+	end = std::min( end, count);
+
+	if (count > buffer_capacity || !vertexes.size() || color_mode != buffer_color_mode) {
+		// Grow geometrically, so that the cost of copying is amortized.
+		if (count > buffer_capacity || !vertexes.size()) {
+			buffer_capacity = std::max( 2*count, buffer_capacity);
+			vertexes.gl_set_data( scene, 2*buffer_capacity * vertex_floats * sizeof(float),
+				0, GL_DYNAMIC_DRAW_ARB);
+			colors.gl_set_data( scene, 2*buffer_capacity * 3 * sizeof(float),
+				0, GL_DYNAMIC_DRAW_ARB);
+		}
+		buffer_origin = count ? vector( pos.data()) : vector();
+		write_points( scene, 0, count, color_mode);
+	}
+	else if (begin < end) {
+		// The points either side see the changed ones as neighbors, and so do
+		// the far ends of the lines at either end, if they are closed.
+		begin = begin ? begin - 1 : 0;
+		end = std::min( end + 1, count);
+		write_points( scene, begin, end, color_mode);
+		if (!starts.empty() && end > starts[0]) {
+			const size_t lines[2] = { line_of( std::max( begin, starts[0])), line_of( end - 1) };
+			for (int i = 0; i < 2; ++i) {
+				size_t line_begin, line_end;
+				line_range( lines[i], line_begin, line_end);
+				if (line_begin == line_end)
+					continue;
+				if (line_begin < begin)
+					write_points( scene, line_begin, line_begin + 1, color_mode);
+				if (line_end > end)
+					write_points( scene, line_end - 1, line_end, color_mode);
+			}
+		}
+	}
+	if (count != buffer_count)
+		visible_changed = true;
+
+	dirty_begin = count;
+	dirty_end = 0;
+	buffer_pos_version = version;
+	buffer_count = count;
+	buffer_color_mode = color_mode;
+}
+
+void
+curves::fill_indices()
+{
+	thin_indices.clear();
+	thick_indices.clear();
+	for (size_t line = 0; line < starts.size(); ++line) {
+		if (!line_visible[line])
+			continue;
+		size_t begin, end;
+		line_range( line, begin, end);
+		for (size_t k = begin; k + 1 < end; ++k) {
+			const unsigned int a = 2*k;
+			const unsigned int b = a + 2;
+			if (line_radii[line] == 0.0) {
+				thin_indices.push_back( a);
+				thin_indices.push_back( b);
+			}
+			else {
+				thick_indices.push_back( a);
+				thick_indices.push_back( a+1);
+				thick_indices.push_back( b);
+				thick_indices.push_back( a+1);
+				thick_indices.push_back( b+1);
+				thick_indices.push_back( b);
+			}
+		}
+	}
+}
+
+namespace {
+// Draw GL_LINES from the current vertex arrays, unlit.
+void
+draw_lines( const std::vector<unsigned int>& indices, bool antialias)
+{
+	if (indices.empty())
+		return;
+	gl_disable lighting( GL_LIGHTING);
+	if (antialias)
+		glEnable( GL_LINE_SMOOTH);
+	glDrawElements( GL_LINES, indices.size(), GL_UNSIGNED_INT, &indices[0]);
+	if (antialias)
+		glDisable( GL_LINE_SMOOTH);
+}
+} // !namespace (anonymous)
+
+void
+curves::gl_render( const view& scene)
+{
+	if (starts.empty() || count < 2)
+		return;
+
+	clear_gl_error();
+	gl_matrix_stackguard guard;
+	const int color_mode = !scene.anaglyph ? 0 : scene.coloranaglyph ? 1 : 2;
+
+	if (!scene.glext.ARB_vertex_buffer_object) {
+		// Draw the centerline of each visible line from client memory.
+		scene.gl_world_transform();
+		gl_enable_client vertex_array( GL_VERTEX_ARRAY);
+		gl_disable lighting( GL_LIGHTING);
+		glVertexPointer( 3, GL_DOUBLE, 0, pos.data());
+		for (size_t line = 0; line < starts.size(); ++line) {
+			size_t begin, end;
+			line_range( line, begin, end);
+			if (!line_visible[line] || end - begin < 2)
+				continue;
+			anaglyph_color( rgb( line_colors[3*line], line_colors[3*line+1],
+				line_colors[3*line+2]), color_mode).gl_set( opacity);
+			glDrawArrays( GL_LINE_STRIP, begin, end - begin);
+		}
+		check_gl_error();
+		return;
+	}
+
+	update_buffers( scene, color_mode);
+	if (visible_changed) {
+		fill_indices();
+		visible_changed = false;
+	}
+
+	scene.gl_world_transform( buffer_origin);
+	const char* base = 0;
+	const GLsizei stride = vertex_floats * sizeof(float);
+	gl_enable_client vertex_array( GL_VERTEX_ARRAY);
+	gl_enable_client color_array( GL_COLOR_ARRAY);
+	colors.gl_bind( scene);
+	glColorPointer( 3, GL_FLOAT, 0, base);
+	vertexes.gl_bind( scene);
+	glVertexPointer( 3, GL_FLOAT, stride, base);
+	draw_lines( thin_indices, antialias);
+
+	if (!thick_indices.empty()) {
+		// Materials are not applied to curves, so the shader's lighting
+		// stands in for any untextured one.
+		bool drawn = false;
+		if ((!mat || mat->get_textures().empty())
+			&& scene.enable_shaders && scene.glext.ARB_shader_objects) {
+			use_tube_shader program( scene, scene.gcfvec[0]);
+			if (program.ok()) {
+				gl_enable_client prev( GL_TEXTURE_COORD_ARRAY);
+				gl_enable_client next( GL_NORMAL_ARRAY);
+				glVertexPointer( 4, GL_FLOAT, stride, base);
+				glTexCoordPointer( 3, GL_FLOAT, stride, base + 4*sizeof(float));
+				glNormalPointer( GL_FLOAT, stride, base + 7*sizeof(float));
+				glDrawElements( GL_TRIANGLES, thick_indices.size(), GL_UNSIGNED_INT,
+					&thick_indices[0]);
+				drawn = true;
+			}
+		}
+		if (!drawn) {
+			// Without the shader, thick lines are drawn as their centerlines.
+			std::vector<unsigned int> centerlines;
+			centerlines.reserve( thick_indices.size() / 3);
+			for (size_t i = 0; i < thick_indices.size(); i += 6) {
+				centerlines.push_back( thick_indices[i]);
+				centerlines.push_back( thick_indices[i+2]);
+			}
+			draw_lines( centerlines, antialias);
+		}
+	}
+	vertexes.gl_unbind( scene);
+	check_gl_error();
+}
+
+void
+curves::outer_render( const view& v)
+{
+	gl_render( v);  //< no materials
+}
+
+void
+curves::gl_pick_render( const view& scene)
+{
+	if (starts.empty() || count < 2)
+		return;
+	// Each line gets its own name, reported back through pick_names().
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform();
+	gl_enable_client vertex_array( GL_VERTEX_ARRAY);
+	glVertexPointer( 3, GL_DOUBLE, 0, pos.data());
+	glPushName( 0);
+	for (size_t line = 0; line < starts.size(); ++line) {
+		size_t begin, end;
+		line_range( line, begin, end);
+		if (!line_visible[line] || end - begin < 2)
+			continue;
+		glLoadName( line);
+		glDrawArrays( GL_LINE_STRIP, begin, end - begin);
+	}
+	glPopName();
+}
+
+void
+curves::pick_names( const unsigned int* name_top, const unsigned int*)
+{
+	pick_index = *name_top;
+}
+
+} } // !namespace cvisual::python
@@ -4,14 +4,18 @@
 
 #include <boost/python/detail/wrap_python.hpp>
 #include <boost/crc.hpp>
+#include <boost/bind.hpp>
 
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
+#include "util/parallel.hpp"
 
 #include "python/slice.hpp"
 #include "python/extrusion.hpp"
 
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
 #include <cassert>
 #include <sstream>
 #include <iostream>
@@ -28,7 +32,10 @@ extrusion::extrusion()
 	: antialias( true), up(vector(0,1,0)), smooth(0.95),
 	  show_start_face(true), show_end_face(true), twosided(true),
 	  start(0), end(-1), initial_twist(0.0), center(vector(0,0,0)),
-	  first_normal(vector(0,0,0)), last_normal(vector(0,0,0))
+	  first_normal(vector(0,0,0)), last_normal(vector(0,0,0)),
+	  mesh_made(false), mesh_stale(true), mesh_frame(0),
+	  lod_max_scale(1.0),
+	  lod_path_level(0), lod_section_level(0)
 {
 	scale.set_length(1);
 	double* k = scale.data();
@@ -36,15 +43,120 @@ extrusion::extrusion()
 	k[1] = 1.0; //scaley
 	k[2] = 0.0; // twist
 
-	contours.insert(contours.begin(), 0.0);
-	strips.insert(strips.begin(), 0.0);
-	pcontours.insert(pcontours.begin(), 0);
-	pstrips.insert(pstrips.begin(), 0);
-	normals2D.insert(normals2D.begin(), 0.0);
+	// No contours, until set_contours is called.
+	boost::shared_ptr<profile_data> empty( new profile_data);
+	empty->contours.push_back(0.0);
+	empty->strips.push_back(0.0);
+	empty->pcontours.push_back(0);
+	empty->pcontours.push_back(0);
+	empty->pstrips.push_back(0);
+	empty->smooth = smooth;
+	set_profile(empty);
 }
 
+extrusion::profile_cache extrusion::profiles;
+size_t extrusion::profiles_sweep_size = 64;
+mutex extrusion::profiles_lock;
+
 namespace numpy = boost::python::numeric;
 
+namespace {
+// The twist from point first to point last of the scale array, which includes
+// the twists of the points between, when they are not drawn.
+float
+twist_between(const double* scale, size_t first, size_t last)
+{
+	if (last <= first)
+		return scale[3*last+2];
+	double twist = 0.0;
+	for (size_t i = first+1; i <= last; ++i)
+		twist += scale[3*i+2];
+	return twist;
+}
+
+// The distance of 2D point p from the line segment from a to b.
+double
+segment_distance(const double* p, const double* a, const double* b)
+{
+	const double dx = b[0]-a[0], dy = b[1]-a[1];
+	const double length2 = dx*dx + dy*dy;
+	double t = length2 ? ((p[0]-a[0])*dx + (p[1]-a[1])*dy) / length2 : 0.0;
+	t = std::max(0.0, std::min(1.0, t));
+	const double ex = a[0] + t*dx - p[0], ey = a[1] + t*dy - p[1];
+	return std::sqrt(ex*ex + ey*ey);
+}
+
+// The level of detail to draw: the coarsest whose error is within tolerance.
+// errors[level] grows with the level.  A coarser level is only taken once it
+// is well within tolerance, and the current one kept while it is within, so
+// that a view near the threshold doesn't switch back and forth between them.
+const double lod_hysteresis = 1.5;
+
+int
+choose_level(const std::vector<double>& errors, double tolerance, int current)
+{
+	const int levels = errors.size();
+	if (current >= levels)
+		current = levels - 1;
+	int coarser = 0;
+	while (coarser+1 < levels && errors[coarser+1] <= tolerance / lod_hysteresis)
+		++coarser;
+	if (coarser >= current)
+		return coarser;
+	while (current > 0 && errors[current] > tolerance)
+		--current;
+	return current;
+}
+
+// Append the triangles of a triangle strip, all with the same normal and color.
+void
+strip_triangles(const std::vector<vector>& strip, const vector& normal, const vector& color,
+		std::vector<vector>& faces_pos,
+		std::vector<vector>& faces_normals,
+		std::vector<vector>& faces_colors)
+{
+	for (size_t n=0; n+2 < strip.size(); n++) {
+		if (n % 2) { // if odd
+			faces_pos.push_back(strip[n]);
+			faces_pos.push_back(strip[n+2]);
+			faces_pos.push_back(strip[n+1]);
+		} else {
+			faces_pos.insert(faces_pos.end(), strip.begin()+n, strip.begin()+n+3);
+		}
+		faces_normals.insert(faces_normals.end(), 3, normal);
+		faces_colors.insert(faces_colors.end(), 3, color);
+	}
+}
+
+// Copies corners of the mesh into 9 floats each, with positions made relative
+// to origin.
+struct mesh_floats
+{
+	const vector* pos;
+	const vector* normals;
+	const vector* colors;
+	vector origin;
+	float* out;
+
+	void operator()( size_t begin, size_t end) const
+	{
+		for (size_t i = begin; i < end; ++i) {
+			const vector p = pos[i] - origin;
+			float* m = out + 9*i;
+			m[0] = p.x;
+			m[1] = p.y;
+			m[2] = p.z;
+			m[3] = normals[i].x;
+			m[4] = normals[i].y;
+			m[5] = normals[i].z;
+			m[6] = colors[i].x;
+			m[7] = colors[i].y;
+			m[8] = colors[i].z;
+		}
+	}
+};
+} // !namespace (anonymous)
+
 //    Serious issue with 32bit vs 64bit machines, apparently,
 //    with respect to extract/converting from an array (e.g. double <- int),
 //    so for the time being, make sure that in primitives.py one builds
@@ -85,25 +197,95 @@ extrusion::set_contours( const numpy::array& _contours,  const numpy::array& _pc
 
 	// primitives.py sends to set_contours descriptions of the 2D surface; see extrusions.hpp
 	// We store the information in std::vector containers in flattened form.
-	build_contour<npy_float64>(_contours, contours);
-	build_contour<npy_int32>(_pcontours, pcontours);
-	shape_closed = (bool)pcontours[1];
+	boost::shared_ptr<profile_data> p( new profile_data);
+	build_contour<npy_float64>(_contours, p->contours);
+	build_contour<npy_int32>(_pcontours, p->pcontours);
+	if (p->pcontours[1]) {
+		build_contour<npy_float64>(_strips, p->strips);
+		build_contour<npy_int32>(_pstrips, p->pstrips);
+	} else {
+		p->strips.assign(1, 0.0);
+		p->pstrips.assign(1, 0);
+	}
+	p->smooth = smooth;
+	set_profile(p);
+	mesh_made = false;
+	lod_section_level = 0;
+}
 
-	if (shape_closed) {
-		build_contour<npy_float64>(_strips, strips);
-		build_contour<npy_int32>(_pstrips, pstrips);
+bool
+extrusion::profile_data::same_shape( const profile_data& other) const
+{
+	return smooth == other.smooth && contours == other.contours && pcontours == other.pcontours
+		&& strips == other.strips && pstrips == other.pstrips;
+}
+
+namespace {
+template <typename T>
+void
+crc_vector( boost::crc_32_type& crc, const std::vector<T>& v)
+{
+	const size_t n = v.size();
+	crc.process_bytes( &n, sizeof n);
+	if (n)
+		crc.process_bytes( &v[0], n * sizeof(T));
+}
+} // !namespace (anonymous)
+
+void
+extrusion::set_profile( const boost::shared_ptr<profile_data>& p)
+{
+	boost::crc_32_type crc;
+	crc_vector( crc, p->contours);
+	crc_vector( crc, p->pcontours);
+	crc_vector( crc, p->strips);
+	crc_vector( crc, p->pstrips);
+	crc.process_bytes( &p->smooth, sizeof p->smooth);
+	p->crc = crc.checksum();
+
+	lock L(profiles_lock);
+	std::pair<profile_cache::iterator, profile_cache::iterator> same = profiles.equal_range( p->crc);
+	for (profile_cache::iterator i = same.first; i != same.second; ++i) {
+		boost::shared_ptr<const profile_data> found = i->second.lock();
+		if (found && found->same_shape( *p)) {
+			profile = found;
+			return;
+		}
 	}
 
-	size_t ncontours = pcontours[0];
-	if (ncontours == 0) return;
-	size_t npoints = contours.size()/2; // total number of 2D points in all contours
+	process_profile( *p);
+	profiles.insert( std::make_pair( p->crc, boost::weak_ptr<const profile_data>( p)));
+	profile = p;
 
-	maxcontour = 0; // maximum number of points in any of the contours
-	for (size_t c=0; c < ncontours; c++) {
-		size_t nd = 2*pcontours[2*c+2]; // number of doubles in this contour
-		size_t base = 2*pcontours[2*c+3]; // location of first (x) member of 2D (x,y) point
-		if (nd/2 > maxcontour) maxcontour = nd/2;
+	// Drop the entries of profiles no longer used, whenever the cache has
+	// doubled in size since this was last done.
+	if (profiles.size() >= profiles_sweep_size) {
+		for (profile_cache::iterator i = profiles.begin(); i != profiles.end(); ) {
+			if (i->second.expired())
+				profiles.erase( i++);
+			else
+				++i;
+		}
+		profiles_sweep_size = std::max<size_t>( 64, 2*profiles.size());
+	}
+}
+
+void
+extrusion::process_profile( profile_data& p) const
+{
+	const std::vector<npy_float64>& contours = p.contours;
+	const std::vector<npy_int32>& pcontours = p.pcontours;
+	std::vector<double>& normals2D = p.normals2D;
+	p.closed = (bool)pcontours[1];
+	p.xmax = p.ymax = 0.0;
+
+	size_t ncontours = pcontours[0];
+	if (ncontours == 0) {
+		normals2D.assign(1, 0.0);
+		build_sections(p);
+		return;
 	}
+	size_t npoints = contours.size()/2; // total number of 2D points in all contours
 
 	double xmin, xmax, ymin, ymax; // find outer edges of shape
 	xmin = xmax = ymin = ymax = 0.0;
@@ -121,12 +303,12 @@ extrusion::set_contours( const numpy::array& _contours,  const numpy::array& _pc
 		}
 	}
 
-	shape_xmax = std::fabs(xmax);
+	p.xmax = std::fabs(xmax);
 	xmin = std::fabs(xmin);
-	shape_ymax = std::fabs(ymax);
+	p.ymax = std::fabs(ymax);
 	ymin = std::fabs(ymin);
-	if (xmin > shape_xmax) shape_xmax = xmin;
-	if (ymin > shape_ymax) shape_ymax= ymin;
+	if (xmin > p.xmax) p.xmax = xmin;
+	if (ymin > p.ymax) p.ymax= ymin;
 
 	// Set up 2D normals used to build OpenGL triangles.
 	// There are two per vertex, because each face of a side of an extrusion segment is a quadrilateral,
@@ -158,10 +340,74 @@ extrusion::set_contours( const numpy::array& _contours,  const numpy::array& _pc
 			i += 4; 
 		}
 	}
+	build_sections(p);
+}
+
+void
+extrusion::build_sections( profile_data& p) const
+{
+	const std::vector<npy_float64>& contours = p.contours;
+	const std::vector<npy_int32>& pcontours = p.pcontours;
+	const std::vector<double>& normals2D = p.normals2D;
+	std::vector<cross_section>& sections = p.sections;
+	sections.resize(1);
+	cross_section& whole = sections[0];
+	whole.contours = contours;
+	whole.pcontours = pcontours;
+	whole.normals2D = normals2D;
+	whole.error = 0.0;
+
+	size_t ncontours = pcontours[0];
+	if (ncontours == 0) return;
+	size_t fewest = p.closed ? 3 : 2; // the points a contour needs
+	for (size_t stride = 2; ; stride *= 2) {
+		cross_section level;
+		level.pcontours.push_back(pcontours[0]);
+		level.pcontours.push_back(pcontours[1]);
+		level.error = sections.back().error;
+		for (size_t c=0, nbase=0; c < ncontours; c++) {
+			size_t n = pcontours[2*c+2]; // number of points in this contour
+			size_t base = 2*pcontours[2*c+3]; // location of first (x) member of 2D (x,y) point
+			// Keep points 0, step, 2*step..., and the last of an open contour,
+			// with a smaller step for contours that would keep too few.
+			size_t step = stride;
+			while (step > 1 && (n+step-1)/step < fewest)
+				step /= 2;
+			std::vector<size_t> kept;
+			for (size_t i=0; i < n; i += step)
+				kept.push_back(i);
+			if (!p.closed && n && kept.back() != n-1)
+				kept.push_back(n-1);
+
+			level.pcontours.push_back(kept.size());
+			level.pcontours.push_back(level.contours.size()/2);
+			for (size_t k=0; k < kept.size(); k++) {
+				size_t a = kept[k];
+				// The edge from a to b stands for the original edges between them,
+				// with the normals at its ends of the first and last of those.
+				size_t b = (k+1 < kept.size()) ? kept[k+1] : n;
+				if (b == n && !p.closed)
+					b = a+1; // the last point of an open contour begins no edge
+				level.contours.push_back(contours[base+2*a]);
+				level.contours.push_back(contours[base+2*a+1]);
+				level.normals2D.push_back(normals2D[nbase+4*a]);
+				level.normals2D.push_back(normals2D[nbase+4*a+1]);
+				level.normals2D.push_back(normals2D[nbase+4*(b-1)+2]);
+				level.normals2D.push_back(normals2D[nbase+4*(b-1)+3]);
+				for (size_t i=a+1; i < b; i++)
+					level.error = std::max(level.error, segment_distance(&contours[base+2*i],
+						&contours[base+2*a], &contours[base+2*(b%n)]));
+			}
+			nbase += 4*n;
+		}
+		if (level.contours.size() == sections.back().contours.size())
+			break;
+		sections.push_back(level);
+	}
 }
 
 vector
-extrusion::smoothing(const vector& a, const vector& b) { // vectors a and b need not be normalized
+extrusion::smoothing(const vector& a, const vector& b) const { // vectors a and b need not be normalized
 	vector A = a.norm();
 	vector B = b.norm();
 	if (A.dot(B) > smooth) {
@@ -318,6 +564,7 @@ extrusion::appendpos_retain(const vector& n_pos, int retain) {
 	last_pos[0] = n_pos.x;
 	last_pos[1] = n_pos.y;
 	last_pos[2] = n_pos.z;
+	pos.modified( count-1, count);
 }
 
 void
@@ -326,7 +573,8 @@ extrusion::appendpos_color_retain(const vector& n_pos, const double_array& n_col
     std::vector<npy_intp> dims = shape(n_color);
 	if (dims.size() == 1 && dims[0] == 3) {
 		// A single color to be appended.
-		color[count-1] = n_color;
+		copy_rows( color, count-1, n_color, 0, 1);
+		color.modified( count-1, count);
 		return;
 	}
 	throw std::invalid_argument( "Appended color must have the form (red,green,blue)");
@@ -335,9 +583,11 @@ extrusion::appendpos_color_retain(const vector& n_pos, const double_array& n_col
 void
 extrusion::appendpos_rgb_retain(const vector& n_pos, const double red, const double green, const double blue, const int retain) {
 	appendpos_retain(n_pos, retain);
-	if (red >= 0) color[count-1][0] = red;
-	if (green >= 0) color[count-1][1] = green;
-	if (blue >= 0) color[count-1][2] = blue;
+	double* last_color = color.data( count-1);
+	if (red >= 0) last_color[0] = red;
+	if (green >= 0) last_color[1] = green;
+	if (blue >= 0) last_color[2] = blue;
+	color.modified( count-1, count);
 }
 
 void
@@ -345,23 +595,27 @@ extrusion::set_scale( const double_array& n_scale)
 {
 	std::vector<npy_intp> dims = shape( n_scale );
 	if (dims.size() == 1 && !dims[0]) { // scale=() or [];  reset to size 1
-		scale[make_tuple(all(), slice(0,2))] = 1.0;
+		scale[make_tuple(scale.all(), slice(0,2))] = 1.0;
+		scale_modified();
 		return;
 	}
 	if (dims.size() == 1 && dims[0] == 1) { // scale=[2]
 		set_length( dims[0] );
-		scale[make_tuple(all(), 0)] = n_scale;
-		scale[make_tuple(all(), 1)] = n_scale;
+		scale[make_tuple(scale.all(), 0)] = n_scale;
+		scale[make_tuple(scale.all(), 1)] = n_scale;
+		scale_modified();
 		return;
 	}
 	if (dims.size() == 1 && dims[0] == 2) { // scale=(2,3) or [2,3]
 		set_length( dims[0] );
-		scale[make_tuple(all(), slice(0,2))] = n_scale;
+		scale[make_tuple(scale.all(), slice(0,2))] = n_scale;
+		scale_modified();
 		return;
 	}
 	if (dims.size() == 2 && dims[1] == 2) { // scale=[(2,3),(4,5)....]
 		set_length( dims[0] );
-		scale[make_tuple(all(), slice(0,2))] = n_scale;
+		scale[make_tuple(scale.all(), slice(0,2))] = n_scale;
+		scale_modified();
 		return;
 	}
 	else {
@@ -373,12 +627,14 @@ void
 extrusion::set_scale_d( const double n_scale)
 {
 	int npoints = count ? count : 1;
-	scale[make_tuple(slice(0,npoints), 0)] = n_scale;
-	scale[make_tuple(slice(0,npoints), 1)] = n_scale;
+	scale[make_tuple(scale.rows(0,npoints), 0)] = n_scale;
+	scale[make_tuple(scale.rows(0,npoints), 1)] = n_scale;
+	scale_modified();
 }
 
 boost::python::object extrusion::get_scale() {
-	return scale[make_tuple(all(), slice(0,2))];
+	scale.expose(); // it may be written through
+	return scale[make_tuple(scale.all(), slice(0,2))];
 }
 
 void
@@ -386,7 +642,8 @@ extrusion::set_xscale( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("xscale must be a 1D array.");
 	set_length( shape(arg)[0] );
-	scale[make_tuple( all(), 0)] = arg;
+	scale[make_tuple( scale.all(), 0)] = arg;
+	scale_modified();
 }
 
 void
@@ -394,20 +651,23 @@ extrusion::set_yscale( const double_array& arg )
 {
 	if (shape(arg).size() != 1) throw std::invalid_argument("yscale must be a 1D array.");
 	set_length( shape(arg)[0] );
-	scale[make_tuple( all(), 1)] = arg;
+	scale[make_tuple( scale.all(), 1)] = arg;
+	scale_modified();
 }
 
 void
 extrusion::set_xscale_d( const double arg )
 {
 	int npoints = count ? count : 1;
-	scale[make_tuple(slice(0,npoints), 0)] = arg;
+	scale[make_tuple(scale.rows(0,npoints), 0)] = arg;
+	scale_modified();
 }
 
 void extrusion::set_yscale_d( const double arg )
 {
 	int npoints = count ? count : 1;
-	scale[make_tuple(slice(0,npoints), 1)] = arg;
+	scale[make_tuple(scale.rows(0,npoints), 1)] = arg;
+	scale_modified();
 }
 
 void
@@ -415,16 +675,19 @@ extrusion::set_twist( const double_array& n_twist)
 {
 	std::vector<npy_intp> dims = shape( n_twist );
 	if (dims.size() == 1 && !dims[0]) { // twist()
-		scale[make_tuple(all(), 2)] = 0.0;
+		scale[make_tuple(scale.all(), 2)] = 0.0;
+		scale_modified();
 		return;
 	}
 	if (dims.size() == 1 && dims[0] == 1) { // twist(t)
-		scale[make_tuple(all(), 2)] = n_twist;
+		scale[make_tuple(scale.all(), 2)] = n_twist;
+		scale_modified();
 		return;
 	}
 	if (dims.size() == 1) { // twist(1,2,3)
 		set_length( dims[0] );
-		scale[make_tuple(all(), 2)] = n_twist;
+		scale[make_tuple(scale.all(), 2)] = n_twist;
+		scale_modified();
 		return;
 	}
 	if (dims.size() != 2) {
@@ -432,7 +695,8 @@ extrusion::set_twist( const double_array& n_twist)
 	}
 	if (dims[1] == 1) {
 		set_length( dims[0] );
-		scale[make_tuple(all(), 2)] = n_twist;
+		scale[make_tuple(scale.all(), 2)] = n_twist;
+		scale_modified();
 		return;
 	}
 	else {
@@ -444,15 +708,18 @@ void
 extrusion::set_twist_d( const double n_twist)
 {
 	int npoints = count ? count : 1;
-	scale[make_tuple(slice(0,npoints), 2)] = n_twist;
+	scale[make_tuple(scale.rows(0,npoints), 2)] = n_twist;
+	scale_modified();
 }
 
 boost::python::object extrusion::get_twist() {
-	return scale[make_tuple(all(), 2)];
+	scale.expose(); // it may be written through
+	return scale[make_tuple(scale.all(), 2)];
 }
 void
 extrusion::set_initial_twist(const double n_initial_twist) {
 	initial_twist = n_initial_twist;
+	mesh_made = false;
 }
 
 double
@@ -463,6 +730,7 @@ extrusion::get_initial_twist(){
 void
 extrusion::set_start(const int n_start) {
 	start = n_start;
+	mesh_made = false;
 }
 
 int
@@ -473,6 +741,7 @@ extrusion::get_start(){
 void
 extrusion::set_end(const int n_end){
 	end = n_end;
+	mesh_made = false;
 }
 
 int
@@ -483,6 +752,7 @@ extrusion::get_end() {
 void
 extrusion::set_twosided(const bool n_twosided){
 	twosided = n_twosided;
+	mesh_made = false;
 }
 
 bool
@@ -493,6 +763,7 @@ extrusion::get_twosided() {
 void
 extrusion::set_show_start_face(const bool n_show_start_face) {
 	show_start_face = n_show_start_face;
+	mesh_made = false;
 }
 
 bool
@@ -503,6 +774,7 @@ extrusion::get_show_start_face(){
 void
 extrusion::set_show_end_face(const bool n_show_end_face){
 	show_end_face = n_show_end_face;
+	mesh_made = false;
 }
 
 bool
@@ -513,6 +785,7 @@ extrusion::get_show_end_face() {
 void
 extrusion::set_smooth(const double n_smooth){
 	smooth = n_smooth;
+	mesh_made = false;
 }
 
 double
@@ -520,23 +793,6 @@ extrusion::get_smooth() {
 	return smooth;
 }
 
-bool
-extrusion::monochrome(double* tcolor, size_t pcount)
-{
-	rgb first_color( tcolor[0], tcolor[1], tcolor[2]);
-	size_t nn;
-
-	for(nn=0; nn<pcount; nn++)  {
-		if (tcolor[nn*3] != first_color.red)
-			return false;
-		if (tcolor[nn*3+1] != first_color.green)
-			return false;
-		if (tcolor[nn*3+2] != first_color.blue)
-			return false;
-	}
-	return true;
-}
-
 void
 extrusion::gl_pick_render( const view& scene)
 {
@@ -638,11 +894,11 @@ extrusion::grow_extent( extent& world)
 	pos_i += 3*istart;
 	s_i += 3*istart;
 	if (count == 0) { // just show shape
-		world.add_sphere(vector(0,0,0), std::max(shape_xmax*scale.data()[0],shape_ymax*scale.data()[1]));
+		world.add_sphere(vector(0,0,0), std::max(profile->xmax*scale.data()[0],profile->ymax*scale.data()[1]));
 	} else {
 		for (size_t i=istart; i <= iend; i++, pos_i+=3, s_i+=3) {
-			double xmax = s_i[0]*shape_xmax;
-			double ymax = s_i[1]*shape_ymax;
+			double xmax = s_i[0]*profile->xmax;
+			double ymax = s_i[1]*profile->ymax;
 			if (ymax > xmax) xmax = ymax;
 			if (xmax > maxextent) maxextent = xmax;
 			world.add_sphere( vector(pos_i), xmax);
@@ -651,41 +907,23 @@ extrusion::grow_extent( extent& world)
 	world.add_body();
 }
 
-bool
+void
 extrusion::adjust_colors( const view& scene, double* tcolor, size_t pcount)
 {
+	if (!scene.anaglyph)
+		return;
+	// Must desaturate or grayscale the color.
 	rgb rendered_color;
-	bool mono = monochrome(tcolor, pcount);
-	if (mono) {
-		// We can get away without using a color array.
-		rendered_color = rgb( tcolor[0], tcolor[1], tcolor[2]);
-		if (scene.anaglyph) {
-			if (scene.coloranaglyph)
-				rendered_color.desaturate().gl_set(opacity);
-			else
-				rendered_color.grayscale().gl_set(opacity);
-		}
+	for (size_t i = 0; i < pcount; ++i) {
+		rendered_color = rgb( tcolor[3*i], tcolor[3*i+1], tcolor[3*i+2]);
+		if (scene.coloranaglyph)
+			rendered_color = rendered_color.desaturate();
 		else
-			rendered_color.gl_set(opacity);
+			rendered_color = rendered_color.grayscale();
+		tcolor[3*i] = rendered_color.red;
+		tcolor[3*i+1] = rendered_color.green;
+		tcolor[3*i+2] = rendered_color.blue;
 	}
-	else {
-		glEnableClientState( GL_COLOR_ARRAY);
-		if (scene.anaglyph) {
-			// Must desaturate or grayscale the color.
-
-			for (size_t i = 0; i < pcount; ++i) {
-				rendered_color = rgb( tcolor[3*i], tcolor[3*i+1], tcolor[3*i+2]);
-				if (scene.coloranaglyph)
-					rendered_color = rendered_color.desaturate();
-				else
-					rendered_color = rendered_color.grayscale();
-				tcolor[3*i] = rendered_color.red;
-				tcolor[3*i+1] = rendered_color.green;
-				tcolor[3*i+2] = rendered_color.blue;
-			}
-		}
-	}
-	return mono;
 }
 
 // There were unsolvable problems with rotate. See comments with intrude routine.
@@ -711,20 +949,133 @@ extrusion::rotate( double angle, const vector& _axis, const vector& origin)
 */
 
 void
-extrusion::gl_render( const view& scene)
+extrusion::update_lod( const view& scene)
+{
+	const array_version version = pos.get_version();
+	size_t begin, end;
+	if (pos.written_since( lod_pos_version, begin, end) && begin < lod_pos_version.end)
+		path_lod.clear();
+	lod_pos_version = version;
+	path_lod.update( pos.data(), pos.first(), count);
+
+	const array_version scale_version = scale.get_version();
+	if (scale_version != lod_scale_version) {
+		lod_scale_version = scale_version;
+		lod_max_scale = 0.0;
+		const double* s_i = scale.data();
+		for (size_t i = 0; i < std::max<size_t>( count, 1); ++i, s_i += 3)
+			lod_max_scale = std::max( lod_max_scale, std::max( std::fabs(s_i[0]), std::fabs(s_i[1])));
+	}
+
+	// As for curves, the detail needed is set by the part nearest the camera,
+	// where the simplified path and cross section must stay within half a
+	// pixel of the original.
+	double pixels_per_unit = 0.0;
+	if (count && profile->pcontours[0]) {
+		update_bounds();
+		const vector& lo = bounds_min;
+		const vector& hi = bounds_max;
+		double nearest = 0.0;
+		for (int c = 0; c < 8; ++c) {
+			const vector corner( c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z);
+			const double dist = (corner - scene.camera).dot( scene.forward);
+			if (!c || dist < nearest)
+				nearest = dist;
+		}
+		nearest -= lod_max_scale * std::max( profile->xmax, profile->ymax);
+		if (nearest > 0.0)
+			pixels_per_unit = scene.pixel_coverage( scene.camera + scene.forward * nearest, 0.5);
+	}
+	if (pixels_per_unit <= 0.0) {
+		lod_path_level = lod_section_level = 0;
+		return;
+	}
+	const double tolerance = 0.5 / pixels_per_unit;
+
+	std::vector<double> errors;
+	for (int level = 0; level < path_lod.levels(); ++level)
+		errors.push_back( path_lod.error( level));
+	lod_path_level = choose_level( errors, tolerance, lod_path_level);
+	errors.clear();
+	for (size_t level = 0; level < profile->sections.size(); ++level)
+		errors.push_back( profile->sections[level].error * lod_max_scale);
+	lod_section_level = choose_level( errors, tolerance, lod_section_level);
+}
+
+void
+extrusion::update_mesh( const view& scene)
 {
+	// outer_render and gl_render both need the mesh, but it is checked
+	// against the arrays and the camera only once a frame.
+	if (mesh_made && mesh_frame == renderable::frame())
+		return;
+	mesh_frame = renderable::frame();
+	update_lod( scene);
+	const array_version pos_version = pos.get_version();
+	const array_version color_version = color.get_version();
+	const array_version scale_version = scale.get_version();
+	const int anaglyph = scene.anaglyph ? (scene.coloranaglyph ? 2 : 1) : 0;
+	if (mesh_made && pos_version == mesh_pos_version && color_version == mesh_color_version
+			&& scale_version == mesh_scale_version && anaglyph == mesh_anaglyph && up == mesh_up
+			&& lod_path_level == mesh_path_level && lod_section_level == mesh_section_level)
+		return;
+	mesh_made = true;
+	mesh_pos_version = pos_version;
+	mesh_color_version = color_version;
+	mesh_scale_version = scale_version;
+	mesh_anaglyph = anaglyph;
+	mesh_up = up;
+	mesh_path_level = lod_path_level;
+	mesh_section_level = lod_section_level;
+	mesh_stale = true;
+
 	std::vector<vector> faces_pos;
 	std::vector<vector> faces_normals;
 	std::vector<vector> faces_colors;
+	extrude(scene, faces_pos, faces_normals, faces_colors, false);
+
+	// Positions are kept relative to the first, so that floats suffice.
+	mesh_origin = faces_pos.empty() ? vector() : faces_pos[0];
+	mesh.resize(9*faces_pos.size());
+	if (!faces_pos.empty()) {
+		mesh_floats converter = { &faces_pos[0], &faces_normals[0], &faces_colors[0],
+			mesh_origin, &mesh[0] };
+		parallel_for( faces_pos.size(), 65536, converter);
+	}
+}
+
+void
+extrusion::gl_render( const view& scene)
+{
+	update_mesh( scene);
+	if (mesh.empty())
+		return;
+
 	clear_gl_error();
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform( mesh_origin);
 	gl_enable_client vertex_arrays( GL_VERTEX_ARRAY);
 	gl_enable_client normal_arrays( GL_NORMAL_ARRAY);
 	gl_enable_client colors( GL_COLOR_ARRAY);
 	gl_enable cull_face( GL_CULL_FACE);
-	extrude(scene, faces_pos, faces_normals, faces_colors, false);
-	glDisableClientState( GL_VERTEX_ARRAY);
-	glDisableClientState( GL_NORMAL_ARRAY);
-	glDisableClientState( GL_COLOR_ARRAY);
+
+	const float* base = &mesh[0];
+	const bool buffered = scene.glext.ARB_vertex_buffer_object;
+	if (buffered) {
+		if (mesh_stale || !mesh_buffer.size())
+			mesh_buffer.gl_set_data( scene, mesh.size() * sizeof(float), &mesh[0]);
+		else
+			mesh_buffer.gl_bind( scene);
+		mesh_stale = false;
+		base = 0;
+	}
+	const GLsizei stride = 9*sizeof(float);
+	glVertexPointer( 3, GL_FLOAT, stride, base);
+	glNormalPointer( GL_FLOAT, stride, base + 3);
+	glColorPointer( 3, GL_FLOAT, stride, base + 6);
+	glDrawArrays( GL_TRIANGLES, 0, mesh.size() / 9);
+	if (buffered)
+		mesh_buffer.gl_unbind( scene);
 	check_gl_error();
 }
 
@@ -757,45 +1108,29 @@ extrusion::render_end(const vector V, const vector current,
 		std::vector<vector>& faces_normals,
 		std::vector<vector>& faces_colors, bool make_faces)
 {
-	// if (make_faces && show_first), make the first set of triangles else make the second set
+	// If show_first, make the first set of triangles, else make the second set;
+	// when drawing a two-sided extrusion, make both.
+	const bool first = show_first || (!make_faces && twosided);
+	const bool second = !show_first || (!make_faces && twosided);
 
 	// Use the triangle strips in "strips" to paint an end of the extrusion
+	const std::vector<npy_float64>& strips = profile->strips;
+	const std::vector<npy_int32>& pstrips = profile->pstrips;
 	size_t npstrips = pstrips[0]; // number of triangle strips in the cross section
-	size_t spoints = strips.size()/2; // total number of 2D points in all strips
 	double tx, ty;
 
 	for (size_t c=0; c<npstrips; c++) {
 		size_t nd = 2*pstrips[2*c+2]; // number of doubles in this strip
 		size_t base = 2*pstrips[2*c+3]; // initial (x,y) = (strips[base], strips[base+1])
-		std::vector<vector> tristrip(nd/2), snormals(nd/2), endcolors(nd/2);
+		std::vector<vector> tristrip(nd/2);
 
 		for (size_t pt=0, n=0; pt<nd; pt+=2, n++) {
 			tx = c11*strips[base+pt] + c12*strips[base+pt+1];
 			ty = c21*strips[base+pt] + c22*strips[base+pt+1];
 			tristrip[n] = current + tx*xrot + ty*y;
-			snormals[n] = V;
-			endcolors[n] = current_color;
-		}
-
-		if (!make_faces && (show_first || twosided)) {
-			glNormalPointer( GL_DOUBLE, 0, &snormals[0]);
-			glVertexPointer(3, GL_DOUBLE, 0, &tristrip[0]);
-			glColorPointer(3, GL_DOUBLE, 0, &endcolors[0]);
-			// nd doubles, nd/2 vertices
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, nd/2);
-		} else if (make_faces && show_first){
-			for (size_t pt=0, n=0; pt<(nd-4); pt+=2, n++) {
-				faces_normals.insert(faces_normals.end(), snormals.begin()+n, snormals.begin()+n+3);
-				faces_colors.insert(faces_colors.end(), endcolors.begin()+n, endcolors.begin()+n+3);
-				if (n % 2) { // if odd
-					faces_pos.push_back(tristrip[n]);
-					faces_pos.push_back(tristrip[n+2]);
-					faces_pos.push_back(tristrip[n+1]);
-				} else {
-					faces_pos.insert(faces_pos.end(), tristrip.begin()+n, tristrip.begin()+n+3);
-				}
-			}
 		}
+		if (first)
+			strip_triangles(tristrip, V, current_color, faces_pos, faces_normals, faces_colors);
 
 		// Make two-sided:
 		for (size_t pt=0, n=0; pt<nd; pt+=2, n++) {
@@ -812,103 +1147,11 @@ extrusion::render_end(const vector V, const vector current,
 			tx = c11*strips[base+pt] + c12*strips[base+pt+1];
 			ty = c21*strips[base+pt] + c22*strips[base+pt+1];
 			tristrip[nswap] = current + tx*xrot + ty*y;
-			snormals[n] = -V;
-		}
-
-		if (!make_faces && (!show_first || twosided)) {
-			// nd doubles, nd/2 vertices
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, nd/2);
-		} else if (make_faces && !show_first){
-			for (size_t pt=0, n=0; pt<(nd-4); pt+=2, n++) {
-				faces_normals.insert(faces_normals.end(), snormals.begin()+n, snormals.begin()+n+3);
-				faces_colors.insert(faces_colors.end(), endcolors.begin()+n, endcolors.begin()+n+3);
-				if (n % 2) { // if odd
-					faces_pos.push_back(tristrip[n]);
-					faces_pos.push_back(tristrip[n+2]);
-					faces_pos.push_back(tristrip[n+1]);
-				} else {
-					faces_pos.insert(faces_pos.end(), tristrip.begin()+n, tristrip.begin()+n+3);
-				}
-			}
-		}
-	}
-}
-
-	/* The following code converts the triangle strips to triangles. For a big text object it was half as fast.
-	// The code is being saved here for the time being on the chance it would be useful in the case of wrapping an extrusion.
-	for (size_t c=0; c<npstrips; c++) {
-		size_t nd = 2*pstrips[2*c+2]; // number of doubles in this strip
-		size_t base = 2*pstrips[2*c+3]; // initial (x,y) = (strips[base], strips[base+1])
-		std::vector<vector> v(nd/2);
-
-		for (size_t pt=0, n=0; pt<nd; pt+=2, n++) {
-			tx = c11*strips[base+pt] + c12*strips[base+pt+1];
-			ty = c21*strips[base+pt] + c22*strips[base+pt+1];
-			v[n] = current + tx*xrot + ty*y; // create array of nd/2 3D vector strip locations
-		}
-
-		if (!make_faces) {
-			faces_pos.reserve(nd/2-2);
-			faces_normals.reserve(nd/2-2);
-			faces_colors.reserve(nd/2-2);
-			faces_pos.clear();
-			faces_normals.clear();
-			faces_colors.clear();
-		}
-
-		if (show_first || (!make_faces && twosided)){
-			for (size_t n=0; n<(nd/2-2); n++) {
-				faces_normals.push_back(V);
-				faces_normals.push_back(V);
-				faces_normals.push_back(V);
-				faces_colors.push_back(current_color);
-				faces_colors.push_back(current_color);
-				faces_colors.push_back(current_color);
-				if (n % 2) { // if odd
-					faces_pos.push_back(v[n  ]);
-					faces_pos.push_back(v[n+2]);
-					faces_pos.push_back(v[n+1]);
-				} else {
-					faces_pos.insert(faces_pos.end(), v.begin()+n, v.begin()+n+3);
-				}
-			}
-			if (!make_faces) {
-				glNormalPointer( GL_DOUBLE, 0, &faces_normals[0]);
-				glVertexPointer(3, GL_DOUBLE, 0, &faces_pos[0]);
-				glColorPointer(3, GL_DOUBLE, 0, &faces_colors[0]);
-				glDrawArrays(GL_TRIANGLES, 0, faces_pos.size());
-				faces_pos.clear();
-				faces_normals.clear();
-				faces_colors.clear();
-			}
-		}
-
-		if (!show_first || (!make_faces && twosided)){
-			for (size_t n=0; n<(nd/2-2); n++) {
-				faces_normals.push_back(-V);
-				faces_normals.push_back(-V);
-				faces_normals.push_back(-V);
-				faces_colors.push_back(current_color);
-				faces_colors.push_back(current_color);
-				faces_colors.push_back(current_color);
-				if (n % 2) { // if odd
-					faces_pos.insert(faces_pos.end(), v.begin()+n, v.begin()+n+3);
-				} else {
-					faces_pos.push_back(v[n  ]);
-					faces_pos.push_back(v[n+2]);
-					faces_pos.push_back(v[n+1]);
-				}
-			}
-			if (!make_faces) {
-				glNormalPointer( GL_DOUBLE, 0, &faces_normals[0]);
-				glVertexPointer(3, GL_DOUBLE, 0, &faces_pos[0]);
-				glColorPointer(3, GL_DOUBLE, 0, &faces_colors[0]);
-				glDrawArrays(GL_TRIANGLES, 0, faces_pos.size());
-			}
 		}
+		if (second)
+			strip_triangles(tristrip, -V, current_color, faces_pos, faces_normals, faces_colors);
 	}
 }
-*/
 
 void
 extrusion::extrude( const view& scene,
@@ -1012,7 +1255,18 @@ extrusion::extrude( const view& scene,
 	double spos[3*(LINE_LENGTH+3+3+3)]; // room for extra point if startcorner and endcorner in same step
 	double tcolor[3*(LINE_LENGTH+3+3+3)];
 	float tscale[3*(LINE_LENGTH+3+3+3)]; // scale factors, and twist
-	float fstep = (float)(count-1)/(float)(LINE_LENGTH-1);
+	// The points that may be drawn: all of them, or when distant those that
+	// path_lod keeps at lod_path_level.  Of these at most LINE_LENGTH are
+	// taken, evenly spaced.
+	std::vector<unsigned int> shown;
+	if (!make_faces && lod_path_level && count > 2 && path_lod.size() == count)
+		path_lod.indices( lod_path_level, shown);
+	else {
+		shown.resize( count);
+		for (size_t i = 0; i < count; ++i)
+			shown[i] = i;
+	}
+	float fstep = shown.empty() ? 1.0F : (float)(shown.size()-1)/(float)(LINE_LENGTH-1);
 	if (fstep < 1.0F) fstep = 1.0F;
 	size_t iptr=0, iptr3, pcount=0;
 
@@ -1062,48 +1316,51 @@ extrusion::extrude( const view& scene,
 	} else {
 		size_t tstart = startcorner;
 		size_t tend = endcorner;
-		size_t stepsize = (int)(fstep+.5);
+		size_t taken = 0; // the last point chosen
+		size_t k = 0; // the index into shown
 		// Choose which points to display
-		for (float fptr=0.0; iptr < count && pcount < LINE_LENGTH; fptr += fstep, iptr = (int)(fptr+.5), ++pcount) {
+		for (float fptr=0.0; k < shown.size() && pcount < LINE_LENGTH; fptr += fstep, k = (size_t)(fptr+.5), ++pcount) {
+			iptr = shown[k];
+			// The points up to the next one chosen are skipped.
+			const size_t k_next = (size_t)(fptr+fstep+.5);
+			const size_t next = k_next < shown.size() ? shown[k_next] : count;
 			size_t startoffset = 0;
-			size_t endoffset = 0;
 			// Make sure that startcorner is in the display set
-			if (stepsize > 1 && startcorner >= iptr && startcorner < iptr+stepsize) {
+			if (startcorner >= iptr && startcorner < next) {
 				startoffset = startcorner-iptr;
 				tstart = pcount;
 			}
 
 			iptr3 = 3*(iptr+startoffset);
-			spos[3*pcount  ] = scene.gcf*v_i[iptr3];
-			spos[3*pcount+1] = scene.gcf*v_i[iptr3+1];
-			spos[3*pcount+2] = scene.gcf*v_i[iptr3+2];
+			spos[3*pcount  ] = v_i[iptr3];
+			spos[3*pcount+1] = v_i[iptr3+1];
+			spos[3*pcount+2] = v_i[iptr3+2];
 			tcolor[3*pcount  ] = cd_i[iptr3];
 			tcolor[3*pcount+1] = cd_i[iptr3+1];
 			tcolor[3*pcount+2] = cd_i[iptr3+2];
 			tscale[3*pcount  ] = sd_i[iptr3];
 			tscale[3*pcount+1] = sd_i[iptr3+1];
-			tscale[3*pcount+2] = sd_i[iptr3+2];
+			tscale[3*pcount+2] = twist_between(sd_i, taken, iptr+startoffset);
+			taken = iptr+startoffset;
 
 			// Make sure that endcorner is in the display set
-			if (stepsize > 1 && endcorner >= iptr && endcorner < iptr+stepsize) {
-				endoffset = endcorner-iptr;
-				if (endcorner == startcorner) {
+			if (endcorner >= iptr && endcorner < next) {
+				if (endcorner == taken) {
 					// Already have this point
-					tend = tstart;
-				} else if (iptr == count-1) {
 					tend = pcount;
 				} else {
-					iptr3 = 3*(iptr+endoffset);
-					spos[3*pcount  ] = scene.gcf*v_i[iptr3];
-					spos[3*pcount+1] = scene.gcf*v_i[iptr3+1];
-					spos[3*pcount+2] = scene.gcf*v_i[iptr3+2];
+					pcount += 1;
+					iptr3 = 3*endcorner;
+					spos[3*pcount  ] = v_i[iptr3];
+					spos[3*pcount+1] = v_i[iptr3+1];
+					spos[3*pcount+2] = v_i[iptr3+2];
 					tcolor[3*pcount  ] = cd_i[iptr3];
 					tcolor[3*pcount+1] = cd_i[iptr3+1];
 					tcolor[3*pcount+2] = cd_i[iptr3+2];
 					tscale[3*pcount  ] = sd_i[iptr3];
 					tscale[3*pcount+1] = sd_i[iptr3+1];
-					tscale[3*pcount+2] = sd_i[iptr3+2];
-					pcount += 1;
+					tscale[3*pcount+2] = twist_between(sd_i, taken, endcorner);
+					taken = endcorner;
 					tend = pcount;
 				}
 			}
@@ -1112,14 +1369,14 @@ extrusion::extrude( const view& scene,
 		endcorner = tend;
 	}
 
-	size_t ncontours = pcontours[0];
+	// Distant extrusions are drawn with a simpler cross section.
+	const cross_section& section = profile->sections[make_faces ? 0 : lod_section_level];
+	size_t ncontours = section.pcontours[0];
 	if (ncontours == 0) return;
-	size_t npoints = contours.size()/2; // total number of 2D points in all contours
 
-	// 3 positions and normals per triangle, and the number of triangles = 2 times the number of points in the 2D shape,
-	// times 2 for front and back of each triangle. Allocate space to hold the largest contour:
-	size_t maxtriangles = 12*maxcontour;
-	std::vector<vector> tris(maxtriangles), normals(maxtriangles), tcolors(maxtriangles);
+	// The joints at either end of each segment whose sides are to be made.
+	std::vector<segment> segments;
+	segments.reserve(endcorner-startcorner);
 
 	vector xaxis, yaxis; // local unit-vector axes on the 2D shape
 	vector prevxaxis, prevyaxis; // local unit-vector axes on the 2D shape on preceding segment
@@ -1134,6 +1391,8 @@ extrusion::extrude( const view& scene,
 	double lastalpha; // previous rotation of bisecting_plane_normal
 	// vector extcenter = vector(0,0,0); // the geometric center of the extrusion (apparently not used)
 
+	if (!make_faces) adjust_colors( scene, tcolor, pcount);
+
 	// pos and color iterators
 	v_i = spos;
 	const double* c_i = tcolor;
@@ -1144,7 +1403,6 @@ extrusion::extrude( const view& scene,
 	const vector initial_face_color = vector(c_i[0], c_i[1], c_i[2]);
 	const vector final_face_color = vector(c_i[3*(pcount-1)], c_i[3*(pcount-1)+1], c_i[3*(pcount-1)+2]);
 
-	if (!make_faces) bool mono = adjust_colors( scene, tcolor, pcount);
 	bool closed = false;
 	if (pcount > 2) {
 		double path_length = 0.0;
@@ -1156,7 +1414,7 @@ extrusion::extrude( const view& scene,
 	}
 	bool show_start = show_start_face;
 	bool show_end = show_end_face;
-	if (!shape_closed || (closed && startcorner == 0 && endcorner == pcount-1))
+	if (!profile->closed || (closed && startcorner == 0 && endcorner == pcount-1))
 		show_start = show_end = false;
 
 	bool zerodepth = false; // true if should display just one 2D surface
@@ -1207,21 +1465,20 @@ extrusion::extrude( const view& scene,
 
 	size_t lastpoint = pcount-1;
 
-	if (make_faces) {
-		// Calculate the total number of triangles
-		// contours.size()/2 is number of vertices in the 2D shape
-		// On the sides of the extrusion there are 2 single-sided triangles for every contour vertex
-		size_t triangles = contours.size()*(endcorner-startcorner); // single-sided triangles on the extrusion sides
-		// strips.size()/2 is the number of vertices in triangle strips on an end face, and there are pstrips[0] strips
-		// If there are N vertices in a triangle strip, there are N-2 single-sided triangles, so there are
-		//    strips.size()/2 - 2*pstrips[0] single-sided triangles on an end face
-		size_t endtriangles = strips.size()/2-2*pstrips[0]; // single-sided triangles on the extrusion ends
-		if (show_start_face && (!closed || (startcorner > 0))) triangles += endtriangles;
-		if (show_end_face && (!closed || (endcorner < lastpoint))) triangles += endtriangles;
-		faces_pos.reserve(3*triangles); // 3D vectors
-		faces_normals.reserve(3*triangles); // 3D vectors
-		faces_colors.reserve(3*triangles); // 3D vectors
-	}
+	// Calculate the total number of triangles
+	// contours.size()/2 is number of vertices in the 2D shape
+	// On the sides of the extrusion there are 2 single-sided triangles for every contour vertex
+	size_t triangles = section.contours.size()*(endcorner-startcorner); // single-sided triangles on the extrusion sides
+	// strips.size()/2 is the number of vertices in triangle strips on an end face, and there are pstrips[0] strips
+	// If there are N vertices in a triangle strip, there are N-2 single-sided triangles, so there are
+	//    strips.size()/2 - 2*pstrips[0] single-sided triangles on an end face
+	size_t endtriangles = profile->strips.size()/2-2*profile->pstrips[0]; // single-sided triangles on the extrusion ends
+	if (show_start_face && (!closed || (startcorner > 0))) triangles += endtriangles;
+	if (show_end_face && (!closed || (endcorner < lastpoint))) triangles += endtriangles;
+	if (!make_faces && twosided) triangles *= 2;
+	faces_pos.reserve(3*triangles); // 3D vectors
+	faces_normals.reserve(3*triangles); // 3D vectors
+	faces_colors.reserve(3*triangles); // 3D vectors
 
 	bool delay_initial_face = false; // True if delay rendering of initial face (waiting for normal info)
 
@@ -1376,8 +1633,6 @@ extrusion::extrude( const view& scene,
 		} else {
 			xrot = bisecting_plane_normal.cross(y)/axlecos; // make xrot a non-unit vector, in the plane of the joint, to correct for rotation about axle
 		}
-		xrot *= scene.gcf;
-		y *= scene.gcf;
 
 		// update xaxis and yaxis across the joint
 		if (icorner == 0) { // special handling due to initial setup of point 0
@@ -1444,7 +1699,7 @@ extrusion::extrude( const view& scene,
 				vector lastnormal = -bisecting_plane_normal;
 				if (!closed && (corner == lastpoint) && prevsmoothed) {
 					lastnormal = lastnormal.rotate(lastalpha, y);
-					xrot = xrot.rotate(lastalpha,y).norm()*scene.gcf;
+					xrot = xrot.rotate(lastalpha,y).norm();
 				}
 				// Use pstrips to paint both sides of the last surface
 				vector icolor = current_color;
@@ -1454,111 +1709,34 @@ extrusion::extrude( const view& scene,
 			}
 
 			if (corner > startcorner && corner <= endcorner) {
-
-				if (!make_faces) {
-					glVertexPointer(3, GL_DOUBLE, 0, &tris[0]);
-					glNormalPointer( GL_DOUBLE, 0, &normals[0]);
-					glColorPointer(3, GL_DOUBLE, 0, &tcolors[0]);
-				}
-
-				//vector color_old = prev_color; // color at previous location along the curve
-				//vector color_new = current_color; // color at current location along the curve
-				double v0x, v0y, v1x, v1y, prevv0x, prevv0y, prevv1x, prevv1y;
-				// The following nested for loops is (necessarily) the same as that used to build the normals2D array.
-				for (size_t c=0, nbase=0; c < ncontours; c++) {
-					size_t nd = 2*pcontours[2*c+2]; // number of doubles in this contour
-					size_t base = 2*pcontours[2*c+3]; // initial (x,y) = (contour[base], contour[base+1])
-					size_t b0, b1, b2, b3;
-					// Triangle order is
-					//    previous v0, current v1, current v0, previous v1, current v1, previous v0.
-					// Render front and back of each triangle.
-					for (size_t pt=0, i=0; pt<nd; pt+=2, i+=6, nbase+=4) {
-						if (pt == nd-2 && !shape_closed) break;
-						// Use modulo arithmetic here because last point is the first point, going around the sides of the extrusion
-						b0 = base+pt;
-						b1 = b0+1;
-						b2 = base+((pt+2)%nd);
-						b3 = base+((pt+3)%nd);
-						prevv0x = prevc11*contours[b0] + prevc12*contours[b1];
-						prevv0y = prevc21*contours[b0] + prevc22*contours[b1];
-						prevv1x = prevc11*contours[b2] + prevc12*contours[b3];
-						prevv1y = prevc21*contours[b2] + prevc22*contours[b3];
-						v0x =     c11*contours[b0]     + c12*contours[b1];
-						v0y =     c21*contours[b0]     + c22*contours[b1];
-						v1x =     c11*contours[b2]     + c12*contours[b3];
-						v1y =     c21*contours[b2]     + c22*contours[b3];
-
-						tris[i  ] = prev    + prevxrot*prevv0x + prevy*prevv0y;
-						tris[i+1] = prev    + prevxrot*prevv1x + prevy*prevv1y;
-						tris[i+2] = current +     xrot*v0x     + y*v0y;
-						tris[i+3] = tris[i+1];
-						tris[i+4] = current +     xrot*v1x     + y*v1y;
-						tris[i+5] = tris[i+2];
-
-						tcolors[i  ] = prev_color;
-						tcolors[i+1] = prev_color;
-						tcolors[i+2] = current_color;
-						tcolors[i+3] = tcolors[i+1];
-						tcolors[i+4] = current_color;
-						tcolors[i+5] = tcolors[i+2];
-
-						normals[i  ] = smoothing(     s_i[1]*xaxis*normals2D[nbase  ] +      s_i[0]*yaxis*normals2D[nbase+1],
-												 s_i[-2]*prevxaxis*normals2D[nbase  ] + s_i[-3]*prevyaxis*normals2D[nbase+1]);
-
-						normals[i+1] = smoothing(     s_i[1]*xaxis*normals2D[nbase+2] +      s_i[0]*yaxis*normals2D[nbase+3],
-												 s_i[-2]*prevxaxis*normals2D[nbase+2] + s_i[-3]*prevyaxis*normals2D[nbase+3]);
-
-						normals[i+2] = smoothing(     s_i[1]*xaxis*normals2D[nbase  ] +      s_i[0]*yaxis*normals2D[nbase+1],
-												 s_i[-2]*nextxaxis*normals2D[nbase  ] + s_i[-3]*nextyaxis*normals2D[nbase+1]);
-
-						normals[i+3] = normals[i+1]; // i+1 and i+3 are the same location
-
-						normals[i+4] = smoothing(     s_i[1]*xaxis*normals2D[nbase+2] +      s_i[0]*yaxis*normals2D[nbase+3],
-												 s_i[-2]*nextxaxis*normals2D[nbase+2] + s_i[-3]*nextyaxis*normals2D[nbase+3]);
-
-						normals[i+5] = normals[i+2]; // i+2 and i+5 are the same location
-
-						if (!make_faces && twosided) {
-							// vertices, normals, and colors for other side
-							tris[3*nd+i+1] = tris[i  ];
-							tris[3*nd+i  ] = tris[i+1];
-							tris[3*nd+i+2] = tris[i+2];
-							tris[3*nd+i+3] = tris[i+3];
-							tris[3*nd+i+5] = tris[i+4];
-							tris[3*nd+i+4] = tris[i+5];
-
-							normals[3*nd+i+1] = -normals[i  ];
-							normals[3*nd+i  ] = -normals[i+1];
-							normals[3*nd+i+2] = -normals[i+2];
-							normals[3*nd+i+3] = -normals[i+3];
-							normals[3*nd+i+5] = -normals[i+4];
-							normals[3*nd+i+4] = -normals[i+5];
-
-							tcolors[3*nd+i+1] = tcolors[i  ];
-							tcolors[3*nd+i  ] = tcolors[i+1];
-							tcolors[3*nd+i+2] = tcolors[i+2];
-							tcolors[3*nd+i+3] = tcolors[i+3];
-							tcolors[3*nd+i+5] = tcolors[i+4];
-							tcolors[3*nd+i+4] = tcolors[i+5];
-						}
-
-						if (make_faces) {
-							faces_pos.insert(faces_pos.end(), tris.begin()+i, tris.begin()+i+6);
-							faces_normals.insert(faces_normals.end(), normals.begin()+i, normals.begin()+i+6);
-							faces_colors.insert(faces_colors.end(), tcolors.begin()+i, tcolors.begin()+i+6);
-						}
-					}
-
-					if (!make_faces) {
-						// nd doubles, nd/2 vertices, 2 triangles per vertex,
-						//    3 points per triangle, 2 sides, so 6*nd vertices per extrusion segment
-						if (twosided) {
-							glDrawArrays(GL_TRIANGLES, 0, 6*nd);
-						} else {
-							glDrawArrays(GL_TRIANGLES, 0, 3*nd);
-						}
-					}
-				}
+				segments.push_back(segment());
+				segment& seg = segments.back();
+				seg.prev = prev;
+				seg.prevxrot = prevxrot;
+				seg.prevy = prevy;
+				seg.prevc11 = prevc11;
+				seg.prevc12 = prevc12;
+				seg.prevc21 = prevc21;
+				seg.prevc22 = prevc22;
+				seg.prevxaxis = prevxaxis;
+				seg.prevyaxis = prevyaxis;
+				seg.prev_color = prev_color;
+				seg.prevscalex = s_i[-3];
+				seg.prevscaley = s_i[-2];
+				seg.current = current;
+				seg.xrot = xrot;
+				seg.y = y;
+				seg.c11 = c11;
+				seg.c12 = c12;
+				seg.c21 = c21;
+				seg.c22 = c22;
+				seg.xaxis = xaxis;
+				seg.yaxis = yaxis;
+				seg.nextxaxis = nextxaxis;
+				seg.nextyaxis = nextyaxis;
+				seg.current_color = current_color;
+				seg.scalex = s_i[0];
+				seg.scaley = s_i[1];
 			}
 		}
 		prevx = x;
@@ -1578,15 +1756,135 @@ extrusion::extrude( const view& scene,
 		prev_color = vector(c_i[0], c_i[1], c_i[2]);
 		prevsmoothed = smoothed;
 	}
+
+	// With the joints known, the sides of each segment can be made independently,
+	// so they are made in parallel, each straight into its place in the output.
+	const size_t corners = side_corners(section, make_faces);
+	if (segments.empty() || !corners)
+		return;
+	const size_t first = faces_pos.size();
+	faces_pos.resize(first + corners*segments.size());
+	faces_normals.resize(faces_pos.size());
+	faces_colors.resize(faces_pos.size());
+	parallel_for(segments.size(), 1 + 16384/corners,
+		boost::bind(&extrusion::extrude_sides, this, boost::cref(section), &segments[0], make_faces,
+			&faces_pos[first], &faces_normals[first], &faces_colors[first], _1, _2));
+}
+
+size_t
+extrusion::side_corners(const cross_section& section, bool make_faces) const
+{
+	const std::vector<npy_int32>& pcontours = section.pcontours;
+	// 2 triangles for each edge of each contour, and their backs when drawing
+	// a two-sided extrusion.
+	size_t edges = 0;
+	for (size_t c=0; c < (size_t)pcontours[0]; c++) {
+		size_t n = pcontours[2*c+2]; // number of points in this contour
+		edges += (profile->closed || !n) ? n : n-1;
+	}
+	return edges * 6 * ((!make_faces && twosided) ? 2 : 1);
+}
+
+void
+extrusion::extrude_sides(const cross_section& section, const segment* segments, bool make_faces,
+		vector* faces_pos, vector* faces_normals, vector* faces_colors,
+		size_t begin, size_t end) const
+{
+	const std::vector<npy_float64>& contours = section.contours;
+	const std::vector<npy_int32>& pcontours = section.pcontours;
+	const std::vector<double>& normals2D = section.normals2D;
+	const size_t corners = side_corners(section, make_faces);
+	const bool back = !make_faces && twosided;
+	size_t ncontours = pcontours[0];
+	vector tris[6], normals[6], tcolors[6];
+
+	for (size_t k = begin; k < end; ++k) {
+		const segment& seg = segments[k];
+		size_t out = k*corners;
+
+		double v0x, v0y, v1x, v1y, prevv0x, prevv0y, prevv1x, prevv1y;
+		// The following nested for loops is (necessarily) the same as that used to build the normals2D array.
+		for (size_t c=0, nbase=0; c < ncontours; c++) {
+			size_t nd = 2*pcontours[2*c+2]; // number of doubles in this contour
+			size_t base = 2*pcontours[2*c+3]; // initial (x,y) = (contour[base], contour[base+1])
+			size_t b0, b1, b2, b3;
+			// Triangle order is
+			//    previous v0, current v1, current v0, previous v1, current v1, previous v0.
+			// When drawing a two-sided extrusion, make the back of each triangle too.
+			for (size_t pt=0; pt<nd; pt+=2, nbase+=4) {
+				if (pt == nd-2 && !profile->closed) break;
+				// Use modulo arithmetic here because last point is the first point, going around the sides of the extrusion
+				b0 = base+pt;
+				b1 = b0+1;
+				b2 = base+((pt+2)%nd);
+				b3 = base+((pt+3)%nd);
+				prevv0x = seg.prevc11*contours[b0] + seg.prevc12*contours[b1];
+				prevv0y = seg.prevc21*contours[b0] + seg.prevc22*contours[b1];
+				prevv1x = seg.prevc11*contours[b2] + seg.prevc12*contours[b3];
+				prevv1y = seg.prevc21*contours[b2] + seg.prevc22*contours[b3];
+				v0x =     seg.c11*contours[b0]     + seg.c12*contours[b1];
+				v0y =     seg.c21*contours[b0]     + seg.c22*contours[b1];
+				v1x =     seg.c11*contours[b2]     + seg.c12*contours[b3];
+				v1y =     seg.c21*contours[b2]     + seg.c22*contours[b3];
+
+				tris[0] = seg.prev    + seg.prevxrot*prevv0x + seg.prevy*prevv0y;
+				tris[1] = seg.prev    + seg.prevxrot*prevv1x + seg.prevy*prevv1y;
+				tris[2] = seg.current +     seg.xrot*v0x     + seg.y*v0y;
+				tris[3] = tris[1];
+				tris[4] = seg.current +     seg.xrot*v1x     + seg.y*v1y;
+				tris[5] = tris[2];
+
+				tcolors[0] = seg.prev_color;
+				tcolors[1] = seg.prev_color;
+				tcolors[2] = seg.current_color;
+				tcolors[3] = tcolors[1];
+				tcolors[4] = seg.current_color;
+				tcolors[5] = tcolors[2];
+
+				normals[0] = smoothing(     seg.scaley*seg.xaxis*normals2D[nbase  ] +          seg.scalex*seg.yaxis*normals2D[nbase+1],
+										 seg.prevscaley*seg.prevxaxis*normals2D[nbase  ] + seg.prevscalex*seg.prevyaxis*normals2D[nbase+1]);
+
+				normals[1] = smoothing(     seg.scaley*seg.xaxis*normals2D[nbase+2] +          seg.scalex*seg.yaxis*normals2D[nbase+3],
+										 seg.prevscaley*seg.prevxaxis*normals2D[nbase+2] + seg.prevscalex*seg.prevyaxis*normals2D[nbase+3]);
+
+				normals[2] = smoothing(     seg.scaley*seg.xaxis*normals2D[nbase  ] +          seg.scalex*seg.yaxis*normals2D[nbase+1],
+										 seg.prevscaley*seg.nextxaxis*normals2D[nbase  ] + seg.prevscalex*seg.nextyaxis*normals2D[nbase+1]);
+
+				normals[3] = normals[1]; // 1 and 3 are the same location
+
+				normals[4] = smoothing(     seg.scaley*seg.xaxis*normals2D[nbase+2] +          seg.scalex*seg.yaxis*normals2D[nbase+3],
+										 seg.prevscaley*seg.nextxaxis*normals2D[nbase+2] + seg.prevscalex*seg.nextyaxis*normals2D[nbase+3]);
+
+				normals[5] = normals[2]; // 2 and 5 are the same location
+
+				for (size_t i=0; i<6; i++, out++) {
+					faces_pos[out] = tris[i];
+					faces_normals[out] = normals[i];
+					faces_colors[out] = tcolors[i];
+				}
+
+				if (back) {
+					// vertices, normals, and colors for other side
+					static const int swap[6] = { 1, 0, 2, 3, 5, 4 };
+					for (size_t i=0; i<6; i++, out++) {
+						faces_pos[out] = tris[swap[i]];
+						faces_normals[out] = -normals[swap[i]];
+						faces_colors[out] = tcolors[swap[i]];
+					}
+				}
+			}
+		}
+	}
 }
 
 void
 extrusion::outer_render( const view& v ) {
+	update_mesh(v); // the material matrix depends on mesh_origin
 	arrayprim::outer_render(v);
 }
 
 void
-extrusion::get_material_matrix( const view& v, tmatrix& out ) {
+extrusion::get_material_matrix( const view&, tmatrix& out ) {
 	//if (degenerate()) return;
 
 	// TODO: note this code is identical to faces::get_material_matrix, except for considering radius
@@ -1607,8 +1905,9 @@ extrusion::get_material_matrix( const view& v, tmatrix& out ) {
 	//max_extent += vector(radius,radius,radius);
 
 	out.translate( vector(.5,.5,.5) );
-	out.scale( vector(1,1,1) * (.999 / (v.gcf * std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z)))) );
-	out.translate( -.5 * v.gcf * (min_extent + max_extent) );
+	out.scale( vector(1,1,1) * (.999 / std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z))) );
+	out.translate( -.5 * (min_extent + max_extent) );
+	out.translate( mesh_origin ); // the mesh is drawn relative to mesh_origin
 }
 
 } } // !namespace cvisual::python
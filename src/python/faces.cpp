@@ -5,12 +5,17 @@
 #include "python/faces.hpp"
 #include <boost/python/tuple.hpp>
 
-#include <map>
-#include <set>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstring>
+#include <boost/cstdint.hpp>
 #include "wrap_gl.hpp"
 
 #include "python/slice.hpp"
 #include "util/gl_enable.hpp"
+#include "util/parallel.hpp"
+#include "material.hpp"
 
 using boost::python::numeric::array;
 
@@ -19,10 +24,12 @@ namespace cvisual { namespace python {
 bool
 faces::degenerate() const
 {
-	return count < 3;
+	return indexed() ? count == 0 : count < 3;
 }
 
 faces::faces()
+	: index_max(0), twosided(false), flat_made(false), smooth_made(false),
+	depth_sort(false), centroids_made(false)
 {
 	double* k = normal.data();
 	k[0] = k[1] = k[2] = 0.0;
@@ -73,103 +80,413 @@ faces::append( const vector& nv_pos)
 	n[2] = 0.;
 }
 
-// Define an ordering for the stl-sorting criteria.
-struct stl_cmp_vector
-{
-	//AS added "const" to allow template match for VC++ build
- 	bool operator()( const vector& lhs, const vector& rhs) const	{
-		if (lhs.x < rhs.x)
-			return true;
-		else if (lhs.x > rhs.x)
-			return false;
-		else
-			if (lhs.y < rhs.y)
-				return true;
-			else if (lhs.y > rhs.y)
-				return false;
-			else
-				if (lhs.z < rhs.z)
-					return true;
-				else
-					return false;
+void
+faces::append_array( const double_array& n_pos, const double_array& n_normal, const double_array& n_color)
+{
+	const size_t n = point_rows( n_pos, "pos");
+	if ((point_rows( n_normal, "normal") != n && shape( n_normal).size() != 1)
+		|| (point_rows( n_color, "color") != n && shape( n_color).size() != 1))
+		throw std::invalid_argument( "normal and color must have a row for each vertex");
+	size_t skip;
+	const size_t first = append_rows( n, -1, skip);
+	copy_rows( pos, first, n_pos, skip, n);
+	copy_rows( normal, first, n_normal, skip, n);
+	copy_rows( color, first, n_color, skip, n);
+}
+
+void
+faces::append_array( const double_array& n_pos, const double_array& n_normal)
+{
+	const size_t n = point_rows( n_pos, "pos");
+	if (point_rows( n_normal, "normal") != n && shape( n_normal).size() != 1)
+		throw std::invalid_argument( "normal must have a row for each vertex");
+	size_t skip;
+	const size_t first = append_rows( n, -1, skip);
+	copy_rows( pos, first, n_pos, skip, n);
+	copy_rows( normal, first, n_normal, skip, n);
+}
+
+void
+faces::append_array( const double_array& n_pos)
+{
+	const size_t n = point_rows( n_pos, "pos");
+	size_t skip;
+	const size_t first = append_rows( n, -1, skip);
+	copy_rows( pos, first, n_pos, skip, n);
+	std::fill( normal.data( first), normal.end(), 0.0);
+}
+
+namespace {
+
+// Flat normals for the triangles of a triangle soup, three copies each.
+// Written as plain arithmetic on doubles, so that compilers can vectorize it.
+struct flat_normals
+{
+	const double* pos;
+	double* normal;
+
+	void operator()( size_t begin, size_t end) const
+	{
+		for (size_t t = begin; t < end; ++t) {
+			const double* p = pos + 9*t;
+			const double ax = p[3] - p[0], ay = p[4] - p[1], az = p[5] - p[2];
+			const double bx = p[6] - p[3], by = p[7] - p[4], bz = p[8] - p[5];
+			double nx = ay*bz - az*by;
+			double ny = az*bx - ax*bz;
+			double nz = ax*by - ay*bx;
+			const double mag2 = nx*nx + ny*ny + nz*nz;
+			const double scale = mag2 > 0.0 ? 1.0 / std::sqrt( mag2) : 0.0;
+			nx *= scale;
+			ny *= scale;
+			nz *= scale;
+			double* n = normal + 9*t;
+			n[0] = n[3] = n[6] = nx;
+			n[1] = n[4] = n[7] = ny;
+			n[2] = n[5] = n[8] = nz;
+		}
+	}
+};
+
+// The normal of a triangle, with a length of twice its area.
+inline vector
+area_normal( const double* a, const double* b, const double* c)
+{
+	return (vector(b) - vector(a)).cross( vector(c) - vector(a));
+}
+
+struct indexed_area_normals
+{
+	const double* pos;
+	const unsigned int* index;
+	vector* out;
+
+	void operator()( size_t begin, size_t end) const
+	{
+		for (size_t t = begin; t < end; ++t)
+			out[t] = area_normal( pos + 3*index[3*t], pos + 3*index[3*t+1], pos + 3*index[3*t+2]);
 	}
 };
 
+inline boost::uint64_t
+mix( boost::uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+struct position_hashes
+{
+	const double* pos;
+	boost::uint64_t* out;
+
+	void operator()( size_t begin, size_t end) const
+	{
+		for (size_t i = begin; i < end; ++i) {
+			boost::uint64_t h = 0;
+			for (int k = 0; k < 3; ++k) {
+				// Adding zero makes -0 the same as 0, as they compare.
+				const double x = pos[3*i+k] + 0.0;
+				boost::uint64_t bits;
+				std::memcpy( &bits, &x, sizeof bits);
+				h = mix( h ^ bits);
+			}
+			out[i] = h;
+		}
+	}
+};
+
+// Set group[i] to the first of the n vertexes at pos that has the position
+// of vertex i, using a hash table, and set members to the vertexes of each
+// group, in order: those of the group starting at vertex v are from
+// members[start[v]] to members[start[v+1]].
 void
-faces::make_normals()
+weld_vertexes( const double* pos, size_t n, std::vector<unsigned int>& group,
+	std::vector<unsigned int>& start, std::vector<unsigned int>& members)
 {
-	if (shape(pos) != shape(normal))
-		throw std::invalid_argument( "Dimension mismatch between pos and normal.");
+	std::vector<boost::uint64_t> hashes( n);
+	position_hashes hasher = { pos, n ? &hashes[0] : 0 };
+	parallel_for( n, 65536, hasher);
+
+	size_t size = 16;
+	while (size < 2*n)
+		size *= 2;
+	std::vector<unsigned int> table( size, 0);  // vertex numbers + 1
+	group.resize( n);
+	for (size_t i = 0; i < n; ++i) {
+		size_t slot = hashes[i] & (size - 1);
+		for (;; slot = (slot + 1) & (size - 1)) {
+			const unsigned int j = table[slot];
+			if (!j) {
+				table[slot] = i + 1;
+				group[i] = i;
+				break;
+			}
+			if (hashes[j-1] == hashes[i] && pos[3*(j-1)] == pos[3*i]
+				&& pos[3*(j-1)+1] == pos[3*i+1] && pos[3*(j-1)+2] == pos[3*i+2]) {
+				group[i] = j - 1;
+				break;
+			}
+		}
+	}
 
-	// Create normals that are perpendicular to all faces
-	if (count == 0) return;
-	using boost::python::make_tuple;
-	normal[slice(0, count)] = make_tuple( 0, 0, 0);
-	double* norm_i = normal.data();
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.end();
-	int i = 0;
-	for ( ; pos_i < pos_end; pos_i+=9, norm_i+=9, i+=9) {
-		if ((pos_i+9) > pos_end) break;
-		vector v1 = vector(pos_i+3)-vector(pos_i);
-		vector v2 = vector(pos_i+6)-vector(pos_i+3);
-		vector n = v1.cross(v2).norm();
-		double nx = n.get_x();
-		double ny = n.get_y();
-		double nz = n.get_z();
-		norm_i[0] = norm_i[3] = norm_i[6] = nx;
-		norm_i[1] = norm_i[4] = norm_i[7] = ny;
-		norm_i[2] = norm_i[5] = norm_i[8] = nz;
+	start.assign( n + 1, 0);
+	for (size_t i = 0; i < n; ++i)
+		++start[group[i] + 1];
+	for (size_t i = 0; i < n; ++i)
+		start[i+1] += start[i];
+	members.resize( n);
+	std::vector<unsigned int> next( start.begin(), start.end() - 1);
+	for (size_t i = 0; i < n; ++i)
+		members[next[group[i]]++] = i;
+}
+
+// Averages the normals of coincident vertexes, as faces::smooth_d() describes,
+// for the groups of vertexes starting at groups[begin] to groups[end].
+struct average_normals
+{
+	const unsigned int* groups;
+	const unsigned int* start;
+	const unsigned int* members;
+	double* normal;
+	double cosangle;
+
+	void operator()( size_t begin, size_t end) const
+	{
+		std::vector<vector> unit;
+		std::vector<char> done;
+		for (size_t g = begin; g < end; ++g) {
+			const unsigned int* m = members + start[groups[g]];
+			const size_t n = start[groups[g] + 1] - start[groups[g]];
+			unit.resize( n);
+			done.assign( n, 0);
+			for (size_t i = 0; i < n; ++i)
+				unit[i] = vector( normal + 3*m[i]).norm();
+			for (size_t seed = 0; seed < n; ++seed) {
+				// Vertexes without a normal are left alone.
+				if (done[seed] || !unit[seed])
+					continue;
+				vector average;
+				for (size_t i = seed; i < n; ++i)
+					if (!done[i] && unit[i].dot( unit[seed]) >= cosangle)
+						average += unit[i];
+				average = average.norm();
+				for (size_t i = seed; i < n; ++i) {
+					if (!done[i] && unit[i].dot( unit[seed]) >= cosangle) {
+						done[i] = 1;
+						double* norm_i = normal + 3*m[i];
+						norm_i[0] = average.x;
+						norm_i[1] = average.y;
+						norm_i[2] = average.z;
+					}
+				}
+			}
+		}
+	}
+};
+
+// Area weighted normals for the corners of a triangle soup, for the groups
+// of coincident corners starting at groups[begin] to groups[end].  Within a
+// group, corners are split between normals as faces::smooth_normals() does
+// for the triangles at a shared vertex.
+struct crease_normals
+{
+	const unsigned int* groups;
+	const unsigned int* start;
+	const unsigned int* members;
+	const double* pos;
+	double* normal;
+	double min_cos;
+
+	void operator()( size_t begin, size_t end) const
+	{
+		std::vector<vector> area, unit;
+		std::vector<char> done;
+		for (size_t g = begin; g < end; ++g) {
+			const unsigned int* m = members + start[groups[g]];
+			const size_t n = start[groups[g] + 1] - start[groups[g]];
+			area.resize( n);
+			unit.resize( n);
+			done.assign( n, 0);
+			for (size_t i = 0; i < n; ++i) {
+				const double* p = pos + 9*(m[i] / 3);
+				area[i] = area_normal( p, p + 3, p + 6);
+				unit[i] = area[i].norm();
+			}
+			vector first;
+			bool any = false;
+			for (size_t seed = 0; seed < n; ++seed) {
+				if (done[seed] || !unit[seed])
+					continue;
+				vector sum;
+				for (size_t i = seed; i < n; ++i)
+					if (!done[i] && unit[i].dot( unit[seed]) >= min_cos)
+						sum += area[i];
+				sum = sum.norm();
+				if (!any)
+					first = sum;
+				any = true;
+				for (size_t i = seed; i < n; ++i) {
+					if (!done[i] && unit[i].dot( unit[seed]) >= min_cos) {
+						done[i] = 1;
+						double* norm_i = normal + 3*m[i];
+						norm_i[0] = sum.x;
+						norm_i[1] = sum.y;
+						norm_i[2] = sum.z;
+					}
+				}
+			}
+			// Corners of triangles with no area take the first normal.
+			for (size_t i = 0; i < n; ++i) {
+				if (!done[i]) {
+					double* norm_i = normal + 3*m[i];
+					norm_i[0] = first.x;
+					norm_i[1] = first.y;
+					norm_i[2] = first.z;
+				}
+			}
+		}
 	}
+};
+
+// The centroids of triangles [first + begin, first + end), from an index
+// or, if that is null, a triangle soup.
+struct triangle_centroids
+{
+	const double* pos;
+	const unsigned int* index;
+	float* out;
+	size_t first;
+
+	void operator()( size_t begin, size_t end) const
+	{
+		for (size_t t = first + begin; t < first + end; ++t) {
+			const double* a = index ? pos + 3*index[3*t] : pos + 9*t;
+			const double* b = index ? pos + 3*index[3*t+1] : a + 3;
+			const double* c = index ? pos + 3*index[3*t+2] : a + 6;
+			for (int k = 0; k < 3; ++k)
+				out[3*t+k] = float( (a[k] + b[k] + c[k]) * (1.0/3.0));
+		}
+	}
+};
+
+// A key that sorts the farthest depth first.
+inline boost::uint32_t
+far_first_key( float depth)
+{
+	boost::uint32_t bits;
+	std::memcpy( &bits, &depth, sizeof bits);
+	// Flipping the sign bit of positive numbers, and all bits of negative
+	// ones, orders the bits as the numbers.
+	bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	return ~bits;
 }
 
+// Sort values by their high 32 bits, with a least significant digit radix
+// sort, 11 bits at a time.
 void
-faces::make_twosided()
+radix_sort( std::vector<boost::uint64_t>& values)
+{
+	std::vector<boost::uint64_t> swap( values.size());
+	for (int shift = 32; shift < 64; shift += 11) {
+		size_t counts[2049] = { 0 };
+		for (size_t i = 0; i < values.size(); ++i)
+			++counts[((values[i] >> shift) & 2047) + 1];
+		for (int d = 0; d < 2048; ++d)
+			counts[d+1] += counts[d];
+		for (size_t i = 0; i < values.size(); ++i)
+			swap[counts[(values[i] >> shift) & 2047]++] = values[i];
+		values.swap( swap);
+	}
+}
+
+// The order of translucent triangles is kept until the view turns by more
+// than about half a degree.
+const double resort_cos = 0.99996;
+
+// The least cosine between the normals of triangles that are smoothed
+// together, for a crease angle in radians.
+inline double
+crease_cos( double crease_angle)
+{
+	return std::cos( std::min( std::max( crease_angle, 0.0), M_PI)) - 1e-9;
+}
+
+} // !namespace (anonymous)
+
+void
+faces::make_normals()
 {
 	if (shape(pos) != shape(normal))
 		throw std::invalid_argument( "Dimension mismatch between pos and normal.");
-	if (shape(pos) != shape(color))
-		throw std::invalid_argument( "Dimension mismatch between pos and color.");
-
-	// Duplicate existing faces with opposite windings and normals
-	if (count < 3) return;
-	double* pos_i = pos.data();
-	double* norm_i = normal.data();
-	double* color_i = color.data();
-	// Make sure that there are 3 vertices per triangle
-	if ((count % 3) == 1) {
-		append(vector(pos_i+3*(count-1)), vector(norm_i+3*(count-1)), rgb(color_i+3*(count-1)));
-		// Array may have moved: reestablish the pointers
-		pos_i = pos.data();
-		norm_i = normal.data();
-		color_i = color.data();
-	}
-	if ((count % 3) == 2) {
-		append(vector(pos_i+3*(count-1)), vector(norm_i+3*(count-1)), rgb(color_i+3*(count-1)));
-		// Array may have moved: reestablish the pointers
-		pos_i = pos.data();
-		norm_i = normal.data();
-		color_i = color.data();
+
+	// Shared vertexes are split between triangles that aren't coplanar.
+	if (indexed()) {
+		smooth_normals( 0.0);
+		return;
 	}
-	int icount = 3*count;
-	for (int i=0; i<icount; i+=3) {
-		append(vector(pos_i+i), vector(norm_i+i), rgb(color_i+i));
-		// Array may have moved: reestablish the pointers
-		pos_i = pos.data();
-		norm_i = normal.data();
-		color_i = color.data();
+
+	// Create normals that are perpendicular to all faces, for the triangles
+	// that have changed since the last call.
+	size_t begin, end;
+	if (!normals_stale( flat_made, flat_pos_version, flat_normal_version, begin, end))
+		return;
+	const size_t corners = count - count%3;
+	if (begin < std::min( end, corners)) {
+		flat_normals kernel = { pos.data( begin), normal.data( begin) };
+		parallel_for( (std::min( end, corners) - begin) / 3, 16384, kernel);
 	}
-	for (int i=0; i<icount; i+=9) {
-		for (int n=0; n<3; n++) {
-			pos_i[icount+i+3+n] = pos_i[i+6+n];
-			pos_i[icount+i+6+n] = pos_i[i+3+n];
-			norm_i[icount+i+n] = -norm_i[i+n];
-			norm_i[icount+i+3+n] = -norm_i[i+6+n];
-			norm_i[icount+i+6+n] = -norm_i[i+3+n];
-			color_i[icount+i+3+n] = color_i[i+6+n];
-			color_i[icount+i+6+n] = color_i[i+3+n];
-		}
+	// The points of an incomplete last triangle have no normal.
+	if (end > corners)
+		std::fill( normal.data( corners), normal.end(), 0.0);
+	if (begin < end)
+		normal.modified( begin, end);
+	flat_pos_version = pos.get_version();
+	flat_normal_version = normal.get_version();
+	flat_made = true;
+}
+
+bool
+faces::normals_stale( bool made, const array_version& pos_since, const array_version& normal_since,
+	size_t& begin, size_t& end)
+{
+	// Called from Python, which may have written through views of the arrays
+	// since they were last checked.
+	pos.check_views();
+	normal.check_views();
+	const array_version normal_version = normal.get_version();
+	if (!made || normal_version != normal_since) {
+		begin = 0;
+		end = count;
+		return true;
 	}
+	if (!pos.changed_since( pos_since, begin, end))
+		return false;
+	begin -= begin % 3;
+	end = std::min( end + (3 - end%3) % 3, count);
+	return true;
+}
+
+void
+faces::make_twosided()
+{
+	// Back faces are lit with reversed normals when drawn, rather than
+	// being added as a second set of triangles.
+	twosided = true;
+}
+
+void
+faces::set_twosided( bool n_twosided)
+{
+	twosided = n_twosided;
+}
+
+void
+faces::set_depth_sort( bool n_depth_sort)
+{
+	depth_sort = n_depth_sort;
+	sorted.clear();
 }
 
 void
@@ -184,64 +501,216 @@ faces::smooth_d(const float cosangle)
 	if (shape(pos) != shape(normal))
 		throw std::invalid_argument( "Dimension mismatch between pos and normal.");
 
-	// positions -> normals
-	typedef std::map< const vector, std::set<int>, stl_cmp_vector> vmap;
-	vmap vertices;
+	if (count == 0)
+		return;
 
-	// First, map into sets all indices for the same vertex
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.end();
-	int i = 0;
-	for ( ; pos_i < pos_end; pos_i+=3, i+=3) {
-		vertices[vector(pos_i)].insert(i);
+	// Group the vertexes by position, then average the similar normals
+	// within each group, many groups at a time.
+	std::vector<unsigned int> group, start, members;
+	weld_vertexes( pos.data(), count, group, start, members);
+	std::vector<unsigned int> firsts;
+	for (size_t i = 0; i < count; ++i)
+		if (group[i] == i)
+			firsts.push_back( i);
+	average_normals averager = { &firsts[0], &start[0], &members[0], normal.data(), cosangle };
+	parallel_for( firsts.size(), 4096, averager);
+	normal.modified( 0, count);
+}
+
+void
+faces::smooth_soup( double crease_angle)
+{
+	const size_t corners = count - count%3;
+	size_t begin, end;
+	if (!normals_stale( smooth_made && smooth_crease == crease_angle,
+			smooth_pos_version, smooth_normal_version, begin, end))
+		return;
+	end = std::min( end, corners);
+	begin = std::min( begin, end);
+
+	std::vector<unsigned int> old_weld;
+	old_weld.swap( weld);
+	std::vector<unsigned int> start, members;
+	weld_vertexes( pos.data(), corners, weld, start, members);
+
+	// Remake the groups of coincident corners that hold a changed corner,
+	// or held one before it moved.
+	std::vector<unsigned int> groups;
+	if (old_weld.size() != corners || (begin == 0 && end == corners)) {
+		for (size_t i = 0; i < corners; ++i)
+			if (weld[i] == i)
+				groups.push_back( i);
+		begin = 0;
+		end = corners;
+	}
+	else {
+		std::vector<char> hit( corners, 0), old_hit( corners, 0);
+		for (size_t i = begin; i < end; ++i) {
+			hit[weld[i]] = 1;
+			old_hit[old_weld[i]] = 1;
+		}
+		for (size_t i = 0; i < corners; ++i)
+			if (old_hit[old_weld[i]])
+				hit[weld[i]] = 1;
+		for (size_t i = 0; i < corners; ++i) {
+			if (hit[i] && weld[i] == i) {
+				groups.push_back( i);
+				begin = std::min( begin, i);
+				end = std::max( end, (size_t)members[start[i+1] - 1] + 1);
+			}
+		}
 	}
 
-	// Next, in a set of vertices, find those with similar normals
-	// and average those normals, then find another group of similar normals
-	// in that set and average those; continue until set is exhausted.
-	double* norm_i = normal.data();
-	vmap::iterator iter = vertices.begin();
-	const vmap::iterator iterend = vertices.end();
-	for ( ; iter != iterend; iter++) {
-		while (! (iter->second).empty()) {
-			std::list<int> similar;
-			std::set<int>::iterator setiter = (iter->second).begin();
-			const std::set<int>::iterator setiterend = (iter->second).end();
-			int pt = *setiter;
-			vector thisnorm = vector(norm_i+pt).norm();
-			if (thisnorm == vector(0,0,0) ) {
-				// Choose a different seed
-				(iter->second).erase(*setiter);
+	if (!groups.empty()) {
+		crease_normals smoother = { &groups[0], &start[0], &members[0],
+			pos.data(), normal.data(), crease_cos( crease_angle) };
+		parallel_for( groups.size(), 1024, smoother);
+		normal.modified( begin, end);
+	}
+	smooth_pos_version = pos.get_version();
+	smooth_normal_version = normal.get_version();
+	smooth_crease = crease_angle;
+	smooth_made = true;
+}
+
+void
+faces::smooth_normals( double crease_angle)
+{
+	if (!indexed()) {
+		smooth_soup( crease_angle);
+		return;
+	}
+	if (index_max >= count)
+		throw std::out_of_range( "index refers to a vertex beyond the end of pos.");
+
+	// The normal of each triangle, with a length of twice its area.
+	const size_t triangles = index.size() / 3;
+	std::vector<vector> area( triangles);
+	std::vector<vector> unit_normal( triangles);
+	indexed_area_normals kernel = { pos.data(), &index[0], &area[0] };
+	parallel_for( triangles, 16384, kernel);
+	for (size_t t = 0; t < triangles; ++t)
+		unit_normal[t] = area[t].norm();
+
+	// The corners (positions in index) at each vertex, which are
+	// corners[first[v]] to corners[first[v+1]].
+	std::vector<size_t> first( count + 1, 0);
+	for (size_t i = 0; i < index.size(); ++i)
+		++first[index[i] + 1];
+	for (size_t v = 0; v < count; ++v)
+		first[v+1] += first[v];
+	std::vector<size_t> corners( index.size());
+	std::vector<size_t> next( first.begin(), first.end() - 1);
+	for (size_t i = 0; i < index.size(); ++i)
+		corners[next[index[i]]++] = i;
+
+	// Group the triangles at each vertex: each group takes the triangles
+	// within the crease angle of its first one.  The first group keeps the
+	// vertex, and the others get new vertexes, copied from it.  Triangles
+	// with no area are left at the vertex.
+	const double min_cos = crease_cos( crease_angle);
+	std::vector<vector> normals( count);
+	std::vector<size_t> copied_from;
+	std::vector<vector> copy_normals;
+	std::vector<bool> grouped;
+	for (size_t v = 0; v < count; ++v) {
+		const size_t begin = first[v], end = first[v+1];
+		if (begin == end) {
+			normals[v] = vector( normal.data( v));
+			continue;
+		}
+		grouped.assign( end - begin, false);
+		size_t vertex = v;
+		for (size_t seed = begin; seed < end; ++seed) {
+			const vector& seed_normal = unit_normal[corners[seed] / 3];
+			if (grouped[seed - begin] || !seed_normal)
 				continue;
-			}
-			for ( ; setiter != setiterend; setiter++) {
-				if (vector(norm_i+*setiter).norm().dot(thisnorm) >= cosangle) {
-					similar.push_back(*setiter);
+			vector sum;
+			for (size_t i = seed; i < end; ++i) {
+				const size_t t = corners[i] / 3;
+				if (!grouped[i - begin] && unit_normal[t].dot( seed_normal) >= min_cos) {
+					grouped[i - begin] = true;
+					sum += area[t];
+					index[corners[i]] = vertex;
 				}
 			}
-			vector average = vector(0,0,0);
-			std::list<int>::iterator viter = similar.begin();
-			const std::list<int>::iterator viterend = similar.end();
-			for ( ; viter != viterend; viter++) {
-				average += vector(norm_i+*viter).norm();
-			}
-			average = average.norm();
-			double averagex = average.get_x();
-			double averagey = average.get_y();
-			double averagez = average.get_z();
-			for ( viter=similar.begin(); viter != viterend; viter++) {
-				norm_i[*viter] = averagex;
-				norm_i[*viter+1] = averagey;
-				norm_i[*viter+2] = averagez;
-				(iter->second).erase(*viter);
+			if (vertex == v)
+				normals[v] = sum.norm();
+			else {
+				copied_from.push_back( v);
+				copy_normals.push_back( sum.norm());
 			}
-			similar.clear();
+			vertex = count + copied_from.size();
+		}
+	}
+
+	const size_t old_count = count;
+	if (!copied_from.empty()) {
+		set_length( count + copied_from.size());
+		for (size_t i = 0; i < copied_from.size(); ++i) {
+			std::copy( pos.data( copied_from[i]), pos.data( copied_from[i] + 1), pos.data( old_count + i));
+			std::copy( color.data( copied_from[i]), color.data( copied_from[i] + 1), color.data( old_count + i));
 		}
+		pos.modified( old_count, count);
+		color.modified( old_count, count);
+		index_max = count - 1;
+	}
+	for (size_t v = 0; v < count; ++v) {
+		const vector& n = v < old_count ? normals[v] : copy_normals[v - old_count];
+		double* norm_i = normal.data( v);
+		norm_i[0] = n.x;
+		norm_i[1] = n.y;
+		norm_i[2] = n.z;
+	}
+	normal.modified( 0, count);
+}
+
+boost::python::object
+faces::get_index()
+{
+	std::vector<npy_intp> dims( 2);
+	dims[0] = index.size() / 3;
+	dims[1] = 3;
+	array ret = makeNum( dims, NPY_INT);
+	int* ret_i = (int*)data( ret);
+	for (size_t i = 0; i < index.size(); ++i)
+		ret_i[i] = index[i];
+	return ret;
+}
+
+void
+faces::set_index( const double_array& n_index)
+{
+	std::vector<npy_intp> dims = shape( n_index);
+	if (dims.size() == 1 && dims[0] == 0) {
+		index.clear();
+		index_max = 0;
+		centroids_made = false;
+		sorted.clear();
+		return;
 	}
+	if (dims.size() != 2 || dims[1] != 3)
+		throw std::invalid_argument( "index must be an Mx3 array.");
+
+	// Vertexes may be given after the index, so the numbers are checked
+	// against the length of pos when used.
+	const double* in = (const double*)data( n_index);
+	std::vector<unsigned int> result( dims[0] * 3);
+	size_t n_max = 0;
+	for (size_t i = 0; i < result.size(); ++i) {
+		if (in[i] < 0 || in[i] > 4294967295.0 || in[i] != std::floor( in[i]))
+			throw std::invalid_argument( "index must hold non-negative integers.");
+		result[i] = (unsigned int)in[i];
+		n_max = std::max( n_max, (size_t)result[i]);
+	}
+	index.swap( result);
+	index_max = n_max;
+	centroids_made = false;
+	sorted.clear();
 }
 
 boost::python::object faces::get_normal() {
-	return normal[all()];
+	return normal.get_view();
 }
 
 void faces::set_normal( const double_array& n_normal)
@@ -257,8 +726,8 @@ void faces::set_normal( const double_array& n_normal)
 		}
 	}
 
-	normal[slice(0, count)] = n_normal;
-	double* norm_i = normal.data();
+	normal[normal.rows(0, count)] = n_normal;
+	normal.modified( 0, count);
 }
 
 void faces::set_normal_v( vector v)
@@ -267,71 +736,102 @@ void faces::set_normal_v( vector v)
 	using boost::python::make_tuple;
 	// Broadcast the new normal across the array.
 	int npoints = count ? count : 1;
-	normal[slice(0, npoints)] = make_tuple( v.x, v.y, v.z);
+	normal[normal.rows(0, npoints)] = make_tuple( v.x, v.y, v.z);
+	normal.modified( 0, npoints);
+}
+
+void faces::mark_dirty( int begin, int end)
+{
+	arrayprim_color::mark_dirty( begin, end);
+	size_t first, last;
+	dirty_rows( begin, end, first, last);
+	normal.modified( first, last);
+}
+
+void
+faces::outer_render( const view& v)
+{
+	// As renderable::outer_render(), but the material's shader must also
+	// know whether to light back faces.
+	tmatrix material_matrix;
+	get_material_matrix( v, material_matrix);
+	apply_material use_mat( v, mat.get(), material_matrix, twosided);
+	gl_render( v);
+}
+
+void
+faces::update_centroids()
+{
+	const array_version version = pos.get_version();
+	const size_t triangles = indexed() ? index.size() / 3 : count / 3;
+	size_t begin = 0, end = count;
+	if (centroids_made && centroids.size() == 3*triangles) {
+		if (!pos.changed_since( centroid_version, begin, end))
+			return;
+		// Any triangle might use a changed vertex.
+		if (indexed()) {
+			begin = 0;
+			end = count;
+		}
+	}
+	centroids.resize( 3*triangles);
+	sorted.clear();
+	const size_t first = indexed() ? 0 : begin / 3;
+	const size_t last = indexed() ? triangles : std::min( (end + 2) / 3, triangles);
+	if (first < last) {
+		triangle_centroids kernel = { pos.data(), indexed() ? &index[0] : 0, &centroids[0], first };
+		parallel_for( last - first, 16384, kernel);
+	}
+	centroid_version = version;
+	centroids_made = true;
+}
+
+void
+faces::sort_triangles( const view& scene)
+{
+	update_centroids();
+	// The depth axis, for points as they are stored.
+	const vector forward = (scene.forward * scene.gcfvec).norm();
+	const size_t triangles = centroids.size() / 3;
+	if (sorted.size() == 3*triangles && forward.dot( sorted_forward) > resort_cos)
+		return;
+
+	// Sort the triangle numbers, in the low bits, by depth, in the high bits.
+	std::vector<boost::uint64_t> order( triangles);
+	const float fx = forward.x, fy = forward.y, fz = forward.z;
+	for (size_t t = 0; t < triangles; ++t) {
+		const float* c = &centroids[3*t];
+		order[t] = (boost::uint64_t)far_first_key( fx*c[0] + fy*c[1] + fz*c[2]) << 32 | t;
+	}
+	radix_sort( order);
+
+	sorted.resize( 3*triangles);
+	for (size_t i = 0; i < triangles; ++i) {
+		const size_t t = order[i] & 0xffffffffu;
+		for (int k = 0; k < 3; ++k)
+			sorted[3*i+k] = indexed() ? index[3*t+k] : 3*t+k;
+	}
+	sorted_forward = forward;
 }
 
 void
 faces::gl_render( const view& scene)
 {
-	if (degenerate())
+	if (degenerate() || (indexed() && index_max >= count))
 		return;
 
-	std::vector<vector> spos;
 	std::vector<rgb> tcolor;
 
+	// The points are drawn as they are stored, scaled by the transform.
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform();
+
 	gl_enable_client vertexes( GL_VERTEX_ARRAY);
 	gl_enable_client normals( GL_NORMAL_ARRAY);
 	gl_enable_client colors( GL_COLOR_ARRAY);
 
 	glNormalPointer( GL_DOUBLE, 0, normal.data() );
-
-	/*
-	// This attempt to minimize loop overhead made no difference in faces rendering speed
-	if (scene.gcf != 1.0 || (scene.gcfvec[0] != scene.gcfvec[1])) {
-		double gx = scene.gcfvec[0];
-		double gy = scene.gcfvec[1];
-		double gz = scene.gcfvec[2];
-		std::vector<vector> tmp( count);
-		spos.swap( tmp);
-		const double* p = pos.data();
-		double* s = &spos[0][0];
-		size_t i;
-		for (i=0; i<(3*(count-10)); ) { // reduce loop overhead to a minimum
-			s[i   ] = gx*p[i   ]; s[i+1 ] = gy*p[i+1 ]; s[i+2 ] = gz*p[i+2];
-			s[i+3 ] = gx*p[i+3 ]; s[i+4 ] = gy*p[i+4 ]; s[i+5 ] = gz*p[i+5];
-			s[i+6 ] = gx*p[i+6 ]; s[i+7 ] = gy*p[i+7 ]; s[i+8 ] = gz*p[i+8];
-			s[i+9 ] = gx*p[i+9 ]; s[i+10] = gy*p[i+10]; s[i+11] = gz*p[i+11];
-			s[i+12] = gx*p[i+12]; s[i+13] = gy*p[i+13]; s[i+14] = gz*p[i+14];
-			s[i+15] = gx*p[i+15]; s[i+16] = gy*p[i+16]; s[i+17] = gz*p[i+17];
-			s[i+18] = gx*p[i+18]; s[i+19] = gy*p[i+19]; s[i+20] = gz*p[i+20];
-			s[i+21] = gx*p[i+21]; s[i+22] = gy*p[i+22]; s[i+23] = gz*p[i+23];
-			s[i+24] = gx*p[i+24]; s[i+25] = gy*p[i+25]; s[i+26] = gz*p[i+26];
-			s[i+27] = gx*p[i+27]; s[i+28] = gy*p[i+28]; s[i+29] = gz*p[i+29];
-			i += 30;
-		}
-		for (; i<3*count;) {
-			s[i] = gx*p[i]; s[i+1] = gy*p[i+1]; s[i+2] = gz*p[i+2];
-			i += 3;
-		}
-
-		glVertexPointer( 3, GL_DOUBLE, 0, s);
-	}
-	else
-		glVertexPointer( 3, GL_DOUBLE, 0, pos.data() );
-	*/
-
-	if (scene.gcf != 1.0 || (scene.gcfvec[0] != scene.gcfvec[1])) {
-		std::vector<vector> tmp( count);
-		spos.swap( tmp);
-		const double* pos_i = pos.data();
-		for (std::vector<vector>::iterator i = spos.begin(); i != spos.end(); ++i) {
-			*i = vector(pos_i).scale(scene.gcfvec);
-			pos_i += 3;
-		}
-		glVertexPointer( 3, GL_DOUBLE, 0, &*spos.begin());
-	}
-	else
-		glVertexPointer( 3, GL_DOUBLE, 0, pos.data() );
+	glVertexPointer( 3, GL_DOUBLE, 0, pos.data() );
 
 	if (scene.anaglyph) {
 		std::vector<rgb> tmp( count);
@@ -349,11 +849,29 @@ faces::gl_render( const view& scene)
 	else
 		glColorPointer( 3, GL_DOUBLE, 0, color.data() );
 
-	gl_enable cull_face( GL_CULL_FACE);
-	for (size_t drawn = 0; drawn < count - count%3; drawn += 540) {
-		glDrawArrays( GL_TRIANGLES, drawn,
-			std::min( count - count%3 - drawn, (size_t)540));
+	// Without a shader, fixed function lighting reverses the normals of
+	// back faces.
+	if (twosided)
+		glLightModeli( GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
+	else
+		glEnable( GL_CULL_FACE);
+	if (depth_sort && translucent()) {
+		sort_triangles( scene);
+		if (!sorted.empty())
+			glDrawElements( GL_TRIANGLES, sorted.size(), GL_UNSIGNED_INT, &sorted[0]);
+	}
+	else if (indexed())
+		glDrawElements( GL_TRIANGLES, index.size(), GL_UNSIGNED_INT, &index[0]);
+	else {
+		for (size_t drawn = 0; drawn < count - count%3; drawn += 540) {
+			glDrawArrays( GL_TRIANGLES, drawn,
+				std::min( count - count%3 - drawn, (size_t)540));
+		}
 	}
+	if (twosided)
+		glLightModeli( GL_LIGHT_MODEL_TWO_SIDE, GL_FALSE);
+	else
+		glDisable( GL_CULL_FACE);
 }
 
 void
@@ -365,23 +883,23 @@ faces::gl_pick_render( const view& scene)
 vector
 faces::get_center() const
 {
-	vector ret;
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.data( count - count%3 );
-	while (pos_i < pos_end) {
-		ret += vector(pos_i);
-		pos_i += 3; // 3 doubles per vector point
-	}
-	if (count)
-		ret /= count;
-	return ret;
+	if (!count)
+		return vector();
+	update_bounds();
+	if (indexed())
+		return pos_sum / count;
+	// Points of an incomplete last triangle are left out.
+	vector ret = pos_sum;
+	for (size_t i = count - count%3; i < count; ++i)
+		ret -= vector( pos.data( i));
+	return ret / count;
 }
 
 void
 faces::grow_extent( extent& world)
 {
 	const double* pos_i = pos.data();
-	const double* pos_end = pos.data( count - count%3 );
+	const double* pos_end = pos.data( indexed() ? count : count - count%3 );
 	while (pos_i < pos_end) {
 		world.add_point( vector(pos_i));
 		pos_i += 3; // 3 doubles per vector point
@@ -390,24 +908,16 @@ faces::grow_extent( extent& world)
 }
 
 void
-faces::get_material_matrix( const view& v, tmatrix& out ) {
+faces::get_material_matrix( const view&, tmatrix& out ) {
 	if (degenerate()) return;
 
-	// TODO: Add some caching for extent with grow_extent etc
-	vector min_extent, max_extent;
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.data( count - count%3 );
-	min_extent = max_extent = vector( pos_i ); pos_i += 3;
-	while (pos_i < pos_end)
-		for(int j=0; j<3; j++) {
-			if (*pos_i < min_extent[j]) min_extent[j] = *pos_i;
-			else if (*pos_i > max_extent[j]) max_extent[j] = *pos_i;
-			pos_i++;
-		}
+	update_bounds();
+	const vector& min_extent = bounds_min;
+	const vector& max_extent = bounds_max;
 
 	out.translate( vector(.5,.5,.5) );
-	out.scale( vector(1,1,1) * (.999 / (v.gcf * std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z)))) );
-	out.translate( -.5 * v.gcf * (min_extent + max_extent) );
+	out.scale( vector(1,1,1) * (.999 / std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z))) );
+	out.translate( -.5 * (min_extent + max_extent) );
 }
 
 } } // !namespace cvisual::python
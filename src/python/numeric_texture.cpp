@@ -12,6 +12,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/scoped_array.hpp>
 #include <iostream>
+#include <algorithm>
 
 namespace cvisual { namespace python {
 
@@ -37,6 +38,40 @@ gl_type_name( NPY_TYPES t)
 	}
 }
 
+// The generic compressed counterpart of an uncompressed base format.
+GLenum
+compressed_format( GLenum format)
+{
+	switch (format) {
+		case GL_ALPHA:
+			return GL_COMPRESSED_ALPHA_ARB;
+		case GL_LUMINANCE:
+			return GL_COMPRESSED_LUMINANCE_ARB;
+		case GL_LUMINANCE_ALPHA:
+			return GL_COMPRESSED_LUMINANCE_ALPHA_ARB;
+		case GL_RGB:
+			return GL_COMPRESSED_RGB_ARB;
+		case GL_RGBA:
+			return GL_COMPRESSED_RGBA_ARB;
+		default:
+			return format;
+	}
+}
+
+// An estimate of the graphics memory used by a texture, assuming 8-bit
+// components, RGB padded to RGBA, and about 4:1 compression.
+size_t
+storage_bytes( size_t width, size_t height, size_t depth, size_t channels,
+	bool mipmapped, bool compressed)
+{
+	size_t bytes = width * height * depth * (channels == 3 ? 4 : channels);
+	if (compressed)
+		bytes /= 4;
+	if (mipmapped)
+		bytes += bytes / 3;
+	return bytes;
+}
+
 boost::crc_32_type engine;
 } // !namespace (anonymous)
 
@@ -45,12 +80,17 @@ numeric_texture::numeric_texture()
 	data_width(0), data_height(0), data_depth(0), data_channels(0), data_type(NPY_NOTYPE),
 		data_textype( 0), data_mipmapped(true), data_antialias(false), data_clamp(false),
 	tex_width(0), tex_height(0), tex_depth(0), tex_channels(0), tex_type(NPY_NOTYPE),
-		tex_textype( 0), tex_mipmapped(true), tex_antialias(false), tex_clamp(false)
+		tex_textype( 0), tex_mipmapped(true), tex_antialias(false), tex_clamp(false),
+		tex_reduction(0),
+	dirty_x(0), dirty_y(0), dirty_width(0), dirty_height(0), dirty_full(true),
+	pbo(0), glDeleteBuffersARB(0)
 {
 }
 
 numeric_texture::~numeric_texture()
 {
+	if (pbo)
+		on_gl_free.free( boost::bind( &numeric_texture::gl_free_buffer, glDeleteBuffersARB, pbo ) );
 }
 
 int
@@ -101,8 +141,10 @@ numeric_texture::gl_init( const view& v )
 
 	GLuint handle = get_handle();
 	if (!handle) {
+		// First use, or the texture was released to stay within the memory budget.
 		glGenTextures(1, &handle);
 		set_handle( v, handle );
+		dirty_full = true;
 	}
 	glBindTexture(type, handle);
 
@@ -183,28 +225,75 @@ numeric_texture::gl_init( const view& v )
 	}
 	tex_textype = internal_format;
 
+	// The format the texels are stored in by OpenGL, which differs from the
+	// format they are supplied in when compression is requested.
+	GLenum storage_format = internal_format;
+	if (texture::get_compression() && v.glext.ARB_texture_compression && !data_depth)
+		storage_format = compressed_format( internal_format);
+	const bool compressed = storage_format != internal_format;
+
+	// Let OpenGL maintain the mipmaps when it can, so that a partial update
+	// doesn't rebuild the whole chain on the CPU.
+	bool hw_mipmap = data_mipmapped && !data_depth && v.glext.SGIS_generate_mipmap && (
+		v.glext.ARB_texture_non_power_of_two || (
+			next_power_of_two(data_width) == data_width &&
+			next_power_of_two(data_height) == data_height));
+	const bool glu_mipmap = data_mipmapped && !data_depth && !hw_mipmap;
+
+	// Make room for the texture within the memory budget, loading it at
+	// reduced resolution if that isn't enough.
+	int reduction = fit_memory_budget( storage_bytes(
+		data_mipmapped ? data_width : next_power_of_two(data_width),
+		data_mipmapped ? data_height : next_power_of_two(data_height),
+		data_depth ? next_power_of_two(data_depth) : 1,
+		data_channels, data_mipmapped, compressed ));
+	if (data_depth)
+		reduction = 0;
+	if (reduction != tex_reduction || compressed || reduction)
+		dirty_full = true;
+	tex_reduction = reduction;
+
+	const size_t src_width = std::max( data_width >> reduction, size_t(1));
+	const size_t src_height = std::max( data_height >> reduction, size_t(1));
+	const char* src = data(texdata);
+	boost::scoped_array<char> reduced;
 	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	if (reduction) {
+		reduced.reset( new char[src_width * src_height * data_channels * typesize(data_type)] );
+		gluScaleImage( internal_format, data_width, data_height, gl_type_name(data_type), src,
+			src_width, src_height, gl_type_name(data_type), reduced.get() );
+		src = reduced.get();
+	}
 
-	if (data_mipmapped && !data_depth) {
-		tex_width = data_width;
-		tex_height = data_height;
+	if (glu_mipmap) {
+		tex_width = src_width;
+		tex_height = src_height;
 		tex_depth = data_depth;
 		tex_channels = data_channels;
 		tex_type = data_type;
 		tex_textype = data_textype;
 		tex_mipmapped = true;
 
-		gluBuild2DMipmaps( type, internal_format, tex_width, tex_height,
-			internal_format, gl_type_name(tex_type), data(texdata));
+		gluBuild2DMipmaps( type, storage_format, tex_width, tex_height,
+			internal_format, gl_type_name(tex_type), src);
 	} else {
-		if (reinitialize) {
-			tex_width = next_power_of_two(data_width);
-			tex_height = next_power_of_two(data_height);
-			tex_depth = data_depth ? next_power_of_two(data_depth) : 1;
+		if (reinitialize || dirty_full) {
+			if (hw_mipmap) {
+				tex_width = src_width;
+				tex_height = src_height;
+				tex_depth = 0;
+				tex_mipmapped = true;
+			}
+			else {
+				tex_width = next_power_of_two(src_width);
+				tex_height = next_power_of_two(src_height);
+				tex_depth = data_depth ? next_power_of_two(data_depth) : 1;
+				tex_mipmapped = false;
+			}
 			tex_channels = data_channels;
 			tex_textype = data_textype;
 			tex_type = data_type;
-			tex_mipmapped = false;
+			dirty_full = true;
 
 			#ifdef __APPLE__
 				// Work around a bug in macbook pro nvidia drivers' glTexSubImage3D
@@ -213,11 +302,14 @@ numeric_texture::gl_init( const view& v )
 				glTexParameteri(GL_TEXTURE_3D, 0x85BC, 0x85BE);
 			#endif
 
+			if (v.glext.SGIS_generate_mipmap && type == GL_TEXTURE_2D)
+				glTexParameteri( type, GL_GENERATE_MIPMAP_SGIS, hw_mipmap ? GL_TRUE : GL_FALSE );
+
 			if (type == GL_TEXTURE_3D_EXT) {
-				v.glext.glTexImage3D( type, 0, internal_format, tex_width, tex_height, tex_depth,
+				v.glext.glTexImage3D( type, 0, storage_format, tex_width, tex_height, tex_depth,
 					0, internal_format, gl_type_name(tex_type), NULL );
 			} else {
-				glTexImage2D( type, 0, internal_format, tex_width, tex_height,
+				glTexImage2D( type, 0, storage_format, tex_width, tex_height,
 					0, internal_format, gl_type_name( tex_type), NULL );
 			}
 		}
@@ -225,17 +317,133 @@ numeric_texture::gl_init( const view& v )
 		if (type == GL_TEXTURE_3D_EXT) {
 			v.glext.glTexSubImage3D( type, 0,
 				0, 0, 0, data_width, data_height, data_depth,
-				internal_format, gl_type_name(tex_type), data(texdata));
-		} else {
-			glTexSubImage2D( type, 0,
-				0, 0, data_width, data_height,
-				internal_format, gl_type_name(tex_type), data(texdata));
+				internal_format, gl_type_name(tex_type), src);
+		} else if (dirty_full) {
+			gl_load_region( v, internal_format, gl_type_name(tex_type),
+				src, src_width, 0, 0, src_width, src_height );
+		} else if (dirty_width && dirty_height) {
+			gl_load_region( v, internal_format, gl_type_name(tex_type),
+				src, src_width, dirty_x, dirty_y, dirty_width, dirty_height );
 		}
 	}
+	dirty_full = false;
+	dirty_x = dirty_y = dirty_width = dirty_height = 0;
+
+	// Account for the memory actually used.
+	GLint is_compressed = 0;
+	if (compressed)
+		glGetTexLevelParameteriv( type, 0, GL_TEXTURE_COMPRESSED_ARB, &is_compressed );
+	if (is_compressed) {
+		GLint level_bytes = 0;
+		glGetTexLevelParameteriv( type, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE_ARB, &level_bytes );
+		set_resident_bytes( tex_mipmapped ? level_bytes * 4 / 3 : level_bytes );
+	}
+	else {
+		set_resident_bytes( storage_bytes( tex_width, tex_height, std::max( tex_depth, size_t(1)),
+			tex_channels, tex_mipmapped, false ));
+	}
 
 	check_gl_error();
 }
 
+void
+numeric_texture::gl_load_region( const view& v, GLenum format, GLenum type,
+	const char* pixels, size_t row_width,
+	size_t x, size_t y, size_t width, size_t height )
+{
+	const size_t texel = data_channels * typesize( data_type);
+	const size_t row = row_width * texel;
+	const char* src = pixels + y*row + x*texel;
+
+	if (v.glext.ARB_pixel_buffer_object) {
+		if (!pbo) {
+			v.glext.glGenBuffersARB( 1, &pbo );
+			glDeleteBuffersARB = v.glext.glDeleteBuffersARB;
+			on_gl_free.connect( boost::bind( &numeric_texture::gl_free_buffer, glDeleteBuffersARB, pbo ) );
+		}
+		v.glext.glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, pbo );
+		// Respecifying the data store orphans the previous one, so we never wait
+		// on a transfer that is still in flight.  The copy into the texture then
+		// proceeds asynchronously while we go on rendering.
+		v.glext.glBufferDataARB( GL_PIXEL_UNPACK_BUFFER_ARB, width*height*texel,
+			NULL, GL_STREAM_DRAW_ARB );
+		char* dest = static_cast<char*>(
+			v.glext.glMapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB ));
+		if (dest) {
+			for (size_t i = 0; i < height; ++i)
+				memcpy( dest + i*width*texel, src + i*row, width*texel );
+			v.glext.glUnmapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB );
+			glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, width, height, format, type, 0 );
+		}
+		v.glext.glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+		if (dest)
+			return;
+		// Mapping failed; fall back to loading from client memory.
+	}
+
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, row_width );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, width, height, format, type, src );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+}
+
+void
+numeric_texture::gl_free_buffer( PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB, unsigned int pbo )
+{
+	glDeleteBuffersARB( 1, &pbo );
+}
+
+bool
+numeric_texture::damage_difference( const boost::python::numeric::array& next_data )
+{
+	const size_t texel = data_channels * typesize( data_type);
+	const size_t row = data_width * texel;
+	const char* prev = data(texdata);
+	const char* next = data(next_data);
+
+	// Find the first and last changed rows, then the changed columns within them.
+	size_t top = 0, bottom = data_height;
+	while (top < bottom && !memcmp( prev + top*row, next + top*row, row))
+		++top;
+	if (top == bottom)
+		return false;
+	while (!memcmp( prev + (bottom-1)*row, next + (bottom-1)*row, row))
+		--bottom;
+
+	size_t left = data_width, right = 0;
+	for (size_t i = top; i < bottom; ++i) {
+		const char* p = prev + i*row;
+		const char* n = next + i*row;
+		size_t l = 0;
+		while (l < left && !memcmp( p + l*texel, n + l*texel, texel))
+			++l;
+		size_t r = data_width;
+		while (r > right && r > l && !memcmp( p + (r-1)*texel, n + (r-1)*texel, texel))
+			--r;
+		left = std::min( left, l);
+		right = std::max( right, r);
+	}
+
+	// Merge with any region that hasn't been loaded yet.
+	if (dirty_width && dirty_height) {
+		left = std::min( left, dirty_x);
+		top = std::min( top, dirty_y);
+		right = std::max( right, dirty_x + dirty_width);
+		bottom = std::max( bottom, dirty_y + dirty_height);
+	}
+	dirty_x = left;
+	dirty_y = top;
+	dirty_width = right - left;
+	dirty_height = bottom - top;
+	return true;
+}
+
+void
+numeric_texture::damage_all()
+{
+	dirty_full = true;
+	damage();
+}
+
 void
 numeric_texture::gl_transform(void)
 {
@@ -243,9 +451,11 @@ numeric_texture::gl_transform(void)
 		return;
 	glMatrixMode( GL_TEXTURE);
 	glLoadIdentity();
-	if (data_width != tex_width || data_height != tex_height) {
-		float x_scale = float(data_width) / tex_width;
-		float y_scale = float(data_height) / tex_height;
+	const size_t width = std::max( data_width >> tex_reduction, size_t(1));
+	const size_t height = std::max( data_height >> tex_reduction, size_t(1));
+	if (width != tex_width || height != tex_height) {
+		float x_scale = float(width) / tex_width;
+		float y_scale = float(height) / tex_height;
 		glScalef( x_scale, y_scale, 1);
 	}
 	glMatrixMode( GL_MODELVIEW);
@@ -287,7 +497,17 @@ numeric_texture::set_data( boost::python::numeric::array data)
 			"Texture data must be NxMxC, where C is between 1 and 4 (inclusive)");
 	}
 
-	damage();
+	// When only the contents change, track the changed region so that just
+	// that part needs to be loaded into OpenGL.
+	bool same_layout = !degenerate() && !dirty_full && t == data_type &&
+		dims.size() < 4 && !data_depth &&
+		size_t(dims[0]) == data_height && size_t(dims[1]) == data_width &&
+		size_t(channels) == data_channels;
+	if (!same_layout)
+		damage_all();
+	else if (damage_difference( data))
+		damage();
+
 	texdata = data;
 	data_width = dims[1];
 	data_height = dims[0];
@@ -332,7 +552,7 @@ numeric_texture::set_type( std::string requested_type)
 	data_textype = req_type;
 	if (req_type == GL_RGBA || req_type == GL_ALPHA || req_type == GL_LUMINANCE_ALPHA)
 		have_opacity = true;
-	damage();
+	damage_all();
 }
 
 std::string
@@ -357,7 +577,7 @@ numeric_texture::get_type() const
 void
 numeric_texture::set_mipmapped( bool m)
 {
-	damage();
+	damage_all();
 	data_mipmapped = m;
 }
 
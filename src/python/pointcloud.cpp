@@ -0,0 +1,408 @@
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "python/pointcloud.hpp"
+#include "util/errors.hpp"
+#include "util/gl_enable.hpp"
+#include "util/point_shader.hpp"
+#include "wrap_gl.hpp"
+
+#include <threadpool.hpp>
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <queue>
+#include <list>
+#include <cstddef>
+#include <cmath>
+
+namespace cvisual { namespace python {
+
+struct pointcloud::source
+{
+	struct loaded
+	{
+		size_t node;
+		std::vector<point_octree::record> points;
+	};
+
+	point_octree octree;
+	mutex ready_lock;
+	std::list<loaded> ready;
+	size_t in_flight;  // reads scheduled and not yet ready
+
+	explicit source( const std::string& filename)
+		: octree( filename), in_flight(0)
+	{}
+
+	// Called by a reading thread.
+	void read( size_t n)
+	{
+		loaded result;
+		result.node = n;
+		try {
+			octree.read( n, result.points);
+		}
+		catch (std::exception&) {
+			// An unreadable node is drawn as empty.
+			result.points.clear();
+		}
+		lock L(ready_lock);
+		ready.push_back( loaded());
+		ready.back().node = n;
+		ready.back().points.swap( result.points);
+		--in_flight;
+	}
+};
+
+namespace {
+// The reads waiting in the pool are limited, so that those no longer wanted
+// by the time a thread is free don't pile up.
+const size_t max_in_flight = 4;
+
+boost::threadpool::pool&
+readers()
+{
+	static boost::threadpool::pool* pool = NULL;
+	if (!pool)
+		pool = new boost::threadpool::pool( 2);
+	return *pool;
+}
+
+// True if the box is wholly outside one of the planes of the view frustum.
+bool
+outside_frustum( const tmatrix& clip, const vector& lo, const vector& hi)
+{
+	int out[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int c = 0; c < 8; ++c) {
+		const vertex v = clip * vertex( c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y,
+			c & 4 ? hi.z : lo.z, 1.0);
+		out[0] += v.x < -v.w;
+		out[1] += v.x > v.w;
+		out[2] += v.y < -v.w;
+		out[3] += v.y > v.w;
+		out[4] += v.z < -v.w;
+		out[5] += v.z > v.w;
+	}
+	for (int i = 0; i < 6; ++i)
+		if (out[i] == 8)
+			return true;
+	return false;
+}
+} // !namespace (anonymous)
+
+pointcloud::pointcloud()
+	: resident_count(0), frame(0), drawn_count(0),
+	size( 2.0), points_shape(ROUND), point_budget( 1000000), memory_budget( 4000000)
+{
+}
+
+pointcloud::pointcloud( const pointcloud& other)
+	: renderable( other), resident_count(0), frame(0), drawn_count(0),
+	size( other.size), points_shape( other.points_shape),
+	point_budget( other.point_budget), memory_budget( other.memory_budget)
+{
+	// The copy reads the file for itself, since each object uploads the
+	// nodes that it reads.
+	if (!other.filename.empty())
+		set_file( other.filename);
+}
+
+void
+pointcloud::set_file( const std::string& n_filename)
+{
+	boost::shared_ptr<source> opened( new source( n_filename));
+	file = opened;
+	filename = n_filename;
+	nodes.clear();
+	nodes.resize( file->octree.nodes().size());
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		nodes[i].status = ABSENT;
+		nodes[i].last_drawn = 0;
+	}
+	resident_count = 0;
+}
+
+void
+pointcloud::set_size( float n_size)
+{
+	if (n_size <= 0)
+		throw std::invalid_argument( "size must be positive");
+	size = n_size;
+}
+
+void
+pointcloud::set_points_shape( const std::string& n_type)
+{
+	if (n_type == "round")
+		points_shape = ROUND;
+	else if (n_type == "square")
+		points_shape = SQUARE;
+	else
+		throw std::invalid_argument( "Unrecognized shape type");
+}
+
+std::string
+pointcloud::get_points_shape() const
+{
+	return points_shape == SQUARE ? "square" : "round";
+}
+
+boost::uint64_t
+pointcloud::get_point_count() const
+{
+	return file ? file->octree.size() : 0;
+}
+
+void
+pointcloud::upload( const view& scene)
+{
+	std::list<source::loaded> arrived;
+	{
+		lock L(file->ready_lock);
+		arrived.splice( arrived.end(), file->ready);
+	}
+
+	bool bound = false;
+	for (std::list<source::loaded>::iterator i = arrived.begin(); i != arrived.end(); ++i) {
+		node_state& s = nodes[i->node];
+		s.status = RESIDENT;
+		s.last_drawn = frame;
+		resident_count += i->points.size();
+		if (i->points.empty())
+			continue;
+		if (scene.glext.ARB_vertex_buffer_object) {
+			s.points.gl_set_data( scene, i->points.size() * sizeof(point_octree::record),
+				&i->points[0], GL_STATIC_DRAW_ARB);
+			bound = true;
+		}
+		else
+			s.client_points.swap( i->points);
+	}
+	if (bound)
+		nodes[0].points.gl_unbind( scene);
+}
+
+void
+pointcloud::select( const view& scene, std::vector<size_t>& chosen)
+{
+	const std::vector<point_octree::node>& tree = file->octree.nodes();
+
+	tmatrix modelview; modelview.gl_modelview_get();
+	tmatrix proj; proj.gl_projection_get();
+	const tmatrix clip = proj * modelview;
+	GLint viewport[4];
+	glGetIntegerv( GL_VIEWPORT, viewport);
+	// The pixels across an object one unit wide, at an eye z of 1.
+	const double pixels_at_z_1 = proj(1,1) * viewport[3] * 0.5;
+
+	// Nodes are visited largest on the screen first.  A node is refined
+	// only once it is in memory, so that its children never appear without
+	// it, leaving holes.
+	typedef std::pair<double, size_t> candidate;
+	std::priority_queue<candidate> queue;
+	if (!outside_frustum( clip, tree[0].min_corner, tree[0].max_corner))
+		queue.push( candidate( HUGE_VAL, 0));
+	size_t total = 0;
+	size_t requests = 0;
+	{
+		lock L(file->ready_lock);
+		requests = file->in_flight;
+	}
+	while (!queue.empty()) {
+		const double pixels = queue.top().first;
+		const size_t n = queue.top().second;
+		queue.pop();
+		const point_octree::node& node = tree[n];
+		node_state& s = nodes[n];
+
+		if (total + node.count > point_budget && !chosen.empty())
+			break;
+		if (s.status != RESIDENT) {
+			if (s.status == ABSENT && requests < max_in_flight) {
+				s.status = LOADING;
+				++requests;
+				{
+					lock L(file->ready_lock);
+					++file->in_flight;
+				}
+				readers().schedule( boost::bind( &source::read, file, n));
+			}
+			continue;
+		}
+		chosen.push_back( n);
+		s.last_drawn = frame;
+		total += node.count;
+
+		// The points of a node are spread over its cube, typically along
+		// surfaces, so they are about pixels/sqrt(count) apart on the screen.
+		// There is no need to refine once that is no more than the point size.
+		if (!node.count || pixels / std::sqrt( double(node.count)) <= size)
+			continue;
+		for (int c = 0; c < 8; ++c) {
+			const int k = node.child[c];
+			if (k < 0 || outside_frustum( clip, tree[k].min_corner, tree[k].max_corner))
+				continue;
+			const vector center = (tree[k].min_corner + tree[k].max_corner) * 0.5;
+			const double radius = (tree[k].max_corner - center).mag() * scene.gcf;
+			const double depth = -(modelview * center).z;
+			queue.push( candidate( depth > radius
+				? 2.0 * radius * pixels_at_z_1 / depth : HUGE_VAL, k));
+		}
+	}
+}
+
+void
+pointcloud::evict()
+{
+	if (resident_count <= memory_budget)
+		return;
+	// Drop the nodes drawn least recently, but none drawn this frame.
+	typedef std::pair<unsigned long, size_t> candidate;
+	std::vector<candidate> stale;
+	for (size_t i = 0; i < nodes.size(); ++i)
+		if (nodes[i].status == RESIDENT && nodes[i].last_drawn < frame)
+			stale.push_back( candidate( nodes[i].last_drawn, i));
+	std::sort( stale.begin(), stale.end());
+	for (size_t i = 0; i < stale.size() && resident_count > memory_budget; ++i) {
+		node_state& s = nodes[stale[i].second];
+		const size_t held = s.points.size() / sizeof(point_octree::record)
+			+ s.client_points.size();
+		resident_count -= std::min( resident_count, held);
+		s.points.reset();
+		std::vector<point_octree::record>().swap( s.client_points);
+		s.status = ABSENT;
+	}
+}
+
+void
+pointcloud::gl_render( const view& scene)
+{
+	if (!file)
+		return;
+
+	clear_gl_error();
+	++frame;
+	gl_matrix_stackguard guard;
+	scene.gl_world_transform();
+
+	upload( scene);
+	std::vector<size_t> chosen;
+	select( scene, chosen);
+	evict();
+
+	gl_disable ltg( GL_LIGHTING);
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	const bool colored = file->octree.has_color();
+	if (colored)
+		glEnableClientState( GL_COLOR_ARRAY);
+	else
+		color.gl_set( 1.0);
+
+	use_point_shader shader( scene,
+		points_shape == SQUARE ? use_point_shader::SQUARE : use_point_shader::DISK, size, 0);
+	if (!shader.ok()) {
+		if (points_shape == ROUND)
+			glEnable( GL_POINT_SMOOTH);
+		if (scene.glext.ARB_point_parameters) {
+			float attenuation_eqn[] = {1.0f, 0.0f, 0.0f};
+			scene.glext.glPointParameterfvARB( GL_POINT_DISTANCE_ATTENUATION_ARB, attenuation_eqn);
+		}
+		glPointSize( size);
+	}
+
+	drawn_count = 0;
+	const GLsizei stride = sizeof(point_octree::record);
+	for (std::vector<size_t>::iterator i = chosen.begin(); i != chosen.end(); ++i) {
+		node_state& s = nodes[*i];
+		const char* base = 0;
+		size_t n = s.client_points.size();
+		if (n)
+			base = reinterpret_cast<const char*>( &s.client_points[0]);
+		else if (s.points.size()) {
+			s.points.gl_bind( scene);
+			n = s.points.size() / sizeof(point_octree::record);
+		}
+		if (!n)
+			continue;
+		glVertexPointer( 3, GL_FLOAT, stride, base + offsetof( point_octree::record, pos));
+		if (colored)
+			glColorPointer( 3, GL_UNSIGNED_BYTE, stride, base + offsetof( point_octree::record, color));
+		glDrawArrays( GL_POINTS, 0, n);
+		drawn_count += n;
+	}
+	if (scene.glext.ARB_vertex_buffer_object)
+		nodes[0].points.gl_unbind( scene);
+
+	if (!shader.ok() && points_shape == ROUND)
+		glDisable( GL_POINT_SMOOTH);
+	if (colored)
+		glDisableClientState( GL_COLOR_ARRAY);
+	check_gl_error();
+}
+
+void
+pointcloud::gl_pick_render( const view& scene)
+{
+	gl_render( scene);
+}
+
+void
+pointcloud::outer_render( const view& scene)
+{
+	gl_render( scene);  //< no materials
+}
+
+vector
+pointcloud::get_center() const
+{
+	if (!file)
+		return vector();
+	const point_octree::node& root = file->octree.nodes()[0];
+	return (root.min_corner + root.max_corner) * 0.5;
+}
+
+void
+pointcloud::grow_extent( extent& world)
+{
+	if (!file)
+		return;
+	const point_octree::node& root = file->octree.nodes()[0];
+	world.add_point( root.min_corner);
+	world.add_point( root.max_corner);
+	world.add_body();
+}
+
+pointcloud_builder::pointcloud_builder( const std::string& filename, size_t node_points)
+	: builder( new point_octree_builder( filename, node_points))
+{
+}
+
+void
+pointcloud_builder::add_points( const double_array& pos)
+{
+	std::vector<npy_intp> dims = shape( pos);
+	if (dims.size() != 2 || dims[1] != 3)
+		throw std::invalid_argument( "pos must be an Nx3 array");
+	builder->add( (const double*)data( pos), 0, dims[0]);
+}
+
+void
+pointcloud_builder::add_points_color( const double_array& pos, const double_array& color)
+{
+	std::vector<npy_intp> dims = shape( pos);
+	if (dims.size() != 2 || dims[1] != 3)
+		throw std::invalid_argument( "pos must be an Nx3 array");
+	if (shape( color) != dims)
+		throw std::invalid_argument( "color must be an Nx3 array the same size as pos");
+	builder->add( (const double*)data( pos), (const double*)data( color), dims[0]);
+}
+
+void
+pointcloud_builder::finish()
+{
+	builder->finish();
+}
+
+} } // !namespace cvisual::python
@@ -4,10 +4,12 @@
 #include "util/sorted_model.hpp"
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
+#include "util/point_shader.hpp"
 
 #include "wrap_gl.hpp"
 
 #include <vector>
+#include <cstring>
 #include <sstream>
 #include <algorithm>
 #include <set>
@@ -18,7 +20,10 @@ using boost::python::make_tuple;
 using boost::python::object;
 
 points::points()
-	: size_units(PIXELS), points_shape(ROUND), size( 5.0)
+	: size_units(PIXELS), points_shape(ROUND), size( 5.0),
+	vertex_buffer( GL_ARRAY_BUFFER_ARB), color_buffer( GL_ARRAY_BUFFER_ARB),
+	buffer_count(0), buffer_capacity(0),
+	buffer_color_mode(0), buffer_color_type( GL_FLOAT)
 {
 }
 
@@ -34,6 +39,9 @@ void points::set_points_shape( const std::string& n_type)
 	else if (n_type == "square") {
 		points_shape = SQUARE;
 	}
+	else if (n_type == "sphere") {
+		points_shape = SPHERE;
+	}
 	else
 		throw std::invalid_argument( "Unrecognized shape type");
 }
@@ -45,6 +53,8 @@ std::string points::get_points_shape( void)
 			return "round";
 		case SQUARE:
 			return "square";
+		case SPHERE:
+			return "sphere";
 		default:
 			return "";
 	}
@@ -74,197 +84,282 @@ std::string points::get_size_units( void)
 	}
 }
 
-bool
-points::degenerate() const {
-	return count == 0;
+namespace {
+std::string
+storage_name( int storage)
+{
+	switch (storage) {
+		case NPY_DOUBLE: return "float64";
+		case NPY_FLOAT: return "float32";
+		case NPY_HALF: return "float16";
+		case NPY_UBYTE: return "uint8";
+		default: return "";
+	}
 }
 
-struct point_coord
+GLenum
+storage_gl_type( int storage)
 {
-	vector center;
-	mutable rgb color;
-	inline point_coord( const vector& p, const rgb& c)
-		: center( p), color(c)
-	{}
-};
+	switch (storage) {
+		case NPY_DOUBLE: return GL_DOUBLE;
+		case NPY_FLOAT: return GL_FLOAT;
+		case NPY_HALF: return GL_HALF_FLOAT_ARB;
+		default: return GL_UNSIGNED_BYTE;
+	}
+}
+} // !namespace (anonymous)
 
-void
-points::gl_render( const view& scene)
+void points::set_pos_type( const std::string& n_type)
 {
-	if (degenerate())
-		return;
+	if (n_type == "float64")
+		pos.set_storage( NPY_DOUBLE);
+	else if (n_type == "float32")
+		pos.set_storage( NPY_FLOAT);
+	else
+		throw std::invalid_argument( "pos_type must be 'float64' or 'float32'");
+}
 
-	std::vector<point_coord> translucent_points;
-	typedef std::vector<point_coord>::iterator translucent_iterator;
+std::string points::get_pos_type( void)
+{
+	return storage_name( pos.get_storage());
+}
+
+void points::set_color_type( const std::string& n_type)
+{
+	if (n_type == "float64")
+		color.set_storage( NPY_DOUBLE);
+	else if (n_type == "float32")
+		color.set_storage( NPY_FLOAT);
+	else if (n_type == "float16")
+		color.set_storage( NPY_HALF);
+	else if (n_type == "uint8")
+		color.set_storage( NPY_UBYTE, 255.0);
+	else
+		throw std::invalid_argument(
+			"color_type must be 'float64', 'float32', 'float16', or 'uint8'");
+}
 
-	std::vector<point_coord> opaque_points;
-	typedef std::vector<point_coord>::iterator opaque_iterator;
+std::string points::get_color_type( void)
+{
+	return storage_name( color.get_storage());
+}
 
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.end();
+bool
+points::degenerate() const {
+	return count == 0;
+}
 
-	const double* color_i = color.data();
-	const double* color_end = color.end();
+void
+points::write_points( size_t begin, size_t end, int color_mode, GLenum color_type,
+	const vector& origin, float* vertexes, void* colors)
+{
+	if (pos.get_storage() == NPY_FLOAT && origin == vector())
+		std::memcpy( vertexes, pos.raw( begin), 3*(end-begin) * sizeof(float));
+	else
+		for (size_t i = begin; i < end; ++i) {
+			const vector p = pos.get( i) - origin;
+			*vertexes++ = p.x;
+			*vertexes++ = p.y;
+			*vertexes++ = p.z;
+		}
 
-	// Currently points can not be translucent, so comment out all translucent code
-	for ( ; pos_i < pos_end && color_i < color_end; pos_i += 3, color_i += 3) {
-		opaque_points.push_back( point_coord( vector(pos_i), rgb(color_i)));
+	if (color_type != GL_FLOAT) {
+		// Bytes or halfs, as they are stored.
+		std::memcpy( colors, color.raw( begin), 3*(end-begin)
+			* (color_type == GL_UNSIGNED_BYTE ? 1 : sizeof(npy_uint16)));
+		return;
+	}
+	float* c_i = static_cast<float*>( colors);
+	for (size_t i = begin; i < end; ++i) {
+		const vector c = color.get( i);
+		rgb point_color( c.x, c.y, c.z);
+		if (color_mode == 1)
+			point_color = point_color.desaturate();
+		else if (color_mode == 2)
+			point_color = point_color.grayscale();
+		*c_i++ = point_color.red;
+		*c_i++ = point_color.green;
+		*c_i++ = point_color.blue;
 	}
+}
 
-	/*
-	// First classify each point based on whether or not it is translucent
-	if (points_shape == ROUND) { // Every point must be depth sorted
-		for ( ; pos_i < pos_end && color_i < color_end; pos_i += 3, color_i += 3) {
-			translucent_points.push_back( point_coord( vector(pos_i), rgb(color_i)));
-		}
+bool
+points::update_buffers( const view& scene, int color_mode)
+{
+	if (!scene.glext.ARB_vertex_buffer_object)
+		return false;
+
+	const array_version pos_version = pos.get_version();
+	const array_version color_version = color.get_version();
+	// Colors go into the buffer as they are stored, unless they must be
+	// changed for anaglyph stereo or OpenGL can't take them.
+	GLenum color_type = GL_FLOAT;
+	size_t color_bytes = 3*sizeof(float);
+	if (!color_mode && color.get_storage() == NPY_UBYTE) {
+		color_type = GL_UNSIGNED_BYTE;
+		color_bytes = 3;
 	}
-	else { // Only translucent points need to be depth-sorted
-		for ( ; pos_i < pos_end && color_i < color_end; pos_i += 3, color_i += 3) {
-			if (0) // opacity not done
-				translucent_points.push_back( point_coord( vector(pos_i), rgb(color_i)));
-			else
-				opaque_points.push_back( point_coord( vector(pos_i), rgb(color_i)));
-		}
+	else if (!color_mode && color.get_storage() == NPY_HALF && scene.glext.ARB_half_float_vertex) {
+		color_type = GL_HALF_FLOAT_ARB;
+		color_bytes = 3*sizeof(npy_uint16);
 	}
-	*/
-
-	// Now conditionally apply transformations for gcf and anaglyph color
-// Needs work
-//	if (translucent_points.size())
-//		renderable::color.opacity = 0.5;
-	if (scene.gcf != 1.0 || (scene.gcfvec[0] != scene.gcfvec[1])) {
-		for (opaque_iterator i = opaque_points.begin(); i != opaque_points.end(); ++i) {
-			i->center = (i->center).scale(scene.gcfvec);
-		}
-		/*
-		for (translucent_iterator i = translucent_points.begin(); i != translucent_points.end(); ++i) {
-			i->center = (i->center).scale(scene.gcfvec);
-		}
-		*/
+
+	size_t begin = 0;
+	size_t end = count;
+	if (count > buffer_capacity || !vertex_buffer.size() || color_type != buffer_color_type) {
+		// Grow geometrically, so that the cost of copying is amortized.
+		buffer_capacity = std::max( 2*count, buffer_capacity);
+		// Float positions are copied as they are; others are stored as floats
+		// measured from the first point.
+		buffer_origin = pos.get_storage() == NPY_FLOAT ? vector() : pos.get( 0);
+		vertex_buffer.gl_set_data( scene, buffer_capacity * 3*sizeof(float),
+			0, GL_DYNAMIC_DRAW_ARB);
+		color_buffer.gl_set_data( scene, buffer_capacity * color_bytes,
+			0, GL_DYNAMIC_DRAW_ARB);
 	}
-	if (scene.anaglyph) {
-		if (scene.coloranaglyph) {
-			for (opaque_iterator i = opaque_points.begin(); i != opaque_points.end(); ++i) {
-				i->color = i->color.desaturate();
-			}
-			/*
-			for (translucent_iterator i = translucent_points.begin(); i != translucent_points.end(); ++i) {
-				i->color = i->color.desaturate();
-			}
-			*/
+	else if (color_mode == buffer_color_mode && count >= buffer_count) {
+		size_t first = count, last = 0;
+		size_t b, e;
+		if (pos.changed_since( buffer_pos_version, b, e)) {
+			first = std::min( first, b);
+			last = std::max( last, e);
 		}
-		else {
-			for (opaque_iterator i = opaque_points.begin(); i != opaque_points.end(); ++i) {
-				i->color = i->color.grayscale();
-			}
-			/*
-			for (translucent_iterator i = translucent_points.begin(); i != translucent_points.end(); ++i) {
-				i->color = i->color.grayscale();
-			}
-			*/
+		if (color.changed_since( buffer_color_version, b, e)) {
+			first = std::min( first, b);
+			last = std::max( last, e);
 		}
+		if (count > buffer_count) {
+			first = std::min( first, buffer_count);
+			last = count;
+		}
+		begin = first;
+		end = std::min( last, count);
 	}
-	/*
-	// Sort the translucent points
-	if (!translucent_points.empty()) {
-		std::stable_sort( translucent_points.begin(), translucent_points.end(),
-			face_z_comparator(scene.forward));
-	}
-	*/
-
-	clear_gl_error();
 
-	if (points_shape == ROUND)
-		glEnable( GL_POINT_SMOOTH);
-
-	if (size_units == WORLD && scene.glext.ARB_point_parameters) {
-		// This is simpler and more robust than what was here before, but it's still
-		// a little tacky and probably not perfectly general.  I'm not sure that it
-		// should work with stereo frustums, but I can't find a case where it's
-		// obviously wrong.
-		// However, note that point attenuation (regardless of parameters) isn't a
-		// correct perspective calculation, because it divides by distance, not by Z.
-		// Points not at the center of the screen will be too small, particularly
-		// at high fields of view.  This is in addition to the implementation limits
-		// on point size, which will be a problem when points get too big or close.
+	if (begin < end) {
+		std::vector<float> vertexes( 3*(end-begin));
+		std::vector<char> colors( (end-begin) * color_bytes);
+		write_points( begin, end, color_mode, color_type, buffer_origin,
+			&vertexes[0], &colors[0]);
+		vertex_buffer.gl_set_subdata( scene, begin * 3*sizeof(float),
+			vertexes.size() * sizeof(float), &vertexes[0]);
+		color_buffer.gl_set_subdata( scene, begin * color_bytes,
+			colors.size(), &colors[0]);
+	}
 
-		tmatrix proj; proj.gl_projection_get();  // Projection matrix
+	buffer_count = count;
+	buffer_pos_version = pos_version;
+	buffer_color_version = color_version;
+	buffer_color_mode = color_mode;
+	buffer_color_type = color_type;
+	return true;
+}
 
-		vector p = (proj * vertex(.5,0,1,1)).project();  // eye coordinates .5,0,1 -> window coordinates
+void
+points::gl_render( const view& scene)
+{
+	if (degenerate())
+		return;
 
-		// At an eye z of 1, a sphere of world-space diameter 1 is p.x * scene.view_width pixels wide,
-		// so a sphere of world-space diameter (size*scene.gcf) is
-		double point_radius_at_z_1 = size * scene.gcf * p.x * scene.view_width;
+	clear_gl_error();
+	const int color_mode = !scene.anaglyph ? 0 : scene.coloranaglyph ? 1 : 2;
 
-		float attenuation_eqn[] =  { 0.0f, 0.0f, 1.0f / (float)(point_radius_at_z_1*point_radius_at_z_1) };
-		scene.glext.glPointParameterfvARB( GL_POINT_DISTANCE_ATTENUATION_ARB, attenuation_eqn);
-		glPointSize( 1 );
-	}
-	else if (size_units == PIXELS) {
-		// Restore to default (aka, disable attenuation)
-		if (scene.glext.ARB_point_parameters) {
-			float attenuation_eqn[] = {1.0f, 0.0f, 0.0f};
-			scene.glext.glPointParameterfvARB( GL_POINT_DISTANCE_ATTENUATION_ARB, attenuation_eqn);
-		}
-		if (points_shape == ROUND) {
-			glPointSize( size );
-		}
-		else {
-			glPointSize( size );
-		}
-	}
-	// Finish GL state prep
+	gl_matrix_stackguard guard;
 	gl_disable ltg( GL_LIGHTING);
 	gl_enable_client v( GL_VERTEX_ARRAY);
 	gl_enable_client c( GL_COLOR_ARRAY);
 
-	// Render opaque points (if any)
-	if (opaque_points.size()) {
-		const std::ptrdiff_t chunk = 256;
-		opaque_iterator begin = opaque_points.begin();
-		opaque_iterator end = opaque_points.end();
-		while (begin < end) {
-			std::ptrdiff_t block = std::min( chunk, end - begin);
-			glColorPointer( 3, GL_FLOAT, sizeof(point_coord), &begin->color.red);
-			glVertexPointer( 3, GL_DOUBLE, sizeof(point_coord), &begin->center.x);
-			glDrawArrays( GL_POINTS, 0, block);
-			begin += block;
-		}
+	// Draw from the buffers if possible.  Otherwise the stored points are
+	// drawn directly, unless their colors need to be changed for anaglyph
+	// stereo or OpenGL can't take half-precision colors, in which case they
+	// are drawn from float copies.
+	std::vector<float> vertexes;
+	std::vector<float> colors;
+	const bool buffered = update_buffers( scene, color_mode);
+	if (buffered) {
+		vertex_buffer.gl_bind( scene);
+		glVertexPointer( 3, GL_FLOAT, 0, 0);
+		color_buffer.gl_bind( scene);
+		glColorPointer( 3, buffer_color_type, 0, 0);
+		scene.gl_world_transform( buffer_origin);
+	}
+	else if (!color_mode
+		&& (color.get_storage() != NPY_HALF || scene.glext.ARB_half_float_vertex)) {
+		glVertexPointer( 3, storage_gl_type( pos.get_storage()), 0, pos.raw());
+		glColorPointer( 3, storage_gl_type( color.get_storage()), 0, color.raw());
+		scene.gl_world_transform();
+	}
+	else {
+		vertexes.resize( 3*count);
+		colors.resize( 3*count);
+		write_points( 0, count, color_mode, GL_FLOAT, vector(), &vertexes[0], &colors[0]);
+		glVertexPointer( 3, GL_FLOAT, 0, &vertexes[0]);
+		glColorPointer( 3, GL_FLOAT, 0, &colors[0]);
+		scene.gl_world_transform();
 	}
 
-	/*
-	// Render translucent points (if any)
-	if (!translucent_points.empty()) {
-		const std::ptrdiff_t chunk = 256;
-		translucent_iterator begin = translucent_points.begin();
-		translucent_iterator end = translucent_points.end();
-		while (begin < end) {
-			std::ptrdiff_t block = std::min( chunk, end - begin);
-			glColorPointer( 3, GL_FLOAT, sizeof(point_coord), &begin->color.red);
-			glVertexPointer( 3, GL_DOUBLE, sizeof(point_coord), &begin->center.x);
-			glDrawArrays( GL_POINTS, 0, block);
-			begin += block;
+	// At an eye z of 1, a sphere of world-space diameter 1 is proj(1,1) * height/2
+	// pixels across, so a point of world-space diameter (size*scene.gcf) is
+	tmatrix proj; proj.gl_projection_get();  // Projection matrix
+	GLint viewport[4];
+	glGetIntegerv( GL_VIEWPORT, viewport);
+	const double point_size_at_z_1 = size * scene.gcf * proj(1,1) * viewport[3] * 0.5;
+
+	bool drawn = false;
+	{
+		// The point sprite shader gives exact disks, squares and shaded
+		// spheres, sized by the depth of each point.
+		use_point_shader shader( scene,
+			points_shape == SQUARE ? use_point_shader::SQUARE :
+				points_shape == SPHERE ? use_point_shader::SPHERE : use_point_shader::DISK,
+			size_units == PIXELS ? size : 0.0, point_size_at_z_1);
+		if (shader.ok()) {
+			glDrawArrays( GL_POINTS, 0, count);
+			drawn = true;
 		}
 	}
-	*/
 
-	if (points_shape == ROUND) {
-		glDisable( GL_POINT_SMOOTH);
+	if (!drawn) {
+		if (points_shape != SQUARE)
+			glEnable( GL_POINT_SMOOTH);
+
+		if (size_units == WORLD && scene.glext.ARB_point_parameters) {
+			// Note that point attenuation (regardless of parameters) isn't a
+			// correct perspective calculation, because it divides by distance, not by Z.
+			// Points not at the center of the screen will be too small, particularly
+			// at high fields of view.  This is in addition to the implementation limits
+			// on point size, which will be a problem when points get too big or close.
+			float attenuation_eqn[] =  { 0.0f, 0.0f,
+				1.0f / (float)(point_size_at_z_1*point_size_at_z_1) };
+			scene.glext.glPointParameterfvARB( GL_POINT_DISTANCE_ATTENUATION_ARB, attenuation_eqn);
+			glPointSize( 1 );
+		}
+		else if (size_units == PIXELS) {
+			// Restore to default (aka, disable attenuation)
+			if (scene.glext.ARB_point_parameters) {
+				float attenuation_eqn[] = {1.0f, 0.0f, 0.0f};
+				scene.glext.glPointParameterfvARB( GL_POINT_DISTANCE_ATTENUATION_ARB, attenuation_eqn);
+			}
+			glPointSize( size );
+		}
+		glDrawArrays( GL_POINTS, 0, count);
+
+		if (points_shape != SQUARE)
+			glDisable( GL_POINT_SMOOTH);
 	}
+
+	if (buffered)
+		color_buffer.gl_unbind( scene);
 	check_gl_error();
 }
 
 vector
 points::get_center() const
 {
-	if (degenerate() || points_shape != ROUND)
+	if (degenerate() || points_shape == SQUARE)
 		return vector();
-	vector ret;
-	const double* pos_i = pos.data();
-	for(size_t i=0; i<count; i++, pos_i+=3)
-		ret += vector(pos_i);
-	ret /= count;
-	return ret;
+	update_bounds();
+	return pos_sum / count;
 }
 
 void
@@ -278,14 +373,12 @@ points::grow_extent( extent& world)
 {
 	if (degenerate())
 		return;
-	const double* pos_i = pos.data();
-	const double* pos_end = pos.end();
 	if (size_units == PIXELS)
-		for ( ; pos_i < pos_end; pos_i += 3)
-			world.add_point( vector(pos_i));
+		for (size_t i = 0; i < count; ++i)
+			world.add_point( pos.get( i));
 	else
-		for ( ; pos_i < pos_end; pos_i += 3)
-			world.add_sphere( vector(pos_i), size);
+		for (size_t i = 0; i < count; ++i)
+			world.add_sphere( pos.get( i), size);
 	world.add_body();
 }
 
@@ -6,10 +6,12 @@
 // This file currently requires 144 MB to compile (optimizing).
 
 #include "python/curve.hpp"
+#include "python/curves.hpp"
 #include "python/extrusion.hpp"
 #include "python/faces.hpp"
 #include "python/convex.hpp"
 #include "python/points.hpp"
+#include "python/pointcloud.hpp"
 
 #include "python/num_util.hpp"
 #include <boost/python/class.hpp>
@@ -93,6 +95,8 @@ wrap_arrayobjects()
 
 	void (curve::*append_v_rgb_retain)( const vector&, const rgb&, int ) = &curve::append;
 	void (curve::*append_v_retain)( const vector&, int ) = &curve::append;
+	void (curve::*append_a_retain)( const double_array&, int ) = &curve::append_array;
+	void (curve::*append_a_color_retain)( const double_array&, const double_array&, int ) = &curve::append_array;
 
 	class_<curve, bases<renderable> >( "curve")
 		.def( init<const curve&>())
@@ -106,6 +110,9 @@ wrap_arrayobjects()
 		.def( "set_blue", &curve::set_blue_d)
 		.def( "set_blue", &curve::set_blue)
 		.def( "get_pos", &curve::get_pos)
+		.def( "adopt_pos", &curve::adopt_pos)
+		.def( "adopt_color", &curve::adopt_color)
+		.def( "mark_dirty", &curve::mark_dirty, (arg("begin")=0, arg("end")=-1))
 		.def( "set_pos", &curve::set_pos)
 		.def( "set_pos", &curve::set_pos_v)
 		.def( "set_x", &curve::set_x_d)
@@ -114,6 +121,10 @@ wrap_arrayobjects()
 		.def( "set_y", &curve::set_y)
 		.def( "set_z", &curve::set_z_d)
 		.def( "set_z", &curve::set_z)
+		// Overloads are tried last registered first, so these, which take Nx3
+		// arrays of points, are only tried once appending a single point fails.
+		.def( "append", append_a_retain, ( arg("pos"), arg("retain")=-1 ) )
+		.def( "append", append_a_color_retain, ( arg("pos"), arg("color"), arg("retain")=-1 ) )
 		.def( "append", append_v_rgb_retain, ( arg("pos"), arg("color"), arg("retain")=-1 ) )
 		.def( "append", append_v_retain, ( arg("pos"), arg("retain")=-1 ) )
 		.def( "append", &curve::append_rgb,
@@ -121,6 +132,37 @@ wrap_arrayobjects()
 		;
 	}
 
+	{
+	using python::curves;
+
+	void (curves::*append_v_retain)( const vector&, int ) = &curves::append;
+
+	class_<curves, bases<renderable> >( "curves")
+		.def( init<const curves&>())
+		.add_property( "color", &curves::get_color, &curves::set_color)
+		.add_property( "radius", &curves::get_radius, &curves::set_radius)
+		.add_property( "antialias", &curves::get_antialias, &curves::set_antialias)
+		.add_property( "pick_index", &curves::get_pick_index)
+		.add_property( "line_count", &curves::get_line_count)
+		.def( "get_offsets", &curves::get_offsets)
+		.def( "set_offsets", &curves::set_offsets)
+		.def( "add_line", &curves::add_line, ( arg("pos"), arg("color"), arg("radius") ) )
+		.def( "add_line", &curves::add_line_color, ( arg("pos"), arg("color") ) )
+		.def( "add_line", &curves::add_line_default, ( arg("pos") ) )
+		.def( "get_line_color", &curves::get_line_color)
+		.def( "set_line_color", &curves::set_line_color)
+		.def( "get_line_radius", &curves::get_line_radius)
+		.def( "set_line_radius", &curves::set_line_radius)
+		.def( "get_line_visible", &curves::get_line_visible)
+		.def( "set_line_visible", &curves::set_line_visible)
+		.def( "get_pos", &curves::get_pos)
+		.def( "set_pos", &curves::set_pos)
+		// As for curve, arrays are tried after single points.
+		.def( "append", &curves::append_array, ( arg("pos"), arg("retain")=-1 ) )
+		.def( "append", append_v_retain, ( arg("pos"), arg("retain")=-1 ) )
+		;
+	}
+
 	{
 	using python::extrusion;
 
@@ -181,12 +223,16 @@ wrap_arrayobjects()
 
 	void (points::*pappend_v_r)( const vector&, const rgb&, int ) = &points::append;
 	void (points::*pappend_v)( const vector&, int ) = &points::append;
+	void (points::*pappend_a)( const double_array&, int ) = &points::append_array;
+	void (points::*pappend_a_c)( const double_array&, const double_array&, int ) = &points::append_array;
 
 	class_<points, bases<renderable> >( "points")
 		.def( init<const points&>())
 		.add_property( "size", &points::get_size, &points::set_size)
 		.add_property( "shape", &points::get_points_shape, &points::set_points_shape)
 		.add_property( "size_units", &points::get_size_units, &points::set_size_units)
+		.add_property( "pos_type", &points::get_pos_type, &points::set_pos_type)
+		.add_property( "color_type", &points::get_color_type, &points::set_color_type)
 		.def( "get_color", &points::get_color)
 		// The order of set_color specifications matters.
 		//.def( "set_color", &points::set_color_t)
@@ -198,6 +244,9 @@ wrap_arrayobjects()
 		.def( "set_blue", &points::set_blue_d)
 		.def( "set_blue", &points::set_blue)
 		.def( "get_pos", &points::get_pos)
+		.def( "adopt_pos", &points::adopt_pos)
+		.def( "adopt_color", &points::adopt_color)
+		.def( "mark_dirty", &points::mark_dirty, (arg("begin")=0, arg("end")=-1))
 		.def( "set_pos", &points::set_pos)
 		.def( "set_pos", &points::set_pos_v)
 		.def( "set_x", &points::set_x_d)
@@ -206,6 +255,9 @@ wrap_arrayobjects()
 		.def( "set_y", &points::set_y)
 		.def( "set_z", &points::set_z_d)
 		.def( "set_z", &points::set_z)
+		// As for curve, arrays are tried after single points.
+		.def( "append", pappend_a, (arg("pos"), arg("retain")=-1))
+		.def( "append", pappend_a_c, (arg("pos"), arg("color"), arg("retain")=-1))
 		.def( "append", pappend_v_r, (arg("pos"), arg("color"), arg("retain")=-1))
 		.def( "append", pappend_v, (arg("pos"), arg("retain")=-1))
 		.def( "append", &points::append_rgb,
@@ -213,16 +265,49 @@ wrap_arrayobjects()
 		;
 	}
 
+	{
+	using python::pointcloud;
+	using python::pointcloud_builder;
+
+	class_<pointcloud, bases<renderable> >( "pointcloud")
+		.def( init<const pointcloud&>())
+		.add_property( "file", &pointcloud::get_file, &pointcloud::set_file)
+		.add_property( "size", &pointcloud::get_size, &pointcloud::set_size)
+		.add_property( "shape", &pointcloud::get_points_shape, &pointcloud::set_points_shape)
+		.add_property( "point_budget", &pointcloud::get_point_budget, &pointcloud::set_point_budget)
+		.add_property( "memory_budget", &pointcloud::get_memory_budget, &pointcloud::set_memory_budget)
+		.add_property( "point_count", &pointcloud::get_point_count)
+		.add_property( "drawn_count", &pointcloud::get_drawn_count)
+		;
+
+	class_<pointcloud_builder>( "pointcloud_builder",
+			init<const std::string&, size_t>( (arg("filename"), arg("node_points")=65536)))
+		.def( "add", &pointcloud_builder::add_points, (arg("pos")),
+			"Add an Nx3 array of points.")
+		.def( "add", &pointcloud_builder::add_points_color, (arg("pos"), arg("color")),
+			"Add an Nx3 array of points, with an Nx3 array of colors.")
+		.def( "finish", &pointcloud_builder::finish,
+			"Write the file.")
+		;
+	}
+
 	{
 	using python::faces;
 
 	void (faces::* append_all_vectors)(const vector&, const vector&, const rgb&) = &faces::append;
 	void (faces::* append_default_color)(const vector&, const vector&) = &faces::append;
 	void (faces::* append_pos)(const vector&) = &faces::append;
+	void (faces::* append_all_arrays)(const double_array&, const double_array&, const double_array&)
+		= &faces::append_array;
+	void (faces::* append_default_color_array)(const double_array&, const double_array&) = &faces::append_array;
+	void (faces::* append_pos_array)(const double_array&) = &faces::append_array;
 
 	class_<faces, bases<renderable> >("faces")
 		.def( init<const faces&>())
 		.def( "get_pos", &faces::get_pos)
+		.def( "adopt_pos", &faces::adopt_pos)
+		.def( "adopt_color", &faces::adopt_color)
+		.def( "mark_dirty", &faces::mark_dirty, (arg("begin")=0, arg("end")=-1))
 		.def( "set_pos", &faces::set_pos)
 		.def( "get_normal", &faces::get_normal)
 		.def( "set_normal", &faces::set_normal_v)
@@ -243,7 +328,17 @@ wrap_arrayobjects()
 		.def( "make_normals", &faces::make_normals,
 			"Construct normal vectors perpendicular to all faces.")
 		.def( "make_twosided", &faces::make_twosided,
-			"Add a second side and corresponding normals to all faces.")
+			"Light the back sides of all faces, as twosided = True.")
+		.def( "smooth_normals", &faces::smooth_normals, (arg("crease_angle")=M_PI),
+			"Average normals of the triangles at shared vertexes, splitting vertexes at creases.")
+		.add_property( "twosided", &faces::get_twosided, &faces::set_twosided)
+		.add_property( "depth_sort", &faces::get_depth_sort, &faces::set_depth_sort)
+		.def( "get_index", &faces::get_index)
+		.def( "set_index", &faces::set_index)
+		// As for curve, arrays are tried after single points.
+		.def( "append", append_pos_array, ( arg("pos") ))
+		.def( "append", append_default_color_array, ( arg("pos"), arg("normal") ))
+		.def( "append", append_all_arrays, (arg("pos"), arg("normal"), arg("color")))
 		.def( "append", &faces::append_rgb,
 			(arg("pos"), arg("normal"), arg("red")=-1, arg("green")=-1, arg("blue")=-1))
 		.def( "append", append_pos, ( arg("pos") ))
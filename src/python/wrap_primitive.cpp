@@ -173,16 +173,28 @@ wrap_primitive()
 
 	class_< sphere, bases<axial> >( "sphere")
 		.def( init<const sphere&>())
+		.def( "set_lod_triangles", &sphere::set_lod_triangles)
+		.staticmethod( "set_lod_triangles")
+		.def( "get_lod_triangles", &sphere::get_lod_triangles)
+		.staticmethod( "get_lod_triangles")
 		;
 
 	class_< cylinder, bases<axial> >( "cylinder")
 		.def( init<const cylinder&>())
 		.add_property( "length", &cylinder::get_length, &cylinder::set_length)
+		.def( "set_lod_triangles", &cylinder::set_lod_triangles)
+		.staticmethod( "set_lod_triangles")
+		.def( "get_lod_triangles", &cylinder::get_lod_triangles)
+		.staticmethod( "get_lod_triangles")
 		;
 
 	class_< cone, bases<axial> >( "cone")
 		.def( init<const cone&>())
 		.add_property( "length", &cone::get_length, &cone::set_length)
+		.def( "set_lod_triangles", &cone::set_lod_triangles)
+		.staticmethod( "set_lod_triangles")
+		.def( "get_lod_triangles", &cone::get_lod_triangles)
+		.staticmethod( "get_lod_triangles")
 		;
 
 
@@ -264,7 +276,21 @@ wrap_primitive()
 		;
 
 	using python::numeric_texture;
-	class_<texture, noncopyable>( "texbase", no_init);
+	class_<texture, noncopyable>( "texbase", no_init)
+		.add_property( "resident_bytes", &texture::get_resident_bytes)
+		.def( "get_total_resident_bytes", &texture::get_total_resident_bytes)
+		.staticmethod( "get_total_resident_bytes")
+		.def( "get_resident_count", &texture::get_resident_count)
+		.staticmethod( "get_resident_count")
+		.def( "set_memory_budget", &texture::set_memory_budget)
+		.staticmethod( "set_memory_budget")
+		.def( "get_memory_budget", &texture::get_memory_budget)
+		.staticmethod( "get_memory_budget")
+		.def( "set_compression", &texture::set_compression)
+		.staticmethod( "set_compression")
+		.def( "get_compression", &texture::get_compression)
+		.staticmethod( "get_compression")
+		;
 	class_<numeric_texture, shared_ptr<numeric_texture>, bases<texture>, noncopyable>( "texture")
 		.add_property( "data", &numeric_texture::get_data, &numeric_texture::set_data)
 		.add_property( "type", &numeric_texture::get_type, &numeric_texture::set_type)
@@ -279,6 +305,7 @@ wrap_primitive()
 		.add_property( "textures", &material::get_textures, &material::set_textures )
 		.add_property( "shader", &material::get_shader, &material::set_shader )
 		.add_property( "translucent", &material::get_translucent, &material::set_translucent )
+		.add_property( "name", &material::get_name, &material::set_name )
 		;
 
 	class_<light, bases<renderable>, noncopyable>( "light", no_init )